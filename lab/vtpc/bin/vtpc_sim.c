@@ -0,0 +1,825 @@
+// Replays a vtpc access trace against the eviction policies at many cache
+// capacities in one pass and prints their hit-ratio curves.
+//
+// LRU is simulated exactly for every capacity at once from stack distances
+// (Mattson et al., 1970). Policies without the stack property need one
+// simulation per capacity; on large traces they run on a spatially sampled
+// subset of pages with proportionally scaled capacities (Waldspurger et al.,
+// "Cache Modeling and Optimization using Miniature Simulations", 2017).
+// CLOCK-Pro and S3-FIFO are run as vtpc runs them, one page per block, with
+// the ghost of evicted blocks vtpc uses.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ghost.h"
+#include "trace.h"
+
+#define SIM_CAPACITIES 32
+#define SIM_SAMPLE_BITS 24
+#define SIM_SAMPLED_EVENTS (1U << 22U)
+
+// The defaults of VTPC_FREQ_MAX and VTPC_SMALL_PERCENT in vtpc.
+#define SIM_FREQ_MAX 3
+#define SIM_SMALL_PERCENT 10
+
+#define SIM_NONE UINT32_MAX
+#define SIM_HOT 1U
+#define SIM_TEST 2U
+#define SIM_SMALL 4U
+
+static uint64_t mix(uint64_t key) {
+  key ^= key >> 33U;
+  key *= 0xFF51AFD7ED558CCDULL;
+  key ^= key >> 33U;
+  key *= 0xC4CEB9FE1A85EC53ULL;
+  key ^= key >> 33U;
+  return key;
+}
+
+// Open-addressing map from nonzero keys to 32-bit values with backward-shift
+// deletion, so no tombstones build up under FIFO-like churn.
+struct table {
+  uint64_t* keys;
+  uint32_t* values;
+  size_t mask;
+  size_t size;
+};
+
+static void table_init(struct table* table, size_t capacity) {
+  size_t slots = 16;
+  while (slots < 2 * capacity) {
+    slots <<= 1U;
+  }
+  table->keys = calloc(slots, sizeof(*table->keys));
+  table->values = calloc(slots, sizeof(*table->values));
+  if (table->keys == NULL || table->values == NULL) {
+    fprintf(stderr, "vtpc_sim: out of memory\n");
+    exit(1);
+  }
+  table->mask = slots - 1;
+  table->size = 0;
+}
+
+static void table_free(struct table* table) {
+  free(table->keys);
+  free(table->values);
+}
+
+static size_t table_slot(const struct table* table, uint64_t key) {
+  size_t slot = mix(key) & table->mask;
+  while (table->keys[slot] != 0 && table->keys[slot] != key) {
+    slot = (slot + 1) & table->mask;
+  }
+  return slot;
+}
+
+static void table_grow(struct table* table) {
+  struct table grown;
+  table_init(&grown, table->mask + 1);
+  for (size_t slot = 0; slot <= table->mask; ++slot) {
+    if (table->keys[slot] != 0) {
+      const size_t to = table_slot(&grown, table->keys[slot]);
+      grown.keys[to] = table->keys[slot];
+      grown.values[to] = table->values[slot];
+    }
+  }
+  grown.size = table->size;
+  table_free(table);
+  *table = grown;
+}
+
+// Returns the slot of key, inserting it if absent; found tells which.
+static size_t table_insert(struct table* table, uint64_t key, bool* found) {
+  size_t slot = table_slot(table, key);
+  *found = table->keys[slot] != 0;
+  if (!*found) {
+    if (2 * (table->size + 1) > table->mask + 1) {
+      table_grow(table);
+      slot = table_slot(table, key);
+    }
+    table->keys[slot] = key;
+    table->size += 1;
+  }
+  return slot;
+}
+
+static void table_erase(struct table* table, uint64_t key) {
+  size_t hole = table_slot(table, key);
+  if (table->keys[hole] == 0) {
+    return;
+  }
+  table->size -= 1;
+  size_t slot = hole;
+  for (;;) {
+    slot = (slot + 1) & table->mask;
+    if (table->keys[slot] == 0) {
+      break;
+    }
+    const size_t home = mix(table->keys[slot]) & table->mask;
+    if (((slot - home) & table->mask) >= ((slot - hole) & table->mask)) {
+      table->keys[hole] = table->keys[slot];
+      table->values[hole] = table->values[slot];
+      hole = slot;
+    }
+  }
+  table->keys[hole] = 0;
+}
+
+// Exact LRU for all capacities: the stack distance of an access is one plus
+// the number of distinct pages touched since the previous access to the same
+// page, counted with a Fenwick tree over access times that marks each page's
+// latest access. Times are renumbered when the tree fills up.
+struct stack_sim {
+  struct table last;
+  uint32_t* tree;
+  uint64_t* owners;
+  uint32_t width;
+  uint32_t now;
+  uint64_t distances[SIM_CAPACITIES];
+};
+
+static void tree_add(struct stack_sim* sim, uint32_t time, int32_t delta) {
+  for (uint32_t i = time + 1; i <= sim->width; i += i & -i) {
+    sim->tree[i - 1] += delta;
+  }
+}
+
+static uint32_t tree_sum(const struct stack_sim* sim, uint32_t time) {
+  uint32_t sum = 0;
+  for (uint32_t i = time; i > 0; i -= i & -i) {
+    sum += sim->tree[i - 1];
+  }
+  return sum;
+}
+
+static void stack_resize(struct stack_sim* sim, uint32_t width) {
+  sim->tree = realloc(sim->tree, width * sizeof(*sim->tree));
+  sim->owners = realloc(sim->owners, width * sizeof(*sim->owners));
+  if (sim->tree == NULL || sim->owners == NULL) {
+    fprintf(stderr, "vtpc_sim: out of memory\n");
+    exit(1);
+  }
+  sim->width = width;
+}
+
+static void stack_init(struct stack_sim* sim) {
+  memset(sim, 0, sizeof(*sim));
+  table_init(&sim->last, 1U << 16U);
+  stack_resize(sim, 1U << 20U);
+  memset(sim->tree, 0, sim->width * sizeof(*sim->tree));
+  memset(sim->owners, 0, sim->width * sizeof(*sim->owners));
+}
+
+static void stack_free(struct stack_sim* sim) {
+  table_free(&sim->last);
+  free(sim->tree);
+  free(sim->owners);
+}
+
+static void stack_compact(struct stack_sim* sim) {
+  uint32_t live = 0;
+  for (uint32_t time = 0; time < sim->now; ++time) {
+    const uint64_t key = sim->owners[time];
+    if (key != 0) {
+      sim->owners[live] = key;
+      sim->last.values[table_slot(&sim->last, key)] = live;
+      live += 1;
+    }
+  }
+  if (2 * (uint64_t)live > sim->width) {
+    stack_resize(sim, sim->width * 2);
+  }
+
+  memset(sim->tree, 0, sim->width * sizeof(*sim->tree));
+  for (uint32_t i = 1; i <= sim->width; ++i) {
+    sim->tree[i - 1] += i <= live ? 1 : 0;
+    const uint32_t parent = i + (i & -i);
+    if (parent <= sim->width) {
+      sim->tree[parent - 1] += sim->tree[i - 1];
+    }
+  }
+  memset(sim->owners + live, 0, (sim->width - live) * sizeof(*sim->owners));
+  sim->now = live;
+}
+
+static void stack_access(
+    struct stack_sim* sim,
+    uint64_t key,
+    const uint64_t* capacities,
+    size_t count
+) {
+  if (sim->now == sim->width) {
+    stack_compact(sim);
+  }
+
+  bool found = false;
+  const size_t slot = table_insert(&sim->last, key, &found);
+  if (found) {
+    const uint32_t previous = sim->last.values[slot];
+    const uint64_t distance =
+        tree_sum(sim, sim->now) - tree_sum(sim, previous + 1) + 1;
+
+    // Counted at the smallest capacity that holds the distance; the hits of
+    // a capacity are the prefix sum up to it.
+    size_t low = 0;
+    size_t high = count;
+    while (low < high) {
+      const size_t middle = (low + high) / 2;
+      if (capacities[middle] < distance) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+    if (low < count) {
+      sim->distances[low] += 1;
+    }
+    tree_add(sim, previous, -1);
+    sim->owners[previous] = 0;
+  }
+
+  sim->last.values[slot] = sim->now;
+  sim->owners[sim->now] = key;
+  tree_add(sim, sim->now, 1);
+  sim->now += 1;
+}
+
+enum policy {
+  POLICY_FIFO,
+  POLICY_CLOCK,
+  POLICY_CLOCK_PRO,
+  POLICY_S3_FIFO,
+  POLICIES,
+};
+
+static const char* const policy_names[POLICIES] = {
+    "FIFO",
+    "CLOCK",
+    "CLOCK-Pro",
+    "S3-FIFO",
+};
+
+// Frames linked through next and prev, from the hot end at head to the cold
+// end at tail.
+struct queue {
+  uint32_t head;
+  uint32_t tail;
+  uint64_t size;
+};
+
+// One cache of a fixed capacity run by a policy without the stack property.
+// Its frames are allocated as they fill, and the ghost once it is full, so
+// capacities far above the trace's footprint cost nothing. freq holds the
+// reference bit of CLOCK, and the hits of CLOCK-Pro and S3-FIFO up to
+// SIM_FREQ_MAX. Those two keep their frames on queues: S3-FIFO new blocks
+// in small, and CLOCK-Pro every block in main, with hot of them hot and an
+// adaptive target for the cold ones.
+struct cache_sim {
+  enum policy policy;
+  struct table slots;
+  uint64_t* keys;
+  uint8_t* freq;
+  uint8_t* flags;
+  uint32_t* next;
+  uint32_t* prev;
+  uint64_t capacity;
+  uint64_t allocated;
+  uint64_t used;
+  uint64_t hand;
+  uint64_t hits;
+  struct queue main;
+  struct queue small;
+  uint64_t hot;
+  uint64_t cold_target;
+  struct vtpc_ghost* ghost;
+};
+
+static void cache_sim_init(
+    struct cache_sim* sim, enum policy policy, uint64_t capacity
+) {
+  memset(sim, 0, sizeof(*sim));
+  sim->policy = policy;
+  sim->capacity = capacity == 0 ? 1 : capacity;
+  sim->main = (struct queue){.head = SIM_NONE, .tail = SIM_NONE};
+  sim->small = sim->main;
+  sim->cold_target = sim->capacity / 4;
+  table_init(&sim->slots, 8);
+}
+
+static void* sim_realloc(void* data, uint64_t count, size_t size) {
+  data = realloc(data, count * size);
+  if (data == NULL) {
+    fprintf(stderr, "vtpc_sim: out of memory\n");
+    exit(1);
+  }
+  return data;
+}
+
+static void cache_sim_reserve(struct cache_sim* sim) {
+  uint64_t allocated = sim->allocated == 0 ? 64 : 2 * sim->allocated;
+  if (allocated > sim->capacity) {
+    allocated = sim->capacity;
+  }
+  sim->keys = sim_realloc(sim->keys, allocated, sizeof(*sim->keys));
+  sim->freq = sim_realloc(sim->freq, allocated, sizeof(*sim->freq));
+  sim->flags = sim_realloc(sim->flags, allocated, sizeof(*sim->flags));
+  sim->next = sim_realloc(sim->next, allocated, sizeof(*sim->next));
+  sim->prev = sim_realloc(sim->prev, allocated, sizeof(*sim->prev));
+  sim->allocated = allocated;
+}
+
+static void cache_sim_free(struct cache_sim* sim) {
+  table_free(&sim->slots);
+  free(sim->keys);
+  free(sim->freq);
+  free(sim->flags);
+  free(sim->next);
+  free(sim->prev);
+  if (sim->ghost != NULL) {
+    vtpc_ghost_destroy(sim->ghost);
+  }
+}
+
+static void queue_push(
+    struct cache_sim* sim, struct queue* queue, uint32_t frame
+) {
+  sim->prev[frame] = SIM_NONE;
+  sim->next[frame] = queue->head;
+  if (queue->head != SIM_NONE) {
+    sim->prev[queue->head] = frame;
+  } else {
+    queue->tail = frame;
+  }
+  queue->head = frame;
+  queue->size += 1;
+}
+
+static void queue_unlink(
+    struct cache_sim* sim, struct queue* queue, uint32_t frame
+) {
+  const uint32_t prev = sim->prev[frame];
+  const uint32_t next = sim->next[frame];
+  if (prev != SIM_NONE) {
+    sim->next[prev] = next;
+  } else {
+    queue->head = next;
+  }
+  if (next != SIM_NONE) {
+    sim->prev[next] = prev;
+  } else {
+    queue->tail = prev;
+  }
+  queue->size -= 1;
+}
+
+// Moves the frame at the cold end of the queue to its hot end.
+static void queue_rotate(struct cache_sim* sim, struct queue* queue) {
+  const uint32_t frame = queue->tail;
+  queue_unlink(sim, queue, frame);
+  queue_push(sim, queue, frame);
+}
+
+// FIFO evicts the frame at the hand; CLOCK first clears the reference bits
+// of the frames the hand passes.
+static uint32_t clock_evict(struct cache_sim* sim) {
+  while (sim->policy == POLICY_CLOCK && sim->freq[sim->hand] != 0) {
+    sim->freq[sim->hand] = 0;
+    sim->hand = (sim->hand + 1) % sim->capacity;
+  }
+  const uint32_t frame = (uint32_t)sim->hand;
+  sim->hand = (sim->hand + 1) % sim->capacity;
+  return frame;
+}
+
+// Sweeps main from its cold end as vtpc's policy_spare does. Hot frames lose
+// their hits, and turn cold once without while there are too many; a cold
+// frame hit in its test period turns hot, and one hit outside it starts a
+// new one. The first cold frame without hits is evicted, and a test period
+// it takes out of the ghost unused shrinks the cold target. After as many
+// rounds as vtpc sweeps, a frame is evicted whatever its hits.
+static uint32_t clock_pro_evict(struct cache_sim* sim) {
+  const uint64_t limit = (SIM_FREQ_MAX + 1) * sim->capacity;
+  for (uint64_t step = 0;; ++step) {
+    const uint32_t frame = sim->main.tail;
+    uint8_t* flags = &sim->flags[frame];
+    if (step < limit && (*flags & SIM_HOT) != 0) {
+      if (sim->freq[frame] == 0 &&
+          sim->hot + sim->cold_target > sim->capacity) {
+        *flags &= ~SIM_HOT;
+        sim->hot -= 1;
+      }
+      sim->freq[frame] = 0;
+      queue_rotate(sim, &sim->main);
+      continue;
+    }
+    if (step < limit && sim->freq[frame] != 0) {
+      if ((*flags & SIM_TEST) != 0) {
+        *flags = SIM_HOT;
+        sim->hot += 1;
+      } else {
+        *flags |= SIM_TEST;
+      }
+      sim->freq[frame] = 0;
+      queue_rotate(sim, &sim->main);
+      continue;
+    }
+
+    queue_unlink(sim, &sim->main, frame);
+    if ((*flags & SIM_HOT) != 0) {
+      sim->hot -= 1;
+    }
+    if ((*flags & SIM_TEST) != 0 &&
+        vtpc_ghost_add(sim->ghost, sim->keys[frame]) && sim->cold_target > 1) {
+      sim->cold_target -= 1;
+    }
+    return frame;
+  }
+}
+
+// Evicts from the small queue while it holds more than its share, moving
+// hit frames on to main and remembering the others in the ghost, and else
+// from main, giving its frames a round per hit.
+static uint32_t s3_fifo_evict(struct cache_sim* sim) {
+  const uint64_t share = sim->capacity * SIM_SMALL_PERCENT / 100;
+  for (;;) {
+    if (sim->small.size > share || sim->main.size == 0) {
+      const uint32_t frame = sim->small.tail;
+      queue_unlink(sim, &sim->small, frame);
+      if (sim->freq[frame] != 0) {
+        sim->flags[frame] = 0;
+        sim->freq[frame] = 0;
+        queue_push(sim, &sim->main, frame);
+        continue;
+      }
+      vtpc_ghost_add(sim->ghost, sim->keys[frame]);
+      return frame;
+    }
+
+    const uint32_t frame = sim->main.tail;
+    if (sim->freq[frame] != 0) {
+      sim->freq[frame] -= 1;
+      queue_rotate(sim, &sim->main);
+      continue;
+    }
+    queue_unlink(sim, &sim->main, frame);
+    return frame;
+  }
+}
+
+// Queues a frame just filled. A block the ghost remembers was evicted too
+// early: S3-FIFO admits it to main, and CLOCK-Pro makes it hot and grows
+// its cold target. Other blocks start in small, or cold in their test
+// period.
+static void queue_insert(struct cache_sim* sim, uint32_t frame, uint64_t key) {
+  const bool ghost = sim->ghost != NULL && vtpc_ghost_take(sim->ghost, key);
+  if (sim->policy == POLICY_S3_FIFO) {
+    sim->flags[frame] = ghost ? 0 : SIM_SMALL;
+    queue_push(sim, ghost ? &sim->main : &sim->small, frame);
+    return;
+  }
+  sim->flags[frame] = ghost ? SIM_HOT : SIM_TEST;
+  if (ghost) {
+    sim->hot += 1;
+    if (sim->cold_target + 1 < sim->capacity) {
+      sim->cold_target += 1;
+    }
+  }
+  queue_push(sim, &sim->main, frame);
+}
+
+static void cache_sim_access(struct cache_sim* sim, uint64_t key) {
+  bool found = false;
+  const size_t slot = table_insert(&sim->slots, key, &found);
+  if (found) {
+    sim->hits += 1;
+    uint8_t* freq = &sim->freq[sim->slots.values[slot]];
+    if (*freq < SIM_FREQ_MAX) {
+      *freq += 1;
+    }
+    return;
+  }
+
+  const bool queued =
+      sim->policy == POLICY_CLOCK_PRO || sim->policy == POLICY_S3_FIFO;
+  uint32_t frame = (uint32_t)sim->used;
+  if (sim->used < sim->capacity) {
+    if (sim->used == sim->allocated) {
+      cache_sim_reserve(sim);
+    }
+    sim->used += 1;
+  } else {
+    if (queued && sim->ghost == NULL) {
+      sim->ghost = vtpc_ghost_create((uint32_t)sim->capacity);
+      if (sim->ghost == NULL) {
+        fprintf(stderr, "vtpc_sim: out of memory\n");
+        exit(1);
+      }
+    }
+    if (sim->policy == POLICY_CLOCK_PRO) {
+      frame = clock_pro_evict(sim);
+    } else if (sim->policy == POLICY_S3_FIFO) {
+      frame = s3_fifo_evict(sim);
+    } else {
+      frame = clock_evict(sim);
+    }
+    table_erase(&sim->slots, sim->keys[frame]);
+  }
+
+  // The erase may have shifted the new key's slot.
+  sim->slots.values[table_slot(&sim->slots, key)] = frame;
+  sim->keys[frame] = key;
+  sim->freq[frame] = 0;
+  if (queued) {
+    queue_insert(sim, frame, key);
+  }
+}
+
+// The events of one thread, spread over the chunks it wrote.
+struct stream {
+  const struct vtpc_trace_event** chunks;
+  uint32_t* counts;
+  size_t chunk;
+  size_t count;
+  uint32_t event;
+};
+
+struct trace_file {
+  const char* data;
+  size_t size;
+  uint32_t page_size;
+  struct stream* streams;
+  size_t nstreams;
+  uint64_t events;
+};
+
+static const struct vtpc_trace_event* stream_peek(const struct stream* s) {
+  return s->chunk < s->count ? &s->chunks[s->chunk][s->event] : NULL;
+}
+
+static void stream_next(struct stream* s) {
+  s->event += 1;
+  if (s->event == s->counts[s->chunk]) {
+    s->chunk += 1;
+    s->event = 0;
+  }
+}
+
+static int trace_load(const char* path, struct trace_file* trace) {
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    const int error = errno;
+    close(fd);
+    errno = error;
+    return -1;
+  }
+  trace->size = st.st_size;
+  trace->data = trace->size == 0
+                    ? MAP_FAILED
+                    : mmap(NULL, trace->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  struct vtpc_trace_header header;
+  if (trace->data == MAP_FAILED || trace->size < sizeof(header)) {
+    errno = EINVAL;
+    return -1;
+  }
+  memcpy(&header, trace->data, sizeof(header));
+  if (header.magic != VTPC_TRACE_MAGIC) {
+    errno = EINVAL;
+    return -1;
+  }
+  trace->page_size = header.page_size;
+  madvise((void*)trace->data, trace->size, MADV_SEQUENTIAL);
+
+  // Two passes over the chunk headers: count the chunks of each thread, then
+  // collect them in file order, which is the order each thread wrote them.
+  size_t* counts = NULL;
+  for (int pass = 0; pass < 2; ++pass) {
+    size_t offset = sizeof(header);
+    while (offset + sizeof(struct vtpc_trace_chunk) <= trace->size) {
+      struct vtpc_trace_chunk chunk;
+      memcpy(&chunk, trace->data + offset, sizeof(chunk));
+      offset += sizeof(chunk);
+      const size_t bytes = chunk.count * sizeof(struct vtpc_trace_event);
+      if (offset + bytes > trace->size) {
+        break;
+      }
+
+      if (pass == 0) {
+        if (chunk.thread >= trace->nstreams) {
+          size_t* grown =
+              realloc(counts, (chunk.thread + 1) * sizeof(*counts));
+          if (grown == NULL) {
+            free(counts);
+            errno = ENOMEM;
+            return -1;
+          }
+          counts = grown;
+          memset(
+              counts + trace->nstreams,
+              0,
+              (chunk.thread + 1 - trace->nstreams) * sizeof(*counts)
+          );
+          trace->nstreams = chunk.thread + 1;
+        }
+        counts[chunk.thread] += 1;
+        trace->events += chunk.count;
+      } else {
+        struct stream* s = &trace->streams[chunk.thread];
+        s->chunks[s->count] =
+            (const struct vtpc_trace_event*)(trace->data + offset);
+        s->counts[s->count] = chunk.count;
+        s->count += 1;
+      }
+      offset += bytes;
+    }
+
+    if (pass == 0) {
+      trace->streams = calloc(trace->nstreams + 1, sizeof(*trace->streams));
+      if (trace->streams == NULL) {
+        free(counts);
+        errno = ENOMEM;
+        return -1;
+      }
+      for (size_t i = 0; i < trace->nstreams; ++i) {
+        struct stream* s = &trace->streams[i];
+        s->chunks = calloc(counts[i] + 1, sizeof(*s->chunks));
+        s->counts = calloc(counts[i] + 1, sizeof(*s->counts));
+        if (s->chunks == NULL || s->counts == NULL) {
+          free(counts);
+          errno = ENOMEM;
+          return -1;
+        }
+      }
+    }
+  }
+  free(counts);
+
+  // Empty chunks would make a stream end early.
+  for (size_t i = 0; i < trace->nstreams; ++i) {
+    struct stream* s = &trace->streams[i];
+    while (s->chunk < s->count && s->counts[s->chunk] == 0) {
+      s->chunk += 1;
+    }
+  }
+  return 0;
+}
+
+// Unmaps the trace and frees its streams, also after trace_load failed.
+static void trace_free(struct trace_file* trace) {
+  if (trace->data != NULL && trace->data != MAP_FAILED) {
+    munmap((void*)trace->data, trace->size);
+  }
+  if (trace->streams != NULL) {
+    for (size_t i = 0; i < trace->nstreams; ++i) {
+      free(trace->streams[i].chunks);
+      free(trace->streams[i].counts);
+    }
+    free(trace->streams);
+  }
+}
+
+// Picks the thread whose next event is earliest. Traces have few threads,
+// so a linear scan beats a heap.
+static struct stream* trace_next(struct trace_file* trace) {
+  struct stream* earliest = NULL;
+  uint64_t time = UINT64_MAX;
+  for (size_t i = 0; i < trace->nstreams; ++i) {
+    const struct vtpc_trace_event* event = stream_peek(&trace->streams[i]);
+    if (event != NULL && event->time < time) {
+      earliest = &trace->streams[i];
+      time = event->time;
+    }
+  }
+  return earliest;
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: vtpc_sim [-r rate] trace [capacity pages...]\n");
+}
+
+int main(int argc, char** argv) {
+  double rate = 0;
+  int arg = 1;
+  if (arg + 1 < argc && strcmp(argv[arg], "-r") == 0) {
+    rate = strtod(argv[arg + 1], NULL);
+    arg += 2;
+  }
+  if (arg >= argc || rate < 0 || rate > 1) {
+    usage();
+    return 2;
+  }
+
+  struct trace_file trace = {0};
+  if (trace_load(argv[arg], &trace) != 0) {
+    fprintf(stderr, "vtpc_sim: %s: %s\n", argv[arg], strerror(errno));
+    trace_free(&trace);
+    return 1;
+  }
+  arg += 1;
+
+  uint64_t capacities[SIM_CAPACITIES];
+  size_t count = 0;
+  for (; arg < argc && count < SIM_CAPACITIES; ++arg) {
+    capacities[count++] = strtoull(argv[arg], NULL, 10);
+  }
+  if (count == 0) {
+    for (uint64_t capacity = 16; count < 21; capacity *= 2) {
+      capacities[count++] = capacity;
+    }
+  }
+  for (size_t i = 1; i < count; ++i) {
+    for (size_t j = i; j > 0 && capacities[j - 1] > capacities[j]; --j) {
+      const uint64_t swap = capacities[j];
+      capacities[j] = capacities[j - 1];
+      capacities[j - 1] = swap;
+    }
+  }
+
+  if (rate == 0) {
+    rate = trace.events <= SIM_SAMPLED_EVENTS
+               ? 1
+               : (double)SIM_SAMPLED_EVENTS / (double)trace.events;
+  }
+  const uint64_t threshold =
+      (uint64_t)(rate * (double)(1ULL << SIM_SAMPLE_BITS));
+
+  struct stack_sim lru;
+  stack_init(&lru);
+  struct cache_sim sims[POLICIES][SIM_CAPACITIES];
+  for (int policy = 0; policy < POLICIES; ++policy) {
+    for (size_t i = 0; i < count; ++i) {
+      const double scaled = (double)capacities[i] * rate + 0.5;
+      cache_sim_init(&sims[policy][i], policy, (uint64_t)scaled);
+    }
+  }
+
+  uint64_t sampled = 0;
+  struct stream* s = NULL;
+  while ((s = trace_next(&trace)) != NULL) {
+    // A single-threaded trace is one stream; consume it without rescanning.
+    do {
+      const struct vtpc_trace_event* event = stream_peek(s);
+      const uint64_t key = (((uint64_t)event->file << 48U) ^ event->page) + 1;
+      stack_access(&lru, key, capacities, count);
+
+      if ((mix(key) & ((1ULL << SIM_SAMPLE_BITS) - 1)) < threshold) {
+        sampled += 1;
+        for (int policy = 0; policy < POLICIES; ++policy) {
+          for (size_t i = 0; i < count; ++i) {
+            cache_sim_access(&sims[policy][i], key);
+          }
+        }
+      }
+      stream_next(s);
+    } while (trace.nstreams == 1 && stream_peek(s) != NULL);
+  }
+
+  printf(
+      "events %llu, distinct pages %zu, page size %u, sampling rate %.4f\n",
+      (unsigned long long)trace.events,
+      lru.last.size,
+      trace.page_size,
+      rate
+  );
+  printf("%12s %10s %9s", "capacity", "MiB", "LRU");
+  for (int policy = 0; policy < POLICIES; ++policy) {
+    printf(" %9s", policy_names[policy]);
+  }
+  printf("\n");
+
+  uint64_t hits = 0;
+  for (size_t i = 0; i < count; ++i) {
+    const double events = trace.events == 0 ? 1 : (double)trace.events;
+    hits += lru.distances[i];
+    printf(
+        "%12llu %10.1f %9.4f",
+        (unsigned long long)capacities[i],
+        (double)capacities[i] * trace.page_size / (1024.0 * 1024.0),
+        (double)hits / events
+    );
+    for (int policy = 0; policy < POLICIES; ++policy) {
+      const double events = sampled == 0 ? 1 : (double)sampled;
+      printf(" %9.4f", (double)sims[policy][i].hits / events);
+      cache_sim_free(&sims[policy][i]);
+    }
+    printf("\n");
+  }
+  stack_free(&lru);
+  trace_free(&trace);
+  return 0;
+}
@@ -0,0 +1,218 @@
+#include "backend.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NS_PER_SEC 1000000000ULL
+
+static ssize_t file_read(int fd, void* buf, size_t count, off_t offset) {
+  return pread(fd, buf, count, offset);
+}
+
+static ssize_t file_write(
+    int fd, const struct iovec* iov, int count, off_t offset
+) {
+  return pwritev(fd, iov, count, offset);
+}
+
+static int file_sync(int fd) {
+  return fsync(fd);
+}
+
+static int file_truncate(int fd, off_t size) {
+  return ftruncate(fd, size);
+}
+
+static const struct vtpc_backend pread_backend = {
+    .name = "pread",
+    .read = file_read,
+    .write = file_write,
+    .sync = file_sync,
+    .truncate = file_truncate,
+};
+
+static const struct vtpc_backend direct_backend = {
+    .name = "direct",
+    .open_flags = O_DIRECT,
+    .read = file_read,
+    .write = file_write,
+    .sync = file_sync,
+    .truncate = file_truncate,
+};
+
+// The simulated device. Requests take a service slot, are given the time
+// they complete, do their I/O through the kernel page cache and then sleep
+// until that time, so the device and not the host sets the pace.
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t freed;
+  struct vtpc_device device;
+  uint32_t busy;
+  // When the IOPS cap admits the next request and when the shared transfer
+  // channel is free again.
+  uint64_t admit;
+  uint64_t channel;
+  uint64_t random;
+} sim = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .freed = PTHREAD_COND_INITIALIZER,
+    .device =
+        {
+            .latency_ns = 100 * 1000,
+            .distribution = VTPC_LATENCY_FIXED,
+            .bandwidth = NS_PER_SEC,
+            .depth = 32,
+            .seed = 1,
+        },
+    .random = 1,
+};
+
+static uint64_t clock_now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((uint64_t)now.tv_sec * NS_PER_SEC) + (uint64_t)now.tv_nsec;
+}
+
+// xorshift64*, which is plenty for latency jitter.
+static uint64_t sim_random(void) {
+  sim.random ^= sim.random >> 12U;
+  sim.random ^= sim.random << 25U;
+  sim.random ^= sim.random >> 27U;
+  return sim.random * 0x2545F4914F6CDD1DULL;
+}
+
+static uint64_t sim_latency(void) {
+  const uint64_t mean = sim.device.latency_ns;
+  switch (sim.device.distribution) {
+    case VTPC_LATENCY_UNIFORM:
+      return sim_random() % ((2 * mean) + 1);
+    case VTPC_LATENCY_EXPONENTIAL: {
+      // A uniform draw from (0, 1], so that the logarithm is finite.
+      const double unit = (double)((sim_random() >> 11U) + 1) * 0x1p-53;
+      return (uint64_t)(-log(unit) * (double)mean);
+    }
+    case VTPC_LATENCY_FIXED:
+    default:
+      return mean;
+  }
+}
+
+// Admits a request moving bytes and returns the time it completes.
+static uint64_t sim_begin(size_t bytes) {
+  pthread_mutex_lock(&sim.lock);
+  while (sim.device.depth != 0 && sim.busy >= sim.device.depth) {
+    pthread_cond_wait(&sim.freed, &sim.lock);
+  }
+  sim.busy += 1;
+
+  uint64_t start = clock_now();
+  if (sim.device.iops != 0) {
+    start = start > sim.admit ? start : sim.admit;
+    sim.admit = start + (NS_PER_SEC / sim.device.iops);
+  }
+  uint64_t done = start + sim_latency();
+  if (sim.device.bandwidth != 0 && bytes != 0) {
+    const uint64_t transfer =
+        (uint64_t)((double)bytes * (double)NS_PER_SEC /
+                   (double)sim.device.bandwidth);
+    done = (done > sim.channel ? done : sim.channel) + transfer;
+    sim.channel = done;
+  }
+  pthread_mutex_unlock(&sim.lock);
+  return done;
+}
+
+static void sim_end(uint64_t done) {
+  const struct timespec until = {
+      .tv_sec = (time_t)(done / NS_PER_SEC),
+      .tv_nsec = (long)(done % NS_PER_SEC),
+  };
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) ==
+         EINTR) {
+  }
+
+  pthread_mutex_lock(&sim.lock);
+  sim.busy -= 1;
+  pthread_cond_signal(&sim.freed);
+  pthread_mutex_unlock(&sim.lock);
+}
+
+static ssize_t sim_read(int fd, void* buf, size_t count, off_t offset) {
+  const uint64_t done = sim_begin(count);
+  const ssize_t status = pread(fd, buf, count, offset);
+  const int error = errno;
+  sim_end(done);
+  errno = error;
+  return status;
+}
+
+static ssize_t sim_write(
+    int fd, const struct iovec* iov, int count, off_t offset
+) {
+  size_t bytes = 0;
+  for (int i = 0; i < count; ++i) {
+    bytes += iov[i].iov_len;
+  }
+  const uint64_t done = sim_begin(bytes);
+  const ssize_t status = pwritev(fd, iov, count, offset);
+  const int error = errno;
+  sim_end(done);
+  errno = error;
+  return status;
+}
+
+static int sim_sync(int fd) {
+  const uint64_t done = sim_begin(0);
+  const int status = fsync(fd);
+  const int error = errno;
+  sim_end(done);
+  errno = error;
+  return status;
+}
+
+static const struct vtpc_backend sim_backend = {
+    .name = "sim",
+    .read = sim_read,
+    .write = sim_write,
+    .sync = sim_sync,
+    .truncate = file_truncate,
+};
+
+const struct vtpc_backend* vtpc_backend_find(const char* name) {
+  if (strcmp(name, pread_backend.name) == 0) {
+    return &pread_backend;
+  }
+  if (strcmp(name, direct_backend.name) == 0) {
+    return &direct_backend;
+  }
+  if (strcmp(name, sim_backend.name) == 0) {
+    return &sim_backend;
+  }
+  if (strcmp(name, "uring") == 0) {
+    return vtpc_uring_backend();
+  }
+  errno = EINVAL;
+  return NULL;
+}
+
+int vtpc_backend_set_device(const struct vtpc_device* device) {
+  if (device->distribution > VTPC_LATENCY_EXPONENTIAL) {
+    errno = EINVAL;
+    return -1;
+  }
+  pthread_mutex_lock(&sim.lock);
+  sim.device = *device;
+  sim.random = device->seed != 0 ? device->seed : 1;
+  sim.admit = 0;
+  sim.channel = 0;
+  pthread_cond_broadcast(&sim.freed);
+  pthread_mutex_unlock(&sim.lock);
+  return 0;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "vtpc.h"
+
+// Storage backends the cache does its file I/O through. Files are opened
+// and identified with open(2) and fstat(2) whatever the backend; the
+// backend adds its open flags and moves the data. Reads and writes are
+// positional and may be short, like pread(2) and pwritev(2), and every
+// function may be called from any thread.
+struct vtpc_backend {
+  const char* name;
+  // Flags added to open(2). O_DIRECT is dropped again for file systems that
+  // refuse it.
+  int open_flags;
+  ssize_t (*read)(int fd, void* buf, size_t count, off_t offset);
+  ssize_t (*write)(int fd, const struct iovec* iov, int count, off_t offset);
+  int (*sync)(int fd);
+  int (*truncate)(int fd, off_t size);
+};
+
+// Returns the backend called name: "pread", "direct", "uring" or "sim".
+// Fails with EINVAL for other names, and with the error of io_uring_setup
+// if the kernel does not support io_uring.
+const struct vtpc_backend* vtpc_backend_find(const char* name);
+
+// Sets the device the "sim" backend emulates. Requests already in service
+// keep the timing they were given.
+int vtpc_backend_set_device(const struct vtpc_device* device);
+
+// The io_uring backend, or NULL with errno set if io_uring is unavailable.
+const struct vtpc_backend* vtpc_uring_backend(void);
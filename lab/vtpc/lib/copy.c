@@ -0,0 +1,136 @@
+#include "copy.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+static void copy_memcpy(void* dst, const void* src, size_t count) {
+  memcpy(dst, src, count);
+}
+
+#if defined(__x86_64__)
+
+// Copies the bytes up to the next width-aligned address of dst with memcpy,
+// so the kernels stream whole aligned vectors, and returns their number.
+static size_t copy_head(
+    void* dst, const void* src, size_t count, size_t width
+) {
+  size_t head = (width - ((uintptr_t)dst & (width - 1))) & (width - 1);
+  if (head > count) {
+    head = count;
+  }
+  memcpy(dst, src, head);
+  return head;
+}
+
+// SSE2 is part of x86-64, so this kernel is always available there.
+static void copy_sse2(void* dst, const void* src, size_t count) {
+  const size_t head = copy_head(dst, src, count, 16);
+  char* to = (char*)dst + head;
+  const char* from = (const char*)src + head;
+  count -= head;
+
+  for (; count >= 64; count -= 64, to += 64, from += 64) {
+    const __m128i a = _mm_loadu_si128((const __m128i*)from);
+    const __m128i b = _mm_loadu_si128((const __m128i*)(from + 16));
+    const __m128i c = _mm_loadu_si128((const __m128i*)(from + 32));
+    const __m128i d = _mm_loadu_si128((const __m128i*)(from + 48));
+    _mm_stream_si128((__m128i*)to, a);
+    _mm_stream_si128((__m128i*)(to + 16), b);
+    _mm_stream_si128((__m128i*)(to + 32), c);
+    _mm_stream_si128((__m128i*)(to + 48), d);
+  }
+  memcpy(to, from, count);
+}
+
+__attribute__((target("avx2"))) static void copy_avx2(
+    void* dst, const void* src, size_t count
+) {
+  const size_t head = copy_head(dst, src, count, 32);
+  char* to = (char*)dst + head;
+  const char* from = (const char*)src + head;
+  count -= head;
+
+  for (; count >= 128; count -= 128, to += 128, from += 128) {
+    const __m256i a = _mm256_loadu_si256((const __m256i*)from);
+    const __m256i b = _mm256_loadu_si256((const __m256i*)(from + 32));
+    const __m256i c = _mm256_loadu_si256((const __m256i*)(from + 64));
+    const __m256i d = _mm256_loadu_si256((const __m256i*)(from + 96));
+    _mm256_stream_si256((__m256i*)to, a);
+    _mm256_stream_si256((__m256i*)(to + 32), b);
+    _mm256_stream_si256((__m256i*)(to + 64), c);
+    _mm256_stream_si256((__m256i*)(to + 96), d);
+  }
+  memcpy(to, from, count);
+}
+
+__attribute__((target("avx512f"))) static void copy_avx512(
+    void* dst, const void* src, size_t count
+) {
+  const size_t head = copy_head(dst, src, count, 64);
+  char* to = (char*)dst + head;
+  const char* from = (const char*)src + head;
+  count -= head;
+
+  for (; count >= 256; count -= 256, to += 256, from += 256) {
+    const __m512i a = _mm512_loadu_si512(from);
+    const __m512i b = _mm512_loadu_si512(from + 64);
+    const __m512i c = _mm512_loadu_si512(from + 128);
+    const __m512i d = _mm512_loadu_si512(from + 192);
+    _mm512_stream_si512((__m512i*)to, a);
+    _mm512_stream_si512((__m512i*)(to + 64), b);
+    _mm512_stream_si512((__m512i*)(to + 128), c);
+    _mm512_stream_si512((__m512i*)(to + 192), d);
+  }
+  memcpy(to, from, count);
+}
+
+#endif
+
+static vtpc_copy_fn* copy_stream = copy_memcpy;
+
+void vtpc_copy_init(void) {
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    copy_stream = copy_avx512;
+  } else if (__builtin_cpu_supports("avx2")) {
+    copy_stream = copy_avx2;
+  } else {
+    copy_stream = copy_sse2;
+  }
+#endif
+}
+
+void vtpc_copy_stream(void* dst, const void* src, size_t count) {
+  copy_stream(dst, src, count);
+}
+
+void vtpc_copy_fence(void) {
+#if defined(__x86_64__)
+  _mm_sfence();
+#endif
+}
+
+vtpc_copy_fn* vtpc_copy_kernel(const char* name) {
+  if (strcmp(name, "memcpy") == 0) {
+    return copy_memcpy;
+  }
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (strcmp(name, "sse2") == 0) {
+    return copy_sse2;
+  }
+  if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+    return copy_avx2;
+  }
+  if (strcmp(name, "avx512") == 0 && __builtin_cpu_supports("avx512f")) {
+    return copy_avx512;
+  }
+#endif
+  return NULL;
+}
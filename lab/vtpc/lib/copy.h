@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+
+#ifndef VTPC_STREAM_COPY_BYTES
+#define VTPC_STREAM_COPY_BYTES (256 * 1024)
+#endif
+
+// Copies between cache frames and user buffers. Transfers of at least
+// VTPC_STREAM_COPY_BYTES are streamed with non-temporal stores, which write
+// around the CPU caches so a large copy does not evict the caller's working
+// set. Smaller ones go through memcpy, whose own vector kernels are faster
+// while the data fits in cache.
+typedef void vtpc_copy_fn(void* dst, const void* src, size_t count);
+
+// Picks the widest streaming kernel the CPU supports. Called once before the
+// first copy.
+void vtpc_copy_init(void);
+
+// Streams count bytes to dst. A thread must call vtpc_copy_fence after its
+// streamed copies before publishing the destination, as non-temporal stores
+// are not ordered with other stores.
+void vtpc_copy_stream(void* dst, const void* src, size_t count);
+void vtpc_copy_fence(void);
+
+// Returns the kernel called name, one of "memcpy", "sse2", "avx2" and
+// "avx512", or NULL if this CPU cannot run it. For benchmarks.
+vtpc_copy_fn* vtpc_copy_kernel(const char* name);
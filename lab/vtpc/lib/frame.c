@@ -0,0 +1,309 @@
+#include "frame.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+struct vtpc_frame_magazine {
+  struct vtpc_frame_magazine* next;
+  uint32_t rounds;
+  uint32_t frames[VTPC_MAGAZINE_ROUNDS];
+};
+
+// The magazines of one thread. Its lock is only contended while the frames
+// are being reaped.
+struct vtpc_frame_cache {
+  pthread_mutex_t lock;
+  struct vtpc_frames* frames;
+  struct vtpc_frame_magazine* loaded;
+  struct vtpc_frame_magazine* previous;
+  struct vtpc_frame_cache* prev;
+  struct vtpc_frame_cache* next;
+};
+
+// Lock order: registry, then a thread's cache, then the depot.
+struct vtpc_frames {
+  pthread_key_t key;
+
+  pthread_mutex_t registry;
+  struct vtpc_frame_cache* caches;
+
+  pthread_mutex_t depot;
+  struct vtpc_frame_magazine* full;
+  struct vtpc_frame_magazine* empty;
+
+  // Tagged head of the lock-free list: the high half counts updates against
+  // ABA, the low half is the first frame plus one. Links use the same
+  // encoding, with zero ending the list.
+  _Atomic uint64_t head;
+  _Atomic uint32_t* links;
+};
+
+static void list_push(struct vtpc_frames* frames, uint32_t frame) {
+  uint64_t head = atomic_load(&frames->head);
+  uint64_t next = 0;
+  do {
+    atomic_store_explicit(
+        &frames->links[frame], (uint32_t)head, memory_order_relaxed
+    );
+    next = (((head >> 32U) + 1) << 32U) | (frame + 1);
+  } while (!atomic_compare_exchange_weak(&frames->head, &head, next));
+}
+
+static int64_t list_pop(struct vtpc_frames* frames) {
+  uint64_t head = atomic_load(&frames->head);
+  for (;;) {
+    const uint32_t first = (uint32_t)head;
+    if (first == 0) {
+      return -1;
+    }
+    const uint32_t link =
+        atomic_load_explicit(&frames->links[first - 1], memory_order_relaxed);
+    const uint64_t next = (((head >> 32U) + 1) << 32U) | link;
+    if (atomic_compare_exchange_weak(&frames->head, &head, next)) {
+      return first - 1;
+    }
+  }
+}
+
+static void magazine_spill(
+    struct vtpc_frames* frames, struct vtpc_frame_magazine* magazine
+) {
+  while (magazine->rounds != 0) {
+    magazine->rounds -= 1;
+    list_push(frames, magazine->frames[magazine->rounds]);
+  }
+}
+
+static void cache_exit(void* arg) {
+  struct vtpc_frame_cache* cache = arg;
+  struct vtpc_frames* frames = cache->frames;
+
+  pthread_mutex_lock(&frames->registry);
+  if (cache->prev != NULL) {
+    cache->prev->next = cache->next;
+  } else {
+    frames->caches = cache->next;
+  }
+  if (cache->next != NULL) {
+    cache->next->prev = cache->prev;
+  }
+  pthread_mutex_unlock(&frames->registry);
+
+  magazine_spill(frames, cache->loaded);
+  magazine_spill(frames, cache->previous);
+  free(cache->loaded);
+  free(cache->previous);
+  pthread_mutex_destroy(&cache->lock);
+  free(cache);
+}
+
+static struct vtpc_frame_cache* cache_get(struct vtpc_frames* frames) {
+  struct vtpc_frame_cache* cache = pthread_getspecific(frames->key);
+  if (cache != NULL) {
+    return cache;
+  }
+
+  cache = calloc(1, sizeof(*cache));
+  if (cache == NULL) {
+    return NULL;
+  }
+  cache->loaded = calloc(1, sizeof(*cache->loaded));
+  cache->previous = calloc(1, sizeof(*cache->previous));
+  if (cache->loaded == NULL || cache->previous == NULL ||
+      pthread_setspecific(frames->key, cache) != 0) {
+    free(cache->loaded);
+    free(cache->previous);
+    free(cache);
+    return NULL;
+  }
+  pthread_mutex_init(&cache->lock, NULL);
+  cache->frames = frames;
+
+  pthread_mutex_lock(&frames->registry);
+  cache->next = frames->caches;
+  if (frames->caches != NULL) {
+    frames->caches->prev = cache;
+  }
+  frames->caches = cache;
+  pthread_mutex_unlock(&frames->registry);
+  return cache;
+}
+
+// Swaps the empty loaded magazine for a full one from the depot, or else
+// fills it from the lock-free list in one batch.
+static void cache_refill(
+    struct vtpc_frames* frames, struct vtpc_frame_cache* cache
+) {
+  pthread_mutex_lock(&frames->depot);
+  struct vtpc_frame_magazine* full = frames->full;
+  if (full != NULL) {
+    frames->full = full->next;
+    cache->loaded->next = frames->empty;
+    frames->empty = cache->loaded;
+    cache->loaded = full;
+  }
+  pthread_mutex_unlock(&frames->depot);
+
+  struct vtpc_frame_magazine* loaded = cache->loaded;
+  while (loaded->rounds < VTPC_MAGAZINE_ROUNDS) {
+    const int64_t frame = list_pop(frames);
+    if (frame < 0) {
+      break;
+    }
+    loaded->frames[loaded->rounds] = (uint32_t)frame;
+    loaded->rounds += 1;
+  }
+}
+
+// Hands the full loaded magazine to the depot in exchange for an empty one.
+static bool cache_exchange(
+    struct vtpc_frames* frames, struct vtpc_frame_cache* cache
+) {
+  pthread_mutex_lock(&frames->depot);
+  struct vtpc_frame_magazine* empty = frames->empty;
+  if (empty != NULL) {
+    frames->empty = empty->next;
+  }
+  pthread_mutex_unlock(&frames->depot);
+
+  if (empty == NULL) {
+    empty = calloc(1, sizeof(*empty));
+    if (empty == NULL) {
+      return false;
+    }
+  }
+
+  pthread_mutex_lock(&frames->depot);
+  cache->loaded->next = frames->full;
+  frames->full = cache->loaded;
+  pthread_mutex_unlock(&frames->depot);
+
+  cache->loaded = empty;
+  return true;
+}
+
+struct vtpc_frames* vtpc_frames_create(uint32_t count) {
+  struct vtpc_frames* frames = calloc(1, sizeof(*frames));
+  if (frames == NULL) {
+    return NULL;
+  }
+  frames->links = calloc(count, sizeof(*frames->links));
+  if (frames->links == NULL ||
+      pthread_key_create(&frames->key, cache_exit) != 0) {
+    free(frames->links);
+    free(frames);
+    return NULL;
+  }
+  pthread_mutex_init(&frames->registry, NULL);
+  pthread_mutex_init(&frames->depot, NULL);
+
+  for (uint32_t frame = count; frame > 0; --frame) {
+    list_push(frames, frame - 1);
+  }
+  return frames;
+}
+
+void vtpc_frames_destroy(struct vtpc_frames* frames) {
+  pthread_key_delete(frames->key);
+  while (frames->caches != NULL) {
+    struct vtpc_frame_cache* cache = frames->caches;
+    frames->caches = cache->next;
+    free(cache->loaded);
+    free(cache->previous);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+  }
+
+  struct vtpc_frame_magazine* lists[] = {frames->full, frames->empty};
+  for (size_t i = 0; i < sizeof(lists) / sizeof(*lists); ++i) {
+    while (lists[i] != NULL) {
+      struct vtpc_frame_magazine* magazine = lists[i];
+      lists[i] = magazine->next;
+      free(magazine);
+    }
+  }
+
+  pthread_mutex_destroy(&frames->registry);
+  pthread_mutex_destroy(&frames->depot);
+  free(frames->links);
+  free(frames);
+}
+
+int64_t vtpc_frames_alloc(struct vtpc_frames* frames) {
+  struct vtpc_frame_cache* cache = cache_get(frames);
+  if (cache == NULL) {
+    return list_pop(frames);
+  }
+
+  pthread_mutex_lock(&cache->lock);
+  if (cache->loaded->rounds == 0 && cache->previous->rounds != 0) {
+    struct vtpc_frame_magazine* previous = cache->previous;
+    cache->previous = cache->loaded;
+    cache->loaded = previous;
+  }
+  if (cache->loaded->rounds == 0) {
+    cache_refill(frames, cache);
+  }
+
+  int64_t frame = -1;
+  struct vtpc_frame_magazine* loaded = cache->loaded;
+  if (loaded->rounds != 0) {
+    loaded->rounds -= 1;
+    frame = loaded->frames[loaded->rounds];
+  }
+  pthread_mutex_unlock(&cache->lock);
+  return frame;
+}
+
+void vtpc_frames_free(struct vtpc_frames* frames, uint32_t frame) {
+  struct vtpc_frame_cache* cache = cache_get(frames);
+  if (cache == NULL) {
+    list_push(frames, frame);
+    return;
+  }
+
+  pthread_mutex_lock(&cache->lock);
+  if (cache->loaded->rounds == VTPC_MAGAZINE_ROUNDS &&
+      cache->previous->rounds == 0) {
+    struct vtpc_frame_magazine* previous = cache->previous;
+    cache->previous = cache->loaded;
+    cache->loaded = previous;
+  }
+  if (cache->loaded->rounds == VTPC_MAGAZINE_ROUNDS &&
+      !cache_exchange(frames, cache)) {
+    pthread_mutex_unlock(&cache->lock);
+    list_push(frames, frame);
+    return;
+  }
+
+  struct vtpc_frame_magazine* loaded = cache->loaded;
+  loaded->frames[loaded->rounds] = frame;
+  loaded->rounds += 1;
+  pthread_mutex_unlock(&cache->lock);
+}
+
+void vtpc_frames_reap(struct vtpc_frames* frames) {
+  pthread_mutex_lock(&frames->registry);
+  for (struct vtpc_frame_cache* cache = frames->caches; cache != NULL;
+       cache = cache->next) {
+    pthread_mutex_lock(&cache->lock);
+    magazine_spill(frames, cache->loaded);
+    magazine_spill(frames, cache->previous);
+    pthread_mutex_unlock(&cache->lock);
+  }
+  pthread_mutex_unlock(&frames->registry);
+
+  pthread_mutex_lock(&frames->depot);
+  while (frames->full != NULL) {
+    struct vtpc_frame_magazine* magazine = frames->full;
+    frames->full = magazine->next;
+    magazine_spill(frames, magazine);
+    magazine->next = frames->empty;
+    frames->empty = magazine;
+  }
+  pthread_mutex_unlock(&frames->depot);
+}
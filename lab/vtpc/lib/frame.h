@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifndef VTPC_MAGAZINE_ROUNDS
+#define VTPC_MAGAZINE_ROUNDS 8
+#endif
+
+// Allocator of frame numbers [0, count) in the style of Bonwick's magazine
+// layer: each thread keeps a loaded and a previous magazine of free frames
+// and only goes to the shared depot to exchange a full or empty magazine.
+// When the depot has no full magazines, frames come from a lock-free list.
+struct vtpc_frames;
+
+struct vtpc_frames* vtpc_frames_create(uint32_t count);
+void vtpc_frames_destroy(struct vtpc_frames* frames);
+
+// Returns a free frame, or -1 if every frame is allocated or cached by other
+// threads.
+int64_t vtpc_frames_alloc(struct vtpc_frames* frames);
+void vtpc_frames_free(struct vtpc_frames* frames, uint32_t frame);
+
+// Moves the frames cached in every thread's magazines and in the depot back
+// to the shared list, where any thread can allocate them.
+void vtpc_frames_reap(struct vtpc_frames* frames);
@@ -0,0 +1,128 @@
+#include "ghost.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Keys are stored plus one, so that zero marks an empty index slot and an
+// entry of the ring that was taken out of order.
+struct vtpc_ghost {
+  uint64_t* ring;
+  uint32_t capacity;
+  uint32_t head;
+  uint32_t count;
+
+  // Open addressing with linear probing and backward-shift deletion, at
+  // most half full, mapping each key to its place in the ring.
+  uint64_t* keys;
+  uint32_t* places;
+  size_t mask;
+};
+
+static uint64_t ghost_mix(uint64_t key) {
+  key ^= key >> 33U;
+  key *= 0xFF51AFD7ED558CCDULL;
+  key ^= key >> 33U;
+  return key;
+}
+
+static size_t ghost_slot(const struct vtpc_ghost* ghost, uint64_t stored) {
+  size_t slot = ghost_mix(stored) & ghost->mask;
+  while (ghost->keys[slot] != 0 && ghost->keys[slot] != stored) {
+    slot = (slot + 1) & ghost->mask;
+  }
+  return slot;
+}
+
+static void ghost_erase(struct vtpc_ghost* ghost, size_t hole) {
+  size_t slot = hole;
+  for (;;) {
+    slot = (slot + 1) & ghost->mask;
+    if (ghost->keys[slot] == 0) {
+      break;
+    }
+    const size_t home = ghost_mix(ghost->keys[slot]) & ghost->mask;
+    if (((slot - home) & ghost->mask) >= ((slot - hole) & ghost->mask)) {
+      ghost->keys[hole] = ghost->keys[slot];
+      ghost->places[hole] = ghost->places[slot];
+      hole = slot;
+    }
+  }
+  ghost->keys[hole] = 0;
+}
+
+static uint64_t ghost_stored(uint64_t key) {
+  const uint64_t stored = key + 1;
+  return stored == 0 ? 1 : stored;
+}
+
+struct vtpc_ghost* vtpc_ghost_create(uint32_t capacity) {
+  struct vtpc_ghost* ghost = calloc(1, sizeof(*ghost));
+  if (ghost == NULL) {
+    return NULL;
+  }
+  size_t slots = 16;
+  while (slots < 2 * (size_t)capacity) {
+    slots <<= 1U;
+  }
+  ghost->capacity = capacity == 0 ? 1 : capacity;
+  ghost->ring = calloc(ghost->capacity, sizeof(*ghost->ring));
+  ghost->keys = calloc(slots, sizeof(*ghost->keys));
+  ghost->places = calloc(slots, sizeof(*ghost->places));
+  if (ghost->ring == NULL || ghost->keys == NULL || ghost->places == NULL) {
+    vtpc_ghost_destroy(ghost);
+    return NULL;
+  }
+  ghost->mask = slots - 1;
+  return ghost;
+}
+
+void vtpc_ghost_destroy(struct vtpc_ghost* ghost) {
+  free(ghost->ring);
+  free(ghost->keys);
+  free(ghost->places);
+  free(ghost);
+}
+
+bool vtpc_ghost_add(struct vtpc_ghost* ghost, uint64_t key) {
+  vtpc_ghost_take(ghost, key);
+
+  bool forgot = false;
+  if (ghost->count == ghost->capacity) {
+    const uint64_t oldest = ghost->ring[ghost->head];
+    if (oldest != 0) {
+      ghost_erase(ghost, ghost_slot(ghost, oldest));
+      forgot = true;
+    }
+    ghost->head = (ghost->head + 1) % ghost->capacity;
+    ghost->count -= 1;
+  }
+
+  const uint64_t stored = ghost_stored(key);
+  const uint32_t place = (ghost->head + ghost->count) % ghost->capacity;
+  ghost->ring[place] = stored;
+  ghost->count += 1;
+  const size_t slot = ghost_slot(ghost, stored);
+  ghost->keys[slot] = stored;
+  ghost->places[slot] = place;
+  return forgot;
+}
+
+bool vtpc_ghost_take(struct vtpc_ghost* ghost, uint64_t key) {
+  const size_t slot = ghost_slot(ghost, ghost_stored(key));
+  if (ghost->keys[slot] == 0) {
+    return false;
+  }
+  ghost->ring[ghost->places[slot]] = 0;
+  ghost_erase(ghost, slot);
+  return true;
+}
+
+void vtpc_ghost_clear(struct vtpc_ghost* ghost) {
+  memset(ghost->ring, 0, ghost->capacity * sizeof(*ghost->ring));
+  memset(ghost->keys, 0, (ghost->mask + 1) * sizeof(*ghost->keys));
+  ghost->head = 0;
+  ghost->count = 0;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// A FIFO of the keys of recently evicted blocks, holding no data, with O(1)
+// membership through an open-addressing index. Eviction policies use it to
+// recognize a miss on a block they let go of too early. Not thread-safe;
+// vtpc calls it under its cache lock.
+struct vtpc_ghost;
+
+struct vtpc_ghost* vtpc_ghost_create(uint32_t capacity);
+void vtpc_ghost_destroy(struct vtpc_ghost* ghost);
+
+// Remembers key as the newest entry, forgetting the oldest one when full.
+// Returns true if an entry was forgotten that way.
+bool vtpc_ghost_add(struct vtpc_ghost* ghost, uint64_t key);
+
+// Forgets key, and returns whether it was remembered.
+bool vtpc_ghost_take(struct vtpc_ghost* ghost, uint64_t key);
+
+void vtpc_ghost_clear(struct vtpc_ghost* ghost);
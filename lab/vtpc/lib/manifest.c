@@ -0,0 +1,200 @@
+#include "manifest.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct manifest_entry {
+  struct vtpc_manifest_file file;
+  uint32_t* blocks;
+};
+
+struct vtpc_manifest {
+  struct manifest_entry* entries;
+  size_t count;
+  size_t allocated;
+};
+
+struct vtpc_manifest* vtpc_manifest_create(void) {
+  return calloc(1, sizeof(struct vtpc_manifest));
+}
+
+void vtpc_manifest_destroy(struct vtpc_manifest* manifest) {
+  if (manifest == NULL) {
+    return;
+  }
+  for (size_t i = 0; i < manifest->count; ++i) {
+    free(manifest->entries[i].blocks);
+  }
+  free(manifest->entries);
+  free(manifest);
+}
+
+static struct manifest_entry* manifest_find(
+    struct vtpc_manifest* manifest, uint64_t dev, uint64_t ino
+) {
+  for (size_t i = 0; i < manifest->count; ++i) {
+    struct manifest_entry* entry = &manifest->entries[i];
+    if (entry->file.dev == dev && entry->file.ino == ino) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+// Stores the entry, taking ownership of its blocks.
+static int manifest_insert(
+    struct vtpc_manifest* manifest,
+    const struct vtpc_manifest_file* file,
+    uint32_t* blocks
+) {
+  struct manifest_entry* entry = manifest_find(manifest, file->dev, file->ino);
+  if (entry == NULL) {
+    if (manifest->count == manifest->allocated) {
+      const size_t allocated =
+          manifest->allocated == 0 ? 16 : 2 * manifest->allocated;
+      struct manifest_entry* entries =
+          realloc(manifest->entries, allocated * sizeof(*entries));
+      if (entries == NULL) {
+        free(blocks);
+        errno = ENOMEM;
+        return -1;
+      }
+      manifest->entries = entries;
+      manifest->allocated = allocated;
+    }
+    entry = &manifest->entries[manifest->count++];
+  } else {
+    free(entry->blocks);
+  }
+  entry->file = *file;
+  entry->blocks = blocks;
+  return 0;
+}
+
+int vtpc_manifest_read(struct vtpc_manifest* manifest, const char* path) {
+  FILE* stream = fopen(path, "rbe");
+  if (stream == NULL) {
+    return errno == ENOENT ? 0 : -1;
+  }
+
+  struct vtpc_manifest_header header;
+  int status = 0;
+  if (fread(&header, sizeof(header), 1, stream) != 1 ||
+      header.magic != VTPC_MANIFEST_MAGIC) {
+    errno = EINVAL;
+    status = -1;
+  }
+  for (uint32_t i = 0; status == 0 && i < header.files; ++i) {
+    struct vtpc_manifest_file file;
+    if (fread(&file, sizeof(file), 1, stream) != 1) {
+      errno = EINVAL;
+      status = -1;
+      break;
+    }
+    // One spare block keeps an empty list from allocating nothing.
+    uint32_t* blocks = malloc(((size_t)file.count + 1) * sizeof(*blocks));
+    if (blocks == NULL) {
+      errno = ENOMEM;
+      status = -1;
+      break;
+    }
+    if (fread(blocks, sizeof(*blocks), file.count, stream) != file.count) {
+      free(blocks);
+      errno = EINVAL;
+      status = -1;
+      break;
+    }
+    status = manifest_insert(manifest, &file, blocks);
+  }
+
+  fclose(stream);
+  return status;
+}
+
+int vtpc_manifest_write(
+    const struct vtpc_manifest* manifest, const char* path
+) {
+  const size_t length = strlen(path);
+  char* temporary = malloc(length + sizeof(".tmp"));
+  if (temporary == NULL) {
+    errno = ENOMEM;
+    return -1;
+  }
+  memcpy(temporary, path, length);
+  memcpy(temporary + length, ".tmp", sizeof(".tmp"));
+
+  FILE* stream = fopen(temporary, "wbe");
+  if (stream == NULL) {
+    free(temporary);
+    return -1;
+  }
+  const struct vtpc_manifest_header header = {
+      .magic = VTPC_MANIFEST_MAGIC,
+      .files = (uint32_t)manifest->count,
+  };
+  bool written = fwrite(&header, sizeof(header), 1, stream) == 1;
+  for (size_t i = 0; written && i < manifest->count; ++i) {
+    const struct manifest_entry* entry = &manifest->entries[i];
+    written = fwrite(&entry->file, sizeof(entry->file), 1, stream) == 1 &&
+              fwrite(
+                  entry->blocks,
+                  sizeof(*entry->blocks),
+                  entry->file.count,
+                  stream
+              ) == entry->file.count;
+  }
+
+  // The old manifest stays until the new one is complete.
+  written = fclose(stream) == 0 && written;
+  if (!written || rename(temporary, path) != 0) {
+    const int error = errno;
+    unlink(temporary);
+    free(temporary);
+    errno = error;
+    return -1;
+  }
+  free(temporary);
+  return 0;
+}
+
+int vtpc_manifest_put(
+    struct vtpc_manifest* manifest,
+    const struct vtpc_manifest_file* file,
+    const uint32_t* blocks
+) {
+  uint32_t* copy = malloc(((size_t)file->count + 1) * sizeof(*copy));
+  if (copy == NULL) {
+    errno = ENOMEM;
+    return -1;
+  }
+  memcpy(copy, blocks, file->count * sizeof(*copy));
+  return manifest_insert(manifest, file, copy);
+}
+
+uint32_t* vtpc_manifest_take(
+    struct vtpc_manifest* manifest, struct vtpc_manifest_file* file
+) {
+  struct manifest_entry* entry = manifest_find(manifest, file->dev, file->ino);
+  if (entry == NULL) {
+    return NULL;
+  }
+
+  uint32_t* blocks = entry->blocks;
+  const bool valid =
+      entry->file.size == file->size && entry->file.mtime == file->mtime;
+  if (valid) {
+    file->block = entry->file.block;
+    file->count = entry->file.count;
+  } else {
+    free(blocks);
+    blocks = NULL;
+  }
+  *entry = manifest->entries[--manifest->count];
+  return blocks;
+}
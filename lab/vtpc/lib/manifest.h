@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+
+// Hot-set manifests: for each file, the blocks it had cached, hottest first,
+// so that a later run can load them again before they are asked for. Files
+// are told apart by device and inode, and an entry only applies while the
+// file keeps the size and modification time it was recorded with. Not
+// thread-safe; vtpc calls it under its cache lock.
+#define VTPC_MANIFEST_MAGIC 0x31544f4843505456ULL  // "VTPCHOT1"
+
+// On-disk format: a header followed by one record per file, each followed
+// by its count block indices as uint32_t.
+struct vtpc_manifest_header {
+  uint64_t magic;
+  uint32_t files;
+  uint32_t reserved;
+};
+
+struct vtpc_manifest_file {
+  uint64_t dev;
+  uint64_t ino;
+  int64_t size;
+  int64_t mtime;
+  uint32_t block;
+  uint32_t count;
+};
+
+struct vtpc_manifest;
+
+struct vtpc_manifest* vtpc_manifest_create(void);
+void vtpc_manifest_destroy(struct vtpc_manifest* manifest);
+
+// Adds the entries of the manifest at path, replacing those of the same
+// files. A missing manifest adds nothing.
+int vtpc_manifest_read(struct vtpc_manifest* manifest, const char* path);
+
+// Replaces the manifest at path atomically.
+int vtpc_manifest_write(
+    const struct vtpc_manifest* manifest, const char* path
+);
+
+// Records the count blocks of a file, replacing its previous entry.
+int vtpc_manifest_put(
+    struct vtpc_manifest* manifest,
+    const struct vtpc_manifest_file* file,
+    const uint32_t* blocks
+);
+
+// Removes the entry of the file with the dev and ino of file. If size and
+// mtime match too, stores its block size and count in file and returns its
+// blocks, which the caller frees; otherwise returns NULL.
+uint32_t* vtpc_manifest_take(
+    struct vtpc_manifest* manifest, struct vtpc_manifest_file* file
+);
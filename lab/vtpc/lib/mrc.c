@@ -0,0 +1,346 @@
+#include "mrc.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Hashes are compared against the threshold in this many bits.
+#define MRC_HASH_BITS 24U
+#define MRC_HASH_RANGE (1U << MRC_HASH_BITS)
+#define MRC_NONE UINT32_MAX
+
+// A tracked key. Its time is the position of its latest reference in the
+// Fenwick tree over reference times, and its position its place in the heap.
+struct mrc_entry {
+  uint64_t key;
+  uint32_t hash;
+  uint32_t weight;
+  uint32_t time;
+  uint32_t position;
+};
+
+struct vtpc_mrc {
+  uint32_t samples;
+  uint32_t threshold;
+
+  // Entries by key, with entry numbers plus one as values and zero as empty.
+  uint32_t* slots;
+  uint32_t mask;
+
+  struct mrc_entry* entries;
+  uint32_t nentries;
+
+  // Max-heap of entry numbers by hash, for lowering the threshold.
+  uint32_t* heap;
+
+  // Reference times marking the latest reference of each tracked key with
+  // its weight, and the entry each marked time belongs to.
+  uint32_t* tree;
+  uint32_t* owners;
+  uint32_t width;
+  uint32_t now;
+
+  uint64_t* histogram;
+  uint32_t bins;
+  uint64_t step;
+  uint64_t total;
+  double expected;
+  uint64_t window;
+  uint64_t references;
+};
+
+static uint64_t mix(uint64_t key) {
+  key ^= key >> 33U;
+  key *= 0xFF51AFD7ED558CCDULL;
+  key ^= key >> 33U;
+  key *= 0xC4CEB9FE1A85EC53ULL;
+  key ^= key >> 33U;
+  return key;
+}
+
+static uint32_t slot_home(const struct vtpc_mrc* mrc, uint64_t key) {
+  return (uint32_t)(mix(key) >> MRC_HASH_BITS) & mrc->mask;
+}
+
+static uint32_t slot_find(const struct vtpc_mrc* mrc, uint64_t key) {
+  uint32_t slot = slot_home(mrc, key);
+  while (mrc->slots[slot] != 0 &&
+         mrc->entries[mrc->slots[slot] - 1].key != key) {
+    slot = (slot + 1) & mrc->mask;
+  }
+  return slot;
+}
+
+// Removes the key at slot, shifting later keys of its cluster back so that
+// lookups never need tombstones.
+static void slot_erase(struct vtpc_mrc* mrc, uint32_t hole) {
+  uint32_t slot = hole;
+  for (;;) {
+    slot = (slot + 1) & mrc->mask;
+    if (mrc->slots[slot] == 0) {
+      break;
+    }
+    const uint64_t key = mrc->entries[mrc->slots[slot] - 1].key;
+    const uint32_t home = slot_home(mrc, key);
+    if (((slot - home) & mrc->mask) >= ((slot - hole) & mrc->mask)) {
+      mrc->slots[hole] = mrc->slots[slot];
+      hole = slot;
+    }
+  }
+  mrc->slots[hole] = 0;
+}
+
+static uint32_t heap_hash(const struct vtpc_mrc* mrc, uint32_t position) {
+  return mrc->entries[mrc->heap[position]].hash;
+}
+
+static void heap_set(struct vtpc_mrc* mrc, uint32_t position, uint32_t entry) {
+  mrc->heap[position] = entry;
+  mrc->entries[entry].position = position;
+}
+
+static void heap_swap(struct vtpc_mrc* mrc, uint32_t a, uint32_t b) {
+  const uint32_t entry = mrc->heap[a];
+  heap_set(mrc, a, mrc->heap[b]);
+  heap_set(mrc, b, entry);
+}
+
+static void heap_push(struct vtpc_mrc* mrc, uint32_t entry) {
+  uint32_t position = mrc->nentries - 1;
+  heap_set(mrc, position, entry);
+  while (position > 0) {
+    const uint32_t parent = (position - 1) / 2;
+    if (heap_hash(mrc, parent) >= heap_hash(mrc, position)) {
+      break;
+    }
+    heap_swap(mrc, parent, position);
+    position = parent;
+  }
+}
+
+// Removes the entry with the largest hash from the heap and returns it.
+static uint32_t heap_pop(struct vtpc_mrc* mrc) {
+  const uint32_t top = mrc->heap[0];
+  const uint32_t size = mrc->nentries - 1;
+  heap_set(mrc, 0, mrc->heap[size]);
+  uint32_t position = 0;
+  for (;;) {
+    const uint32_t left = (2 * position) + 1;
+    uint32_t largest = position;
+    if (left < size && heap_hash(mrc, left) > heap_hash(mrc, largest)) {
+      largest = left;
+    }
+    if (left + 1 < size && heap_hash(mrc, left + 1) > heap_hash(mrc, largest)) {
+      largest = left + 1;
+    }
+    if (largest == position) {
+      break;
+    }
+    heap_swap(mrc, position, largest);
+    position = largest;
+  }
+  return top;
+}
+
+static void tree_add(struct vtpc_mrc* mrc, uint32_t time, uint32_t delta) {
+  for (uint32_t i = time + 1; i <= mrc->width; i += i & -i) {
+    mrc->tree[i - 1] += delta;
+  }
+}
+
+static uint32_t tree_sum(const struct vtpc_mrc* mrc, uint32_t time) {
+  uint32_t sum = 0;
+  for (uint32_t i = time; i > 0; i -= i & -i) {
+    sum += mrc->tree[i - 1];
+  }
+  return sum;
+}
+
+// Renumbers the marked times from zero in order. At most samples keys are
+// marked and the tree is twice as wide, so at least half of it frees up.
+static void tree_compact(struct vtpc_mrc* mrc) {
+  uint32_t live = 0;
+  for (uint32_t time = 0; time < mrc->now; ++time) {
+    const uint32_t entry = mrc->owners[time];
+    if (entry != MRC_NONE) {
+      mrc->owners[live] = entry;
+      mrc->entries[entry].time = live;
+      live += 1;
+    }
+  }
+
+  memset(mrc->tree, 0, mrc->width * sizeof(*mrc->tree));
+  for (uint32_t i = 1; i <= mrc->width; ++i) {
+    if (i <= live) {
+      mrc->tree[i - 1] += mrc->entries[mrc->owners[i - 1]].weight;
+    }
+    const uint32_t parent = i + (i & -i);
+    if (parent <= mrc->width) {
+      mrc->tree[parent - 1] += mrc->tree[i - 1];
+    }
+  }
+  for (uint32_t time = live; time < mrc->width; ++time) {
+    mrc->owners[time] = MRC_NONE;
+  }
+  mrc->now = live;
+}
+
+static void tree_mark(struct vtpc_mrc* mrc, uint32_t entry) {
+  if (mrc->now == mrc->width) {
+    tree_compact(mrc);
+  }
+  mrc->entries[entry].time = mrc->now;
+  mrc->owners[mrc->now] = entry;
+  tree_add(mrc, mrc->now, mrc->entries[entry].weight);
+  mrc->now += 1;
+}
+
+static void tree_unmark(struct vtpc_mrc* mrc, uint32_t entry) {
+  const uint32_t time = mrc->entries[entry].time;
+  tree_add(mrc, time, -mrc->entries[entry].weight);
+  mrc->owners[time] = MRC_NONE;
+}
+
+struct vtpc_mrc* vtpc_mrc_create(
+    uint32_t samples, uint32_t bins, uint64_t step, uint64_t window
+) {
+  struct vtpc_mrc* mrc = calloc(1, sizeof(*mrc));
+  if (mrc == NULL) {
+    return NULL;
+  }
+
+  uint32_t slots = 1;
+  while (slots < 2 * samples) {
+    slots <<= 1U;
+  }
+  mrc->samples = samples;
+  mrc->threshold = MRC_HASH_RANGE;
+  mrc->mask = slots - 1;
+  mrc->width = 2 * samples;
+  mrc->bins = bins;
+  mrc->step = step;
+  mrc->window = window;
+
+  // One entry more than tracked, for the key inserted before the largest
+  // hash is dropped.
+  mrc->slots = calloc(slots, sizeof(*mrc->slots));
+  mrc->entries = calloc(samples + 1, sizeof(*mrc->entries));
+  mrc->heap = calloc(samples + 1, sizeof(*mrc->heap));
+  mrc->tree = calloc(mrc->width, sizeof(*mrc->tree));
+  mrc->owners = malloc(mrc->width * sizeof(*mrc->owners));
+  mrc->histogram = calloc(bins, sizeof(*mrc->histogram));
+  if (mrc->slots == NULL || mrc->entries == NULL || mrc->heap == NULL ||
+      mrc->tree == NULL || mrc->owners == NULL || mrc->histogram == NULL) {
+    vtpc_mrc_destroy(mrc);
+    return NULL;
+  }
+  for (uint32_t time = 0; time < mrc->width; ++time) {
+    mrc->owners[time] = MRC_NONE;
+  }
+  return mrc;
+}
+
+void vtpc_mrc_destroy(struct vtpc_mrc* mrc) {
+  free(mrc->slots);
+  free(mrc->entries);
+  free(mrc->heap);
+  free(mrc->tree);
+  free(mrc->owners);
+  free(mrc->histogram);
+  free(mrc);
+}
+
+// Stops tracking the key with the largest hash and samples only hashes
+// below it from now on.
+static void mrc_shrink(struct vtpc_mrc* mrc) {
+  const uint32_t victim = heap_pop(mrc);
+  mrc->threshold = mrc->entries[victim].hash;
+  tree_unmark(mrc, victim);
+  slot_erase(mrc, slot_find(mrc, mrc->entries[victim].key));
+
+  // Keep entries dense by moving the last one into the freed place.
+  const uint32_t last = mrc->nentries - 1;
+  mrc->nentries = last;
+  if (victim == last) {
+    return;
+  }
+  mrc->entries[victim] = mrc->entries[last];
+  mrc->slots[slot_find(mrc, mrc->entries[victim].key)] = victim + 1;
+  mrc->owners[mrc->entries[victim].time] = victim;
+  mrc->heap[mrc->entries[victim].position] = victim;
+}
+
+bool vtpc_mrc_access(struct vtpc_mrc* mrc, uint64_t key, uint32_t weight) {
+  const uint32_t hash = (uint32_t)mix(key) & (MRC_HASH_RANGE - 1);
+  mrc->expected += (double)mrc->threshold / MRC_HASH_RANGE;
+  if (hash >= mrc->threshold) {
+    return false;
+  }
+
+  const uint32_t slot = slot_find(mrc, key);
+  if (mrc->slots[slot] != 0) {
+    const uint32_t entry = mrc->slots[slot] - 1;
+    const uint32_t time = mrc->entries[entry].time;
+    const uint64_t distance =
+        tree_sum(mrc, mrc->now) - tree_sum(mrc, time + 1) + weight;
+
+    // Each sampled key stands for MRC_HASH_RANGE / threshold keys.
+    const uint64_t scaled = distance * MRC_HASH_RANGE / mrc->threshold;
+    const uint64_t bin = (scaled + mrc->step - 1) / mrc->step - 1;
+    if (bin < mrc->bins) {
+      mrc->histogram[bin] += 1;
+    }
+    tree_unmark(mrc, entry);
+    mrc->entries[entry].weight = weight;
+    tree_mark(mrc, entry);
+  } else {
+    const uint32_t entry = mrc->nentries;
+    mrc->nentries += 1;
+    mrc->entries[entry].key = key;
+    mrc->entries[entry].hash = hash;
+    mrc->entries[entry].weight = weight;
+    mrc->slots[slot] = entry + 1;
+    heap_push(mrc, entry);
+    tree_mark(mrc, entry);
+    // Keys sharing the dropped hash are no longer sampled either.
+    if (mrc->nentries > mrc->samples) {
+      do {
+        mrc_shrink(mrc);
+      } while (mrc->nentries != 0 && heap_hash(mrc, 0) >= mrc->threshold);
+    }
+  }
+
+  mrc->total += 1;
+  mrc->references += 1;
+  if (mrc->references < mrc->window) {
+    return false;
+  }
+  mrc->references = 0;
+  for (uint32_t bin = 0; bin < mrc->bins; ++bin) {
+    mrc->histogram[bin] /= 2;
+  }
+  mrc->total /= 2;
+  mrc->expected /= 2;
+  return true;
+}
+
+// A few hot keys in or out of the sample skew the counts, so as in SHARDS-adj
+// the difference between the expected and the actual number of sampled
+// references is credited to the smallest distances.
+void vtpc_mrc_curve(const struct vtpc_mrc* mrc, double* curve, size_t count) {
+  double hits = mrc->expected - (double)mrc->total;
+  for (size_t i = 0; i < count; ++i) {
+    if (i < mrc->bins) {
+      hits += (double)mrc->histogram[i];
+    }
+    double ratio = mrc->total == 0 ? 1 : 1 - (hits / mrc->expected);
+    if (ratio < 0) {
+      ratio = 0;
+    } else if (ratio > 1) {
+      ratio = 1;
+    }
+    curve[i] = ratio;
+  }
+}
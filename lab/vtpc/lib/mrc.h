@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Online miss-ratio curve estimator in the style of fixed-size SHARDS
+// (Waldspurger et al., FAST 2015). References are spatially sampled by key
+// hash, and the sampling threshold drops whenever more than a fixed number
+// of keys is tracked, so memory stays constant whatever the working set.
+// Reuse distances of sampled references, the summed weights of the distinct
+// keys referenced since, are scaled by the sampling rate into a histogram of
+// bins step wide each, aged by halving every window sampled references. Not
+// thread-safe; vtpc calls it under its cache lock.
+struct vtpc_mrc;
+
+struct vtpc_mrc* vtpc_mrc_create(
+    uint32_t samples, uint32_t bins, uint64_t step, uint64_t window
+);
+void vtpc_mrc_destroy(struct vtpc_mrc* mrc);
+
+// Records a reference to key, which takes weight units of cache space.
+// Returns true when the reference completes a window, so the caller knows
+// when the curve has new data.
+bool vtpc_mrc_access(struct vtpc_mrc* mrc, uint64_t key, uint32_t weight);
+
+// Stores the estimated miss ratio of a cache of (i + 1) * step units in
+// curve[i] for every bin i < count. Without samples every ratio is one.
+void vtpc_mrc_curve(const struct vtpc_mrc* mrc, double* curve, size_t count);
@@ -0,0 +1,127 @@
+#include "reclaim.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// The epoch a thread is reading in, or zero outside a section.
+struct vtpc_reclaim_record {
+  _Atomic uint64_t epoch;
+  struct vtpc_reclaim* reclaim;
+  struct vtpc_reclaim_record* prev;
+  struct vtpc_reclaim_record* next;
+};
+
+struct vtpc_reclaim {
+  pthread_key_t key;
+  // Epochs start at one, so that zero marks an idle record.
+  _Atomic uint64_t epoch;
+
+  pthread_mutex_t registry;
+  struct vtpc_reclaim_record* records;
+};
+
+static void record_exit(void* arg) {
+  struct vtpc_reclaim_record* record = arg;
+  struct vtpc_reclaim* reclaim = record->reclaim;
+
+  pthread_mutex_lock(&reclaim->registry);
+  if (record->prev != NULL) {
+    record->prev->next = record->next;
+  } else {
+    reclaim->records = record->next;
+  }
+  if (record->next != NULL) {
+    record->next->prev = record->prev;
+  }
+  pthread_mutex_unlock(&reclaim->registry);
+  free(record);
+}
+
+static struct vtpc_reclaim_record* record_get(struct vtpc_reclaim* reclaim) {
+  struct vtpc_reclaim_record* record = pthread_getspecific(reclaim->key);
+  if (record != NULL) {
+    return record;
+  }
+
+  record = calloc(1, sizeof(*record));
+  if (record == NULL) {
+    return NULL;
+  }
+  if (pthread_setspecific(reclaim->key, record) != 0) {
+    free(record);
+    return NULL;
+  }
+  record->reclaim = reclaim;
+
+  pthread_mutex_lock(&reclaim->registry);
+  record->next = reclaim->records;
+  if (reclaim->records != NULL) {
+    reclaim->records->prev = record;
+  }
+  reclaim->records = record;
+  pthread_mutex_unlock(&reclaim->registry);
+  return record;
+}
+
+struct vtpc_reclaim* vtpc_reclaim_create(void) {
+  struct vtpc_reclaim* reclaim = calloc(1, sizeof(*reclaim));
+  if (reclaim == NULL) {
+    return NULL;
+  }
+  if (pthread_key_create(&reclaim->key, record_exit) != 0) {
+    free(reclaim);
+    return NULL;
+  }
+  pthread_mutex_init(&reclaim->registry, NULL);
+  atomic_init(&reclaim->epoch, 1);
+  return reclaim;
+}
+
+void vtpc_reclaim_destroy(struct vtpc_reclaim* reclaim) {
+  pthread_key_delete(reclaim->key);
+  while (reclaim->records != NULL) {
+    struct vtpc_reclaim_record* record = reclaim->records;
+    reclaim->records = record->next;
+    free(record);
+  }
+  pthread_mutex_destroy(&reclaim->registry);
+  free(reclaim);
+}
+
+bool vtpc_reclaim_enter(struct vtpc_reclaim* reclaim) {
+  struct vtpc_reclaim_record* record = record_get(reclaim);
+  if (record == NULL) {
+    return false;
+  }
+  // Sequentially consistent, so a retirer that misses the announcement
+  // advanced the epoch before the reader could reach what it retired.
+  atomic_store(&record->epoch, atomic_load(&reclaim->epoch));
+  return true;
+}
+
+void vtpc_reclaim_exit(struct vtpc_reclaim* reclaim) {
+  struct vtpc_reclaim_record* record = pthread_getspecific(reclaim->key);
+  atomic_store_explicit(&record->epoch, 0, memory_order_release);
+}
+
+uint64_t vtpc_reclaim_retire(struct vtpc_reclaim* reclaim) {
+  return atomic_fetch_add(&reclaim->epoch, 1);
+}
+
+uint64_t vtpc_reclaim_safe(struct vtpc_reclaim* reclaim) {
+  uint64_t safe = atomic_load(&reclaim->epoch);
+  pthread_mutex_lock(&reclaim->registry);
+  for (const struct vtpc_reclaim_record* record = reclaim->records;
+       record != NULL;
+       record = record->next) {
+    const uint64_t epoch = atomic_load(&record->epoch);
+    if (epoch != 0 && epoch < safe) {
+      safe = epoch;
+    }
+  }
+  pthread_mutex_unlock(&reclaim->registry);
+  return safe;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Epoch-based reclamation (Fraser, 2004). Readers announce the epoch they
+// enter in a record of their thread, objects are retired in the epoch
+// current when they were unlinked, and an object may be reused once no
+// reader is left in its epoch or an earlier one. Neither entering, leaving
+// nor retiring ever waits; only finding the safe epoch walks the threads.
+struct vtpc_reclaim;
+
+struct vtpc_reclaim* vtpc_reclaim_create(void);
+void vtpc_reclaim_destroy(struct vtpc_reclaim* reclaim);
+
+// Enters and leaves a read-side section of the calling thread, which must
+// not nest. Objects reachable on entry stay allocated until it is left.
+// Fails only when the thread's record cannot be allocated.
+bool vtpc_reclaim_enter(struct vtpc_reclaim* reclaim);
+void vtpc_reclaim_exit(struct vtpc_reclaim* reclaim);
+
+// Returns the epoch of an object unlinked before the call, and starts the
+// next epoch.
+uint64_t vtpc_reclaim_retire(struct vtpc_reclaim* reclaim);
+
+// Returns the oldest epoch a reader may still be in. Objects retired in an
+// earlier epoch may be reused.
+uint64_t vtpc_reclaim_safe(struct vtpc_reclaim* reclaim);
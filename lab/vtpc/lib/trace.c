@@ -0,0 +1,252 @@
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef VTPC_TRACE_EVENTS
+#define VTPC_TRACE_EVENTS 4096
+#endif
+
+// A chunk of a thread's events. The thread fills it without synchronization
+// and hands it to the writer thread once full, taking a spare one instead.
+struct vtpc_trace_buffer {
+  struct vtpc_trace_chunk chunk;
+  struct vtpc_trace_event events[VTPC_TRACE_EVENTS];
+  struct vtpc_trace_buffer* next;
+};
+
+struct vtpc_trace_thread {
+  struct vtpc_trace_buffer* buffer;
+  struct vtpc_trace_thread* next;
+};
+
+atomic_bool vtpc_trace_active;
+
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t ready;
+  pthread_t writer;
+  bool closing;
+  int fd;
+  int error;
+
+  uint64_t generation;
+  uint64_t start;
+  uint32_t count;
+  struct vtpc_trace_thread* threads;
+  struct vtpc_trace_buffer* queue;
+  struct vtpc_trace_buffer** tail;
+  struct vtpc_trace_buffer* spare;
+} trace = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .ready = PTHREAD_COND_INITIALIZER,
+    .fd = -1,
+};
+
+static _Thread_local struct vtpc_trace_thread* local;
+static _Thread_local uint64_t local_generation;
+
+static uint64_t trace_now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((uint64_t)now.tv_sec * 1000000000ULL) + (uint64_t)now.tv_nsec;
+}
+
+static int write_all(int fd, const void* buf, size_t count) {
+  size_t done = 0;
+  while (done < count) {
+    const ssize_t local = write(fd, (const char*)buf + done, count - done);
+    if (local < 0 && errno == EINTR) {
+      continue;
+    }
+    if (local <= 0) {
+      return -1;
+    }
+    done += local;
+  }
+  return 0;
+}
+
+// Queues the buffer for writing and returns a spare one for the same thread.
+static struct vtpc_trace_buffer* trace_submit(
+    struct vtpc_trace_buffer* buffer
+) {
+  const uint32_t thread = buffer->chunk.thread;
+
+  pthread_mutex_lock(&trace.lock);
+  buffer->next = NULL;
+  *trace.tail = buffer;
+  trace.tail = &buffer->next;
+  pthread_cond_signal(&trace.ready);
+
+  struct vtpc_trace_buffer* spare = trace.spare;
+  if (spare != NULL) {
+    trace.spare = spare->next;
+  }
+  pthread_mutex_unlock(&trace.lock);
+
+  if (spare == NULL) {
+    spare = malloc(sizeof(*spare));
+    if (spare == NULL) {
+      return NULL;
+    }
+  }
+  spare->chunk.thread = thread;
+  spare->chunk.count = 0;
+  return spare;
+}
+
+static void* writer_main(void* arg) {
+  (void)arg;
+
+  pthread_mutex_lock(&trace.lock);
+  for (;;) {
+    while (trace.queue == NULL && !trace.closing) {
+      pthread_cond_wait(&trace.ready, &trace.lock);
+    }
+    struct vtpc_trace_buffer* buffer = trace.queue;
+    if (buffer == NULL) {
+      break;
+    }
+    trace.queue = buffer->next;
+    if (trace.queue == NULL) {
+      trace.tail = &trace.queue;
+    }
+    pthread_mutex_unlock(&trace.lock);
+
+    // The events follow the chunk header directly in the buffer.
+    const size_t size = sizeof(buffer->chunk) +
+                        (buffer->chunk.count * sizeof(*buffer->events));
+    const int status = write_all(trace.fd, buffer, size);
+    const int error = errno;
+
+    pthread_mutex_lock(&trace.lock);
+    if (status != 0 && trace.error == 0) {
+      trace.error = error;
+    }
+    buffer->next = trace.spare;
+    trace.spare = buffer;
+  }
+  pthread_mutex_unlock(&trace.lock);
+  return NULL;
+}
+
+int vtpc_trace_open(const char* path, uint32_t page_size) {
+  if (atomic_load(&vtpc_trace_active)) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return -1;
+  }
+  const struct vtpc_trace_header header = {
+      .magic = VTPC_TRACE_MAGIC,
+      .page_size = page_size,
+  };
+  if (write_all(fd, &header, sizeof(header)) != 0) {
+    close(fd);
+    return -1;
+  }
+
+  trace.fd = fd;
+  trace.error = 0;
+  trace.closing = false;
+  trace.generation += 1;
+  trace.start = trace_now();
+  trace.count = 0;
+  trace.threads = NULL;
+  trace.queue = NULL;
+  trace.tail = &trace.queue;
+  if (pthread_create(&trace.writer, NULL, writer_main, NULL) != 0) {
+    close(fd);
+    trace.fd = -1;
+    errno = EAGAIN;
+    return -1;
+  }
+
+  atomic_store(&vtpc_trace_active, true);
+  return 0;
+}
+
+int vtpc_trace_close(void) {
+  if (!atomic_load(&vtpc_trace_active)) {
+    errno = EINVAL;
+    return -1;
+  }
+  atomic_store(&vtpc_trace_active, false);
+
+  while (trace.threads != NULL) {
+    struct vtpc_trace_thread* thread = trace.threads;
+    trace.threads = thread->next;
+    if (thread->buffer != NULL && thread->buffer->chunk.count != 0) {
+      free(trace_submit(thread->buffer));
+    } else {
+      free(thread->buffer);
+    }
+    free(thread);
+  }
+
+  pthread_mutex_lock(&trace.lock);
+  trace.closing = true;
+  pthread_cond_signal(&trace.ready);
+  pthread_mutex_unlock(&trace.lock);
+  pthread_join(trace.writer, NULL);
+
+  while (trace.spare != NULL) {
+    struct vtpc_trace_buffer* buffer = trace.spare;
+    trace.spare = buffer->next;
+    free(buffer);
+  }
+
+  const int error = trace.error;
+  const int status = close(trace.fd);
+  trace.fd = -1;
+  if (status != 0 || error != 0) {
+    errno = error != 0 ? error : errno;
+    return -1;
+  }
+  return 0;
+}
+
+void vtpc_trace_append(uint16_t file, uint64_t page, enum vtpc_trace_op op) {
+  if (local == NULL || local_generation != trace.generation) {
+    struct vtpc_trace_thread* thread = calloc(1, sizeof(*thread));
+    struct vtpc_trace_buffer* buffer = calloc(1, sizeof(*buffer));
+    if (thread == NULL || buffer == NULL) {
+      free(thread);
+      free(buffer);
+      return;
+    }
+    buffer->chunk.thread = trace.count++;
+    thread->buffer = buffer;
+    thread->next = trace.threads;
+    trace.threads = thread;
+    local = thread;
+    local_generation = trace.generation;
+  }
+
+  struct vtpc_trace_buffer* buffer = local->buffer;
+  if (buffer == NULL) {
+    return;
+  }
+  buffer->events[buffer->chunk.count] = (struct vtpc_trace_event){
+      .time = trace_now() - trace.start,
+      .page = page,
+      .file = file,
+      .op = (uint8_t)op,
+  };
+  buffer->chunk.count += 1;
+  if (buffer->chunk.count == VTPC_TRACE_EVENTS) {
+    local->buffer = trace_submit(buffer);
+  }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+// On-disk format of vtpc access traces: a header followed by chunks. Each
+// chunk holds the events of one thread in time order, so a reader merges the
+// chunks of different threads by time.
+#define VTPC_TRACE_MAGIC 0x3243525443505456ULL  // "VTPCTRC2"
+
+enum vtpc_trace_op {
+  VTPC_TRACE_READ,
+  VTPC_TRACE_WRITE,
+  VTPC_TRACE_FAULT,
+};
+
+struct vtpc_trace_header {
+  uint64_t magic;
+  uint32_t page_size;
+  uint32_t reserved;
+};
+
+struct vtpc_trace_chunk {
+  uint32_t thread;
+  uint32_t count;
+};
+
+struct vtpc_trace_event {
+  uint64_t time;
+  uint64_t page;
+  uint16_t file;
+  uint8_t op;
+  uint8_t reserved[5];
+};
+
+extern atomic_bool vtpc_trace_active;
+
+int vtpc_trace_open(const char* path, uint32_t page_size);
+int vtpc_trace_close(void);
+void vtpc_trace_append(uint16_t file, uint64_t page, enum vtpc_trace_op op);
+
+// Records a page access if a trace is open. Recording and closing the trace
+// must not run concurrently; vtpc does both under its cache lock.
+static inline void vtpc_trace(
+    uint16_t file, uint64_t page, enum vtpc_trace_op op
+) {
+  if (atomic_load_explicit(&vtpc_trace_active, memory_order_relaxed)) {
+    vtpc_trace_append(file, page, op);
+  }
+}
@@ -0,0 +1,236 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "backend.h"
+
+// Each thread submits through a small ring of its own and waits for its
+// request, so threads never see each other's completions. The rings are
+// set up on first use with raw system calls and torn down at thread exit.
+#define URING_ENTRIES 4
+
+struct uring {
+  int fd;
+  void* sq_ring;
+  size_t sq_size;
+  void* cq_ring;
+  size_t cq_size;
+  struct io_uring_sqe* sqes;
+  size_t sqes_size;
+  _Atomic(unsigned)* sq_head;
+  _Atomic(unsigned)* sq_tail;
+  unsigned* sq_mask;
+  unsigned* sq_array;
+  _Atomic(unsigned)* cq_head;
+  _Atomic(unsigned)* cq_tail;
+  unsigned* cq_mask;
+  struct io_uring_cqe* cqes;
+};
+
+static pthread_key_t uring_key;
+static pthread_once_t uring_once = PTHREAD_ONCE_INIT;
+static int uring_error;
+
+static void uring_destroy(void* arg) {
+  struct uring* ring = arg;
+  if (ring->sqes != NULL) {
+    munmap(ring->sqes, ring->sqes_size);
+  }
+  if (ring->cq_ring != NULL && ring->cq_ring != ring->sq_ring) {
+    munmap(ring->cq_ring, ring->cq_size);
+  }
+  if (ring->sq_ring != NULL) {
+    munmap(ring->sq_ring, ring->sq_size);
+  }
+  close(ring->fd);
+  free(ring);
+}
+
+static void* uring_map(int fd, size_t size, off_t offset) {
+  void* addr =
+      mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+  return addr == MAP_FAILED ? NULL : addr;
+}
+
+static struct uring* uring_create(void) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  const int fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct uring* ring = calloc(1, sizeof(*ring));
+  if (ring == NULL) {
+    close(fd);
+    errno = ENOMEM;
+    return NULL;
+  }
+  ring->fd = fd;
+
+  ring->sq_size = params.sq_off.array + (params.sq_entries * sizeof(unsigned));
+  ring->cq_size = params.cq_off.cqes +
+                  (params.cq_entries * sizeof(struct io_uring_cqe));
+  if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+    ring->sq_size =
+        ring->sq_size > ring->cq_size ? ring->sq_size : ring->cq_size;
+  }
+  ring->sq_ring = uring_map(fd, ring->sq_size, IORING_OFF_SQ_RING);
+  ring->cq_ring = (params.features & IORING_FEAT_SINGLE_MMAP) != 0
+                      ? ring->sq_ring
+                      : uring_map(fd, ring->cq_size, IORING_OFF_CQ_RING);
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = uring_map(fd, ring->sqes_size, IORING_OFF_SQES);
+  if (ring->sq_ring == NULL || ring->cq_ring == NULL || ring->sqes == NULL) {
+    const int error = errno;
+    uring_destroy(ring);
+    errno = error;
+    return NULL;
+  }
+
+  char* sq = ring->sq_ring;
+  char* cq = ring->cq_ring;
+  ring->sq_head = (_Atomic(unsigned)*)(sq + params.sq_off.head);
+  ring->sq_tail = (_Atomic(unsigned)*)(sq + params.sq_off.tail);
+  ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+  ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+  ring->cq_head = (_Atomic(unsigned)*)(cq + params.cq_off.head);
+  ring->cq_tail = (_Atomic(unsigned)*)(cq + params.cq_off.tail);
+  ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+  return ring;
+}
+
+static void uring_init(void) {
+  if (pthread_key_create(&uring_key, uring_destroy) != 0) {
+    uring_error = EAGAIN;
+    return;
+  }
+  // Probe once, so that selecting the backend fails where it cannot work.
+  struct uring* ring = uring_create();
+  if (ring == NULL) {
+    uring_error = errno;
+    return;
+  }
+  uring_destroy(ring);
+}
+
+static struct uring* uring_get(void) {
+  struct uring* ring = pthread_getspecific(uring_key);
+  if (ring == NULL) {
+    ring = uring_create();
+    if (ring != NULL) {
+      pthread_setspecific(uring_key, ring);
+    }
+  }
+  return ring;
+}
+
+// Submits the request and waits for its completion, returning its result
+// as a system call would. A request the kernel refused is taken back off the
+// ring, so that the next one does not submit it again. One it took uses the
+// caller's buffers until it completes, so it is always waited for.
+static int64_t uring_submit(const struct io_uring_sqe* request) {
+  struct uring* ring = uring_get();
+  if (ring == NULL) {
+    return -1;
+  }
+
+  const unsigned tail =
+      atomic_load_explicit(ring->sq_tail, memory_order_relaxed);
+  const unsigned slot = tail & *ring->sq_mask;
+  ring->sqes[slot] = *request;
+  ring->sq_array[slot] = slot;
+  atomic_store_explicit(ring->sq_tail, tail + 1, memory_order_release);
+
+  unsigned submit = 1;
+  const unsigned head =
+      atomic_load_explicit(ring->cq_head, memory_order_relaxed);
+  while (submit != 0 ||
+         atomic_load_explicit(ring->cq_tail, memory_order_acquire) == head) {
+    const long entered = syscall(
+        __NR_io_uring_enter, ring->fd, submit, 1, IORING_ENTER_GETEVENTS,
+        NULL, 0
+    );
+    if (entered < 0 && errno != EINTR && submit != 0 &&
+        atomic_load_explicit(ring->sq_head, memory_order_acquire) == tail) {
+      atomic_store_explicit(ring->sq_tail, tail, memory_order_relaxed);
+      return -1;
+    }
+    if (entered > 0 ||
+        atomic_load_explicit(ring->sq_head, memory_order_acquire) != tail) {
+      submit = 0;
+    }
+  }
+
+  const int32_t result = ring->cqes[head & *ring->cq_mask].res;
+  atomic_store_explicit(ring->cq_head, head + 1, memory_order_release);
+  if (result < 0) {
+    errno = -result;
+    return -1;
+  }
+  return result;
+}
+
+static ssize_t uring_read(int fd, void* buf, size_t count, off_t offset) {
+  const struct iovec iov = {.iov_base = buf, .iov_len = count};
+  const struct io_uring_sqe request = {
+      .opcode = IORING_OP_READV,
+      .fd = fd,
+      .off = (uint64_t)offset,
+      .addr = (uintptr_t)&iov,
+      .len = 1,
+  };
+  return (ssize_t)uring_submit(&request);
+}
+
+static ssize_t uring_write(
+    int fd, const struct iovec* iov, int count, off_t offset
+) {
+  const struct io_uring_sqe request = {
+      .opcode = IORING_OP_WRITEV,
+      .fd = fd,
+      .off = (uint64_t)offset,
+      .addr = (uintptr_t)iov,
+      .len = (uint32_t)count,
+  };
+  return (ssize_t)uring_submit(&request);
+}
+
+static int uring_sync(int fd) {
+  const struct io_uring_sqe request = {
+      .opcode = IORING_OP_FSYNC,
+      .fd = fd,
+  };
+  return (int)uring_submit(&request);
+}
+
+static int uring_truncate(int fd, off_t size) {
+  return ftruncate(fd, size);
+}
+
+static const struct vtpc_backend uring_backend = {
+    .name = "uring",
+    .open_flags = O_DIRECT,
+    .read = uring_read,
+    .write = uring_write,
+    .sync = uring_sync,
+    .truncate = uring_truncate,
+};
+
+const struct vtpc_backend* vtpc_uring_backend(void) {
+  pthread_once(&uring_once, uring_init);
+  if (uring_error != 0) {
+    errno = uring_error;
+    return NULL;
+  }
+  return &uring_backend;
+}
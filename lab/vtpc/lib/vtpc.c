@@ -1,30 +1,3957 @@
 #include "vtpc.h"
 
+#include <errno.h>
 #include <fcntl.h>
+#include <linux/userfaultfd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "backend.h"
+#include "copy.h"
+#include "frame.h"
+#include "ghost.h"
+#include "manifest.h"
+#include "mrc.h"
+#include "reclaim.h"
+#include "trace.h"
+
+#ifndef VTPC_PAGE_SIZE
+#define VTPC_PAGE_SIZE 4096
+#endif
+
+#ifndef VTPC_CAPACITY
+#define VTPC_CAPACITY 256
+#endif
+
+// Files are cached in blocks of a power of two from VTPC_PAGE_SIZE up to
+// VTPC_BLOCK_MAX bytes, each size in an arena of its own.
+#ifndef VTPC_BLOCK_MAX
+#define VTPC_BLOCK_MAX (2 << 20)
+#endif
+
+#define VTPC_ARENAS 10
+#define VTPC_BUDGET ((size_t)VTPC_CAPACITY * VTPC_PAGE_SIZE)
+
+_Static_assert(
+    VTPC_BLOCK_MAX <= (VTPC_PAGE_SIZE << (VTPC_ARENAS - 1)),
+    "too few arenas for the largest block"
+);
+
+#ifndef VTPC_PREFETCH_BUDGET
+#define VTPC_PREFETCH_BUDGET 32
+#endif
+
+#ifndef VTPC_LOADERS
+#define VTPC_LOADERS 2
+#endif
+
+#ifndef VTPC_STREAMS
+#define VTPC_STREAMS 4
+#endif
+
+#ifndef VTPC_STREAM_WINDOW
+#define VTPC_STREAM_WINDOW (1 << 20)
+#endif
+
+#ifndef VTPC_PREDICT_BYTES
+#define VTPC_PREDICT_BYTES (64 * VTPC_PAGE_SIZE)
+#endif
+
+#ifndef VTPC_SEQUENTIAL_BYTES
+#define VTPC_SEQUENTIAL_BYTES (2 * VTPC_PREDICT_BYTES)
+#endif
+
+#ifndef VTPC_LINKS
+#define VTPC_LINKS 1024
+#endif
+
+#ifndef VTPC_CHASE_DEPTH
+#define VTPC_CHASE_DEPTH 4
+#endif
+
+#ifndef VTPC_CHASE_SCORE
+#define VTPC_CHASE_SCORE 16
+#endif
+
+#ifndef VTPC_HANDLES
+#define VTPC_HANDLES 1024
+#endif
+
+// Handles carry the slot in their low bits and the slot's generation above,
+// so a handle used after close fails even once its slot is reused.
+#define VTPC_HANDLE_BITS 16U
+#define VTPC_HANDLE_GENERATIONS (1U << (31U - VTPC_HANDLE_BITS))
+
+_Static_assert(
+    VTPC_HANDLES <= (1U << VTPC_HANDLE_BITS), "too many handle slots"
+);
+
+// Writes smaller than this are gathered per handle while they follow each
+// other, and reach the frame together.
+#ifndef VTPC_COMBINE_BYTES
+#define VTPC_COMBINE_BYTES 256
+#endif
+
+// Dirty pages are written by one thread from a queue of this many
+// requests, in offset order per file and merged into writes of up to
+// VTPC_WRITEBACK_MERGE blocks. Background requests may fill three quarters
+// of the queue, keeping the rest for fsync.
+#ifndef VTPC_WRITEBACK_DEPTH
+#define VTPC_WRITEBACK_DEPTH 64
+#endif
+
+#ifndef VTPC_WRITEBACK_MERGE
+#define VTPC_WRITEBACK_MERGE 32
+#endif
+
+// A dirty eviction victim is queued for writeback together with up to this
+// many dirty pages after it.
+#ifndef VTPC_WRITEBACK_BATCH
+#define VTPC_WRITEBACK_BATCH 8
+#endif
+
+// A request waiting past its deadline is served before the offset order.
+#ifndef VTPC_SYNC_DEADLINE_NS
+#define VTPC_SYNC_DEADLINE_NS (5 * 1000 * 1000)
+#endif
+
+#ifndef VTPC_ASYNC_DEADLINE_NS
+#define VTPC_ASYNC_DEADLINE_NS (500 * 1000 * 1000)
+#endif
+
+#define VTPC_INDEX_MAX ((off_t)INT64_MAX)
+
+// Reads find the page and check the copy under the cache lock, but copy
+// chunks of at least this many bytes from its frame without it, so that
+// eviction and writers need not wait for the copy:
+// evicted frames are retired and only reused once no such copy may still
+// read them. Each arena has VTPC_RETIRED_SLACK frames more than the budget
+// to stand in meanwhile.
+#ifndef VTPC_OPTIMISTIC_BYTES
+#define VTPC_OPTIMISTIC_BYTES VTPC_PAGE_SIZE
+#endif
+
+#ifndef VTPC_RETIRED_SLACK
+#define VTPC_RETIRED_SLACK 32
+#endif
+
+// Truncations a file remembers before it drops the blocks they cut off.
+#ifndef VTPC_CUTS
+#define VTPC_CUTS 8
+#endif
+
+// CLOCK-Pro and S3-FIFO count hits up to VTPC_FREQ_MAX, so a page survives
+// that many sweeps of the eviction hand after its last hit. S3-FIFO keeps
+// new blocks in a small queue of VTPC_SMALL_PERCENT of the capacity, and
+// both remember as many evicted blocks as the cache holds pages.
+#ifndef VTPC_FREQ_MAX
+#define VTPC_FREQ_MAX 3
+#endif
+
+#ifndef VTPC_SMALL_PERCENT
+#define VTPC_SMALL_PERCENT 10
+#endif
+
+// An eviction pass sweeps the queues at most this many times, the last
+// time evicting regardless of hits, so it ends even when every page has
+// been hit since the last sweep.
+#define VTPC_EVICT_SWEEPS (VTPC_FREQ_MAX + 2)
+
+#ifndef VTPC_MRC_SAMPLES
+#define VTPC_MRC_SAMPLES 4096
+#endif
+
+#ifndef VTPC_MRC_WINDOW
+#define VTPC_MRC_WINDOW (1 << 13)
+#endif
+
+// The curve reaches twice the largest capacity, to show what growing past
+// the build-time arena would buy.
+#define VTPC_MRC_STEP \
+  ((2 * VTPC_CAPACITY + VTPC_MRC_POINTS - 1) / VTPC_MRC_POINTS)
+
+enum vtpc_page_state {
+  VTPC_PAGE_FREE,
+  VTPC_PAGE_LOADING,
+  VTPC_PAGE_UPTODATE,
+};
+
+// How pages are picked for eviction. LRU moves a page to the front on
+// every hit; the others only count the hit, and sweep their queues from
+// the cold end, giving hit pages another round.
+enum vtpc_policy {
+  VTPC_POLICY_LRU,
+  VTPC_POLICY_CLOCK_PRO,
+  VTPC_POLICY_S3_FIFO,
+};
+
+enum vtpc_source {
+  VTPC_SOURCE_DEMAND,
+  VTPC_SOURCE_PREFETCH,
+  VTPC_SOURCE_PREDICT,
+};
+
+// What page_fill found in a block it loaded without error.
+enum vtpc_fill {
+  VTPC_FILL_DATA,
+  VTPC_FILL_ZEROS,
+  VTPC_FILL_HOLE,
+};
+
+struct vtpc_file;
+struct vtpc_map;
+struct vtpc_arena;
+struct vtpc_handle;
+
+struct vtpc_page {
+  struct vtpc_file* file;
+  off_t index;
+  struct vtpc_arena* arena;
+  char* data;
+  enum vtpc_page_state state;
+  enum vtpc_source source;
+  bool dirty;
+  bool writeback;
+  // Clean all-zero pages read the shared zero frame, and hold no memory or
+  // capacity of their own until written.
+  bool zero;
+  unsigned pins;
+  // The epoch of its file the page was last known to be within the file.
+  uint32_t epoch;
+  // Bumped whenever the contents change or the page is removed, so a copy
+  // made without the cache lock can tell it raced either.
+  unsigned long version;
+  // The reclamation epoch the page was retired in, and whether its frame
+  // gives its memory back when recycled.
+  uint64_t retired;
+  bool trim;
+  // Hits since the eviction hand last passed, up to VTPC_FREQ_MAX. Under
+  // CLOCK-Pro a page is hot or cold, and a cold page may be in its test
+  // period; under S3-FIFO it is in the small queue or the main one.
+  uint8_t freq;
+  bool hot;
+  bool test;
+  bool small;
+
+  struct vtpc_page* hash_next;
+  struct vtpc_page* lru_prev;
+  struct vtpc_page* lru_next;
+  struct vtpc_page* file_prev;
+  struct vtpc_page* file_next;
+};
+
+// The frames of one block size. Each arena reserves address space for the
+// whole budget, or one block if that is larger, and only the frames in use
+// are backed by memory. Free frames are handed out by per-thread magazines,
+// which need no cache lock.
+struct vtpc_arena {
+  size_t size;
+  uint32_t count;
+  char* data;
+  struct vtpc_page* pages;
+  struct vtpc_frames* frames;
+};
+
+// A truncation, which cut off the blocks from index on in its epoch.
+struct vtpc_cut {
+  uint32_t epoch;
+  off_t index;
+};
+
+// What a file looked like on disk when the cache last checked it.
+struct vtpc_stamp {
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  struct timespec mtime;
+};
+
+struct vtpc_file {
+  dev_t dev;
+  ino_t ino;
+  uint16_t id;
+  // The descriptor the cache does the file's I/O through, whether it has
+  // O_DIRECT and whether it can read. tail is one without O_DIRECT for
+  // writes ending at the end of file, opened on first use, or -1.
+  int fd;
+  bool direct;
+  bool readable;
+  int tail;
+  bool writable;
+  uint8_t group;
+  off_t size;
+  // The file had no holes before solid when last probed, so blocks below it
+  // are read without probing for holes. Holes only appear past the end of
+  // file of the time, or past a truncation, which lowers it.
+  off_t solid;
+  size_t block;
+  struct vtpc_arena* arena;
+  unsigned refs;
+  unsigned busy;
+  // The first writeback error since the last flush reported one.
+  int error;
+  // Truncations move the file to a new epoch. Those of later epochs than a
+  // page and cutting below it turn it stale; cuts keeps their least indices
+  // in order, which rise with the epoch as lower cuts hide earlier ones.
+  uint32_t epoch;
+  size_t ncuts;
+  struct vtpc_cut cuts[VTPC_CUTS];
+  // The path the file was opened by, and the file there when last checked.
+  // Other processes changing it invalidate its blocks; changes made no
+  // later than the cache's own last writeback, written on the real-time
+  // clock, are taken as its own. checked is on the monotonic clock, and
+  // watch is the inotify watch, or -1.
+  char* path;
+  struct vtpc_stamp stamp;
+  struct timespec written;
+  uint64_t checked;
+  int watch;
+  struct vtpc_page* pages;
+  struct vtpc_map* maps;
+  // The handle holding buffered writes to the file, if any. There is at
+  // most one, so buffers never overlap, and mapped files have none.
+  struct vtpc_handle* combiner;
+  // Blocks of warm_block bytes the hot-set manifest listed for the file,
+  // still to be loaded from warm_next on.
+  uint32_t* warm;
+  size_t warm_count;
+  size_t warm_next;
+  size_t warm_block;
+  struct vtpc_file* next;
+};
+
+// A read-only region whose pages are installed from cache frames on fault.
+struct vtpc_map {
+  struct vtpc_file* file;
+  char* addr;
+  size_t len;
+  off_t offset;
+  struct vtpc_map* next;
+  struct vtpc_map* file_next;
+};
+
+// A strided stream of reads: the next read is expected at last + stride.
+struct vtpc_stream {
+  off_t last;
+  off_t stride;
+  unsigned confidence;
+  unsigned long stamp;
+};
+
+// A page transition seen in the read sequence, used to follow data-dependent
+// chains such as linked records.
+struct vtpc_link {
+  off_t from;
+  off_t to;
+};
+
+// Frames a set of files may hold: bytes no other group evicts below and
+// bytes the group may not exceed, with what its files hold now.
+struct vtpc_group {
+  size_t reserve;
+  size_t limit;
+  size_t resident;
+};
+
+// Which pages an eviction pass takes: those of groups over their limit,
+// those of groups over their reservation, or any.
+enum vtpc_steal {
+  VTPC_STEAL_OVER_LIMIT,
+  VTPC_STEAL_UNRESERVED,
+  VTPC_STEAL_ANY,
+};
+
+// A dirty page queued for the writeback thread, pinned until written.
+struct vtpc_request {
+  struct vtpc_page* page;
+  uint64_t deadline;
+};
+
+// Small sequential writes not yet copied to the frame of their block. The
+// run starts at offset and may grow to limit bytes, within the block.
+struct vtpc_combine {
+  unsigned long seq;
+  off_t offset;
+  size_t len;
+  size_t limit;
+  unsigned writes;
+  char data[VTPC_COMBINE_BYTES];
+};
+
+// Per-open state, kept in the slots of a fixed table so that resolving a
+// handle takes no lock.
+struct vtpc_handle {
+  // The handle open on this slot, or zero while the slot is free.
+  _Atomic int id;
+  unsigned generation;
+  size_t next_free;
+
+  // Guards id changes, pos and the combining buffer, so that a write that
+  // extends the buffered run, and a seek that keeps it, take no cache
+  // lock. Taken after the cache lock, and never held while that is
+  // dropped.
+  pthread_mutex_t lock;
+  struct vtpc_combine combine;
+
+  struct vtpc_file* file;
+  int access;
+  bool append;
+  off_t pos;
+
+  struct vtpc_stream streams[VTPC_STREAMS];
+  unsigned long clock;
+  struct vtpc_link* links;
+  off_t last_page;
+  int chase_score;
+
+  int advice;
+  off_t ahead;
+};
+
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t loaded;
+  pthread_cond_t queued_cond;
+  int error;
+
+  // Set while no file is open, so I/O on a file always sees one backend.
+  const struct vtpc_backend* backend;
+  struct vtpc_arena* arenas[VTPC_ARENAS];
+  const char* zero;
+  struct vtpc_page** buckets;
+  size_t mask;
+
+  // The queue of the eviction policy, coldest last, and the small queue of
+  // S3-FIFO with the bytes it holds. CLOCK-Pro keeps the bytes of its hot
+  // pages below the capacity minus its adaptive target for cold pages.
+  // Both remember evicted blocks in the ghost.
+  enum vtpc_policy policy;
+  struct vtpc_page lru;
+  struct vtpc_page small;
+  size_t small_resident;
+  size_t hot_resident;
+  size_t cold_target;
+  struct vtpc_ghost* ghost;
+
+  // Bytes of frames in use may not exceed the capacity, which the
+  // auto-sizer moves within the budget when the target marginal hit ratio
+  // is set.
+  size_t capacity;
+  size_t resident;
+  struct vtpc_mrc* mrc;
+
+  // Removed pages whose frames readers may still be copying from, oldest
+  // first and linked through hash_next.
+  struct vtpc_reclaim* reclaim;
+  struct vtpc_page* limbo;
+  struct vtpc_page** limbo_tail;
+  size_t retired;
+
+  // Share groups, and whether any has a reservation or a limit, which
+  // eviction then honours.
+  struct vtpc_group groups[VTPC_GROUPS];
+  bool grouped;
+  double marginal;
+
+  // Ids of cached files: bit i is set while a file has id i. They are
+  // handed out round-robin from next_id and recycled once the file is gone.
+  struct vtpc_file* files;
+  uint64_t ids[(UINT16_MAX + 1) / 64];
+  uint16_t next_id;
+  // Free slots are recycled through a list threaded by slot number plus
+  // one; slots past the high-water mark have never been used.
+  struct vtpc_handle handles[VTPC_HANDLES];
+  size_t free_handle;
+  size_t used_handles;
+  unsigned long combine_seq;
+
+  struct vtpc_manifest* manifest;
+  char* manifest_path;
+  size_t warming;
+
+  struct vtpc_page* queue[VTPC_PREFETCH_BUDGET];
+  size_t head;
+  size_t queued;
+  size_t inflight;
+
+  // Writeback requests in no order, and the file and block the elevator
+  // last wrote up to. Failed writes are counted so waiters notice them.
+  pthread_cond_t requests_cond;
+  struct vtpc_request requests[VTPC_WRITEBACK_DEPTH];
+  size_t nrequests;
+  uint16_t elevator_file;
+  off_t elevator_index;
+  uint64_t writeback_failed;
+  int writeback_error;
+
+  int uffd;
+  struct vtpc_map* maps;
+
+  // Nanoseconds between checks of a file against the disk, or zero to
+  // check it on open only, and the inotify instance watching files, if any,
+  // with the thread reading it and the eventfd that stops that thread.
+  uint64_t revalidate;
+  int inotify;
+  int watch_stop;
+  pthread_t watcher;
+  bool watching;
+
+  struct vtpc_stats stats;
+} cache = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .loaded = PTHREAD_COND_INITIALIZER,
+    .queued_cond = PTHREAD_COND_INITIALIZER,
+    .requests_cond = PTHREAD_COND_INITIALIZER,
+    .capacity = VTPC_BUDGET,
+    .uffd = -1,
+    .inotify = -1,
+    .watch_stop = -1,
+};
+
+static pthread_once_t cache_once = PTHREAD_ONCE_INIT;
+
+static int policy_find(const char* name);
+static void* loader_main(void* arg);
+static void* writeback_main(void* arg);
+static void warm_feed(void);
+static void trace_exit(void);
+static void manifest_exit(void);
+
+// Returns the arena of blocks of size bytes, creating it on first use.
+static struct vtpc_arena* arena_get(size_t size) {
+  size_t order = 0;
+  while (((size_t)VTPC_PAGE_SIZE << order) < size) {
+    order += 1;
+  }
+  if (cache.arenas[order] != NULL) {
+    return cache.arenas[order];
+  }
+
+  struct vtpc_arena* arena = calloc(1, sizeof(*arena));
+  if (arena == NULL) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  arena->size = size;
+  arena->count =
+      (VTPC_BUDGET < size ? 1 : VTPC_BUDGET / size) + VTPC_RETIRED_SLACK;
+  arena->pages = calloc(arena->count, sizeof(*arena->pages));
+  arena->frames = vtpc_frames_create(arena->count);
+  arena->data = mmap(
+      NULL,
+      arena->count * size,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+      -1,
+      0
+  );
+  if (arena->pages == NULL || arena->frames == NULL ||
+      arena->data == MAP_FAILED) {
+    if (arena->data != MAP_FAILED) {
+      munmap(arena->data, arena->count * size);
+    }
+    if (arena->frames != NULL) {
+      vtpc_frames_destroy(arena->frames);
+    }
+    free(arena->pages);
+    free(arena);
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  for (size_t i = 0; i < arena->count; ++i) {
+    arena->pages[i].arena = arena;
+    arena->pages[i].data = arena->data + (i * size);
+  }
+  cache.arenas[order] = arena;
+  return arena;
+}
+
+static void cache_init(void) {
+  size_t buckets = 1;
+  while (buckets < 2 * VTPC_CAPACITY) {
+    buckets <<= 1U;
+  }
+
+  cache.buckets = calloc(buckets, sizeof(*cache.buckets));
+  vtpc_copy_init();
+  // NOLINTNEXTLINE(concurrency-mt-unsafe)
+  const char* backend = getenv("VTPC_BACKEND");
+  cache.backend = vtpc_backend_find(backend != NULL ? backend : "direct");
+  if (cache.backend == NULL) {
+    cache.error = errno;
+    return;
+  }
+  cache.mrc = vtpc_mrc_create(
+      VTPC_MRC_SAMPLES, VTPC_MRC_POINTS, VTPC_MRC_STEP, VTPC_MRC_WINDOW
+  );
+  void* zero = mmap(
+      NULL, VTPC_BLOCK_MAX, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+  );
+  cache.zero = zero == MAP_FAILED ? NULL : zero;
+  cache.reclaim = vtpc_reclaim_create();
+  cache.ghost = vtpc_ghost_create(VTPC_CAPACITY);
+  if (cache.buckets == NULL || cache.mrc == NULL || cache.zero == NULL ||
+      cache.reclaim == NULL || cache.ghost == NULL ||
+      arena_get(VTPC_PAGE_SIZE) == NULL) {
+    cache.error = ENOMEM;
+    return;
+  }
+  cache.mask = buckets - 1;
+
+  cache.lru.lru_prev = &cache.lru;
+  cache.lru.lru_next = &cache.lru;
+  cache.small.lru_prev = &cache.small;
+  cache.small.lru_next = &cache.small;
+  cache.cold_target = cache.capacity / 4;
+  cache.limbo_tail = &cache.limbo;
+
+  // NOLINTNEXTLINE(concurrency-mt-unsafe)
+  const char* policy = getenv("VTPC_POLICY");
+  if (policy != NULL && policy_find(policy) >= 0) {
+    cache.policy = policy_find(policy);
+  }
+
+  for (size_t i = 0; i < VTPC_GROUPS; ++i) {
+    cache.groups[i].limit = SIZE_MAX;
+  }
+
+  for (size_t i = 0; i < VTPC_HANDLES; ++i) {
+    pthread_mutex_init(&cache.handles[i].lock, NULL);
+  }
+
+  for (size_t i = 0; i < VTPC_LOADERS; ++i) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, loader_main, NULL) != 0) {
+      cache.error = EAGAIN;
+      return;
+    }
+    pthread_detach(thread);
+  }
+  pthread_t writeback;
+  if (pthread_create(&writeback, NULL, writeback_main, NULL) != 0) {
+    cache.error = EAGAIN;
+    return;
+  }
+  pthread_detach(writeback);
+
+  // NOLINTNEXTLINE(concurrency-mt-unsafe)
+  const char* trace_path = getenv("VTPC_TRACE");
+  if (trace_path != NULL &&
+      vtpc_trace_open(trace_path, VTPC_PAGE_SIZE) == 0) {
+    atexit(trace_exit);
+  }
+
+  // NOLINTNEXTLINE(concurrency-mt-unsafe)
+  const char* manifest_path = getenv("VTPC_MANIFEST");
+  if (manifest_path != NULL) {
+    cache.manifest = vtpc_manifest_create();
+    cache.manifest_path = strdup(manifest_path);
+    if (cache.manifest != NULL && cache.manifest_path != NULL &&
+        vtpc_manifest_read(cache.manifest, manifest_path) == 0) {
+      atexit(manifest_exit);
+    }
+  }
+}
+
+static int cache_ready(void) {
+  pthread_once(&cache_once, cache_init);
+  if (cache.error != 0) {
+    errno = cache.error;
+    return -1;
+  }
+  return 0;
+}
+
+static size_t page_hash(const struct vtpc_file* file, off_t index) {
+  uint64_t key = (uintptr_t)file ^ ((uint64_t)index * 0x9E3779B97F4A7C15ULL);
+  key ^= key >> 29U;
+  return (size_t)key & cache.mask;
+}
+
+// Tells whether the page is still within its file. A page a later
+// truncation cut off is stale: it is clean, as nothing of it may reach the
+// file, and is dropped when next looked up. Other pages move to the
+// current epoch.
+static bool page_current(struct vtpc_page* page) {
+  const struct vtpc_file* file = page->file;
+  if (page->epoch == file->epoch) {
+    return true;
+  }
+  for (size_t i = 0; i < file->ncuts; ++i) {
+    if (file->cuts[i].epoch > page->epoch) {
+      if (page->index >= file->cuts[i].index) {
+        page->dirty = false;
+        return false;
+      }
+      break;
+    }
+  }
+  page->epoch = file->epoch;
+  return true;
+}
+
+static void page_remove(struct vtpc_page* page);
+
+static struct vtpc_page* page_lookup(
+    const struct vtpc_file* file, off_t index
+) {
+  struct vtpc_page* page = cache.buckets[page_hash(file, index)];
+  while (page != NULL && (page->file != file || page->index != index)) {
+    page = page->hash_next;
+  }
+  if (page != NULL && !page_current(page)) {
+    page_remove(page);
+    return NULL;
+  }
+  return page;
+}
+
+static int policy_find(const char* name) {
+  if (strcmp(name, "lru") == 0) {
+    return VTPC_POLICY_LRU;
+  }
+  if (strcmp(name, "clock-pro") == 0) {
+    return VTPC_POLICY_CLOCK_PRO;
+  }
+  if (strcmp(name, "s3-fifo") == 0) {
+    return VTPC_POLICY_S3_FIFO;
+  }
+  errno = EINVAL;
+  return -1;
+}
+
+static uint64_t page_key(const struct vtpc_file* file, off_t index) {
+  return ((uint64_t)file->id << 48U) ^ (uint64_t)index;
+}
+
+static struct vtpc_page* page_queue(const struct vtpc_page* page) {
+  return page->small ? &cache.small : &cache.lru;
+}
+
+static void lru_unlink(struct vtpc_page* page) {
+  page->lru_prev->lru_next = page->lru_next;
+  page->lru_next->lru_prev = page->lru_prev;
+}
+
+// Puts the page at the hot end of its queue.
+static void lru_push(struct vtpc_page* page) {
+  struct vtpc_page* queue = page_queue(page);
+  page->lru_prev = queue;
+  page->lru_next = queue->lru_next;
+  queue->lru_next->lru_prev = page;
+  queue->lru_next = page;
+}
+
+static void lru_touch(struct vtpc_page* page) {
+  lru_unlink(page);
+  lru_push(page);
+}
+
+static void page_cool(struct vtpc_page* page) {
+  if (page->hot) {
+    page->hot = false;
+    cache.hot_resident -= page->arena->size;
+  }
+}
+
+// Moves the page to the cold end of its queue and forgets its hits, making
+// it the next eviction candidate.
+static void lru_demote(struct vtpc_page* page) {
+  struct vtpc_page* queue = page_queue(page);
+  page->freq = 0;
+  page->test = false;
+  page_cool(page);
+  lru_unlink(page);
+  page->lru_next = queue;
+  page->lru_prev = queue->lru_prev;
+  queue->lru_prev->lru_next = page;
+  queue->lru_prev = page;
+}
+
+// Counts a hit on the page. Only LRU touches the queue. The caller holds
+// the cache lock, as for the lookup that found the page, so the counter
+// needs no atomics; a lock-free hit path would need both to change.
+static void policy_hit(struct vtpc_page* page) {
+  if (cache.policy == VTPC_POLICY_LRU) {
+    lru_touch(page);
+  } else if (page->freq < VTPC_FREQ_MAX) {
+    page->freq += 1;
+  }
+}
+
+// Queues a page just inserted. A block the ghost remembers was evicted too
+// early: S3-FIFO admits it to the main queue straight away, and CLOCK-Pro
+// makes it hot and grows its cold target, as the block's reuse distance
+// was within what the cold pages could have held. Other blocks start in
+// the small queue, or cold in their test period.
+static void policy_insert(struct vtpc_page* page, uint64_t key) {
+  page->freq = 0;
+  page->hot = false;
+  page->test = false;
+  page->small = false;
+
+  const size_t size = page->arena->size;
+  const bool ghost = cache.policy != VTPC_POLICY_LRU &&
+                     vtpc_ghost_take(cache.ghost, key);
+  cache.stats.ghost_hits += ghost;
+  if (cache.policy == VTPC_POLICY_S3_FIFO && !ghost) {
+    page->small = true;
+    cache.small_resident += size;
+  } else if (cache.policy == VTPC_POLICY_CLOCK_PRO && ghost) {
+    page->hot = true;
+    cache.hot_resident += size;
+    if (cache.cold_target + size < cache.capacity) {
+      cache.cold_target += size;
+    }
+  } else if (cache.policy == VTPC_POLICY_CLOCK_PRO) {
+    page->test = true;
+  }
+  lru_push(page);
+}
+
+// Takes the page off its queue.
+static void policy_remove(struct vtpc_page* page) {
+  lru_unlink(page);
+  page_cool(page);
+  if (page->small) {
+    page->small = false;
+    cache.small_resident -= page->arena->size;
+  }
+}
+
+// Remembers the evicted page in the ghost if the policy wants to know of a
+// quick return: S3-FIFO for pages leaving the small queue, and CLOCK-Pro
+// for cold pages in their test period. A test period that runs out of the
+// ghost unused shrinks CLOCK-Pro's cold target again.
+static void policy_evict(const struct vtpc_page* page) {
+  const uint64_t key = page_key(page->file, page->index);
+  if (cache.policy == VTPC_POLICY_S3_FIFO && page->small) {
+    vtpc_ghost_add(cache.ghost, key);
+  } else if (cache.policy == VTPC_POLICY_CLOCK_PRO && page->test &&
+             vtpc_ghost_add(cache.ghost, key)) {
+    const size_t size = page->arena->size;
+    if (cache.cold_target > size) {
+      cache.cold_target -= size;
+    }
+  }
+}
+
+// Gives the candidate the hand reached another round if the policy wants
+// to keep it, moving it to the hot end of a queue, and tells whether it
+// did. S3-FIFO moves hit pages of the small queue to the main queue and
+// gives hit pages of the main queue a round per hit. CLOCK-Pro clears the
+// hits of hot pages and turns them cold once without, while there are too
+// many; a cold page hit in its test period turns hot, and one hit outside
+// it starts a new one. A forced sweep keeps nothing.
+static bool policy_spare(struct vtpc_page* page, bool force) {
+  const size_t size = page->arena->size;
+  switch (force ? VTPC_POLICY_LRU : cache.policy) {
+    case VTPC_POLICY_S3_FIFO:
+      if (page->freq == 0) {
+        return false;
+      }
+      if (page->small) {
+        policy_remove(page);
+        page->freq = 0;
+      } else {
+        lru_unlink(page);
+        page->freq -= 1;
+      }
+      lru_push(page);
+      return true;
+    case VTPC_POLICY_CLOCK_PRO:
+      if (page->hot) {
+        if (page->freq == 0 &&
+            cache.hot_resident + cache.cold_target > cache.capacity) {
+          page_cool(page);
+        }
+        page->freq = 0;
+      } else if (page->freq == 0) {
+        return false;
+      } else if (page->test) {
+        page->hot = true;
+        page->test = false;
+        page->freq = 0;
+        cache.hot_resident += size;
+      } else {
+        page->test = true;
+        page->freq = 0;
+      }
+      lru_touch(page);
+      return true;
+    case VTPC_POLICY_LRU:
+    default:
+      return false;
+  }
+}
+
+static struct vtpc_group* page_group(const struct vtpc_page* page) {
+  return &cache.groups[page->file->group];
+}
+
+static void page_insert(
+    struct vtpc_page* page, struct vtpc_file* file, off_t index
+) {
+  page->file = file;
+  page->index = index;
+  page->state = VTPC_PAGE_LOADING;
+  page->source = VTPC_SOURCE_DEMAND;
+  page->dirty = false;
+  page->writeback = false;
+  page->pins = 0;
+  page->epoch = file->epoch;
+
+  struct vtpc_page** bucket = &cache.buckets[page_hash(file, index)];
+  page->hash_next = *bucket;
+  *bucket = page;
+
+  policy_insert(page, page_key(file, index));
+  page_group(page)->resident += page->arena->size;
+
+  page->file_prev = NULL;
+  page->file_next = file->pages;
+  if (file->pages != NULL) {
+    file->pages->file_prev = page;
+  }
+  file->pages = page;
+}
+
+// Unmaps the page from every region mapping it, so the next access faults
+// and sees the current frame.
+static void page_zap(const struct vtpc_page* page) {
+  const off_t first = page->index * (off_t)page->arena->size;
+  const off_t last = first + (off_t)page->arena->size;
+  for (const struct vtpc_map* map = page->file->maps; map != NULL;
+       map = map->file_next) {
+    const off_t begin = first > map->offset ? first : map->offset;
+    const off_t end = last < map->offset + (off_t)map->len
+                          ? last
+                          : map->offset + (off_t)map->len;
+    if (begin < end) {
+      madvise(
+          map->addr + (begin - map->offset), end - begin, MADV_DONTNEED
+      );
+    }
+  }
+}
+
+static char* page_frame(const struct vtpc_page* page) {
+  const struct vtpc_arena* arena = page->arena;
+  return arena->data + ((size_t)(page - arena->pages) * arena->size);
+}
+
+// Lets the page read the shared zero frame and gives the memory of its own
+// frame back.
+static void page_zero(struct vtpc_page* page) {
+  madvise(page->data, page->arena->size, MADV_DONTNEED);
+  page->data = (char*)cache.zero;
+  page->zero = true;
+  cache.resident -= page->arena->size;
+  page_group(page)->resident -= page->arena->size;
+}
+
+// Gives a zero page its own frame again before it is written. The frame
+// reads as zeros after MADV_DONTNEED, so it needs no clearing. The caller
+// shrinks the cache back to its capacity once done writing.
+static void page_own(struct vtpc_page* page) {
+  if (page->zero) {
+    page->zero = false;
+    page->data = page_frame(page);
+    cache.resident += page->arena->size;
+    page_group(page)->resident += page->arena->size;
+  }
+}
+
+// Stops counting the frame of the page as resident.
+static void page_release(struct vtpc_page* page) {
+  if (page->zero) {
+    page->zero = false;
+    page->data = page_frame(page);
+  } else {
+    cache.resident -= page->arena->size;
+  }
+}
+
+static void frame_free(struct vtpc_page* page) {
+  vtpc_frames_free(page->arena->frames, page - page->arena->pages);
+}
+
+static void page_free(struct vtpc_page* page) {
+  page_release(page);
+  frame_free(page);
+}
+
+// Queues the frame of the removed page for reuse once no reader that found
+// the page may still be copying from it.
+static void page_retire(struct vtpc_page* page) {
+  page_release(page);
+  page->version += 1;
+  page->retired = vtpc_reclaim_retire(cache.reclaim);
+  page->hash_next = NULL;
+  *cache.limbo_tail = page;
+  cache.limbo_tail = &page->hash_next;
+  cache.retired += 1;
+}
+
+// Frees the frames of retired pages that no reader can still see, and
+// returns how many.
+static size_t cache_reclaim(void) {
+  const uint64_t safe = vtpc_reclaim_safe(cache.reclaim);
+  size_t freed = 0;
+  while (cache.limbo != NULL && cache.limbo->retired < safe) {
+    struct vtpc_page* page = cache.limbo;
+    cache.limbo = page->hash_next;
+    if (page->trim) {
+      madvise(page->data, page->arena->size, MADV_DONTNEED);
+      page->trim = false;
+    }
+    frame_free(page);
+    freed += 1;
+  }
+  if (cache.limbo == NULL) {
+    cache.limbo_tail = &cache.limbo;
+  }
+  cache.retired -= freed;
+  return freed;
+}
+
+static void page_remove(struct vtpc_page* page) {
+  if (page->file->maps != NULL) {
+    page_zap(page);
+  }
+  if (page->source == VTPC_SOURCE_PREFETCH) {
+    cache.stats.prefetch_unused += 1;
+  } else if (page->source == VTPC_SOURCE_PREDICT) {
+    cache.stats.predict_unused += 1;
+  }
+
+  struct vtpc_page** link = &cache.buckets[page_hash(page->file, page->index)];
+  while (*link != page) {
+    link = &(*link)->hash_next;
+  }
+  *link = page->hash_next;
+
+  policy_remove(page);
+  if (!page->zero) {
+    page_group(page)->resident -= page->arena->size;
+  }
+
+  if (page->file_prev != NULL) {
+    page->file_prev->file_next = page->file_next;
+  } else {
+    page->file->pages = page->file_next;
+  }
+  if (page->file_next != NULL) {
+    page->file_next->file_prev = page->file_prev;
+  }
+
+  page->file = NULL;
+  page->state = VTPC_PAGE_FREE;
+  page_retire(page);
+}
+
+static void page_pin(struct vtpc_page* page) {
+  page->pins += 1;
+  page->file->busy += 1;
+}
+
+static void page_unpin(struct vtpc_page* page) {
+  page->pins -= 1;
+  page->file->busy -= 1;
+  pthread_cond_broadcast(&cache.loaded);
+}
+
+// Waits until the page is out of writeback, which reads its frame without
+// the cache lock, before the caller changes the frame. The pin keeps the
+// page resident meanwhile.
+static void page_stable(struct vtpc_page* page) {
+  if (!page->writeback) {
+    return;
+  }
+  page_pin(page);
+  while (page->writeback) {
+    pthread_cond_wait(&cache.loaded, &cache.lock);
+  }
+  page_unpin(page);
+}
+
+// Reads the page from the file descriptor into its frame, zero-filling the
+// part past the end of file, and returns what it found as a vtpc_fill. A
+// block within a hole is not read at all. Must be called without the cache
+// lock held.
+// Tells whether the frame holds only zeros, a word at a time, stopping at the
+// first word that is not, which for most data is the first.
+static bool block_zero(const char* data, size_t size) {
+  const uint64_t* words = (const uint64_t*)data;
+  for (size_t i = 0; i < size / sizeof(*words); ++i) {
+    if (words[i] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Tells whether loading the block of the page should first ask the file
+// system if it is a hole.
+static bool page_probes(const struct vtpc_page* page) {
+  const off_t size = (off_t)page->arena->size;
+  return (page->index + 1) * size > page->file->solid;
+}
+
+// Finds where the file's first hole starts. File systems without SEEK_HOLE
+// fail with EINVAL, and their files are never probed.
+static void file_find_hole(struct vtpc_file* file) {
+  const off_t hole = lseek(file->fd, 0, SEEK_HOLE);
+  file->solid = hole >= 0 ? hole : errno == EINVAL ? INT64_MAX : 0;
+}
+
+static int page_fill(struct vtpc_page* page, int fd, bool probe) {
+  const size_t size = page->arena->size;
+  const off_t offset = page->index * (off_t)size;
+  // The descriptor is only used for positional I/O, so moving its offset
+  // does no harm.
+  const off_t data = probe ? lseek(fd, offset, SEEK_DATA) : offset;
+  if ((data < 0 && errno == ENXIO) || data >= offset + (off_t)size) {
+    return VTPC_FILL_HOLE;
+  }
+
+  size_t done = 0;
+  while (done < size) {
+    const ssize_t local = cache.backend->read(
+        fd, page->data + done, size - done, offset + (off_t)done
+    );
+    if (local < 0) {
+      return -1;
+    }
+    if (local == 0) {
+      break;
+    }
+    done += local;
+  }
+  memset(page->data + done, 0, size - done);
+  return block_zero(page->data, size) ? VTPC_FILL_ZEROS : VTPC_FILL_DATA;
+}
+
+// Finishes a load started by page_get or the loaders: publishes the page on
+// success or drops it on failure, so waiters retry the load themselves.
+// Pages found all zeros share the zero frame.
+static void page_complete(struct vtpc_page* page, int status) {
+  page_unpin(page);
+  if (status < 0) {
+    page_remove(page);
+    return;
+  }
+  if (status != VTPC_FILL_DATA) {
+    page_zero(page);
+    cache.stats.zero_pages += 1;
+    cache.stats.zero_holes += status == VTPC_FILL_HOLE;
+  }
+  page->state = VTPC_PAGE_UPTODATE;
+}
+
+static uint64_t clock_now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((uint64_t)now.tv_sec * 1000000000ULL) + (uint64_t)now.tv_nsec;
+}
+
+static void file_stamp(struct vtpc_file* file, const struct stat* st) {
+  file->stamp = (struct vtpc_stamp){
+      .dev = st->st_dev,
+      .ino = st->st_ino,
+      .size = st->st_size,
+      .mtime = st->st_mtim,
+  };
+}
+
+static bool stamp_matches(
+    const struct vtpc_stamp* stamp, const struct stat* st
+) {
+  return stamp->dev == st->st_dev && stamp->ino == st->st_ino &&
+         stamp->size == st->st_size &&
+         stamp->mtime.tv_sec == st->st_mtim.tv_sec &&
+         stamp->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+// Tells whether the cache's own writebacks explain how the file differs
+// from its stamp: it is the same file, no larger than cached, and its inode
+// last changed no later than the last writeback finished. Writebacks only
+// note that time, which needs no system call, instead of taking a new
+// stamp. The change time is the kernel's clock at the change, which unlike
+// the modification time no other writer can set back.
+static bool stamp_written(const struct vtpc_file* file, const struct stat* st) {
+  const struct timespec* written = &file->written;
+  return file->stamp.dev == st->st_dev && file->stamp.ino == st->st_ino &&
+         st->st_size <= file->size &&
+         (st->st_ctim.tv_sec < written->tv_sec ||
+          (st->st_ctim.tv_sec == written->tv_sec &&
+           st->st_ctim.tv_nsec <= written->tv_nsec));
+}
+
+// Returns the descriptor to write the file's last block through when the
+// write ends at the end of file rather than at a block boundary, which
+// O_DIRECT refuses: the file's own, or else one of the same file opened
+// without O_DIRECT. Its writes go through the kernel page cache, which
+// direct reads of the range flush first.
+static int file_tail(struct vtpc_file* file) {
+  if (!file->direct) {
+    return file->fd;
+  }
+  if (file->tail < 0) {
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", file->fd);
+    file->tail = open(path, O_WRONLY | O_CLOEXEC);
+  }
+  return file->tail;
+}
+
+// Makes fd the file's descriptor, closing those it had.
+static void file_set_fd(struct vtpc_file* file, int fd) {
+  if (file->fd >= 0) {
+    close(file->fd);
+  }
+  if (file->tail >= 0) {
+    close(file->tail);
+  }
+  const int flags = fcntl(fd, F_GETFL);
+  file->fd = fd;
+  file->tail = -1;
+  file->direct = (flags & O_DIRECT) != 0;
+  file->readable = (flags & O_ACCMODE) != O_WRONLY;
+}
+
+// Queues the dirty page for the writeback thread, unless the queue has no
+// room for a request of its kind. The page is clean from here on, so a write
+// to it meanwhile dirties it again.
+static bool writeback_submit(struct vtpc_page* page, bool sync) {
+  const size_t room = sync ? VTPC_WRITEBACK_DEPTH
+                           : VTPC_WRITEBACK_DEPTH - (VTPC_WRITEBACK_DEPTH / 4);
+  if (cache.nrequests >= room) {
+    return false;
+  }
+
+  page->dirty = false;
+  page->writeback = true;
+  page_pin(page);
+  cache.requests[cache.nrequests++] = (struct vtpc_request){
+      .page = page,
+      .deadline = clock_now() +
+                  (sync ? VTPC_SYNC_DEADLINE_NS : VTPC_ASYNC_DEADLINE_NS),
+  };
+  cache.stats.writeback_queued += 1;
+  if (cache.nrequests > cache.stats.writeback_depth_max) {
+    cache.stats.writeback_depth_max = cache.nrequests;
+  }
+  pthread_cond_signal(&cache.requests_cond);
+  return true;
+}
+
+// Brings the deadlines of the file's queued requests forward to what a
+// sync request would get.
+static void writeback_hurry(const struct vtpc_file* file) {
+  const uint64_t deadline = clock_now() + VTPC_SYNC_DEADLINE_NS;
+  for (size_t i = 0; i < cache.nrequests; ++i) {
+    struct vtpc_request* request = &cache.requests[i];
+    if (request->page->file == file && request->deadline > deadline) {
+      request->deadline = deadline;
+    }
+  }
+}
+
+static size_t writeback_find(const struct vtpc_file* file, off_t index) {
+  for (size_t i = 0; i < cache.nrequests; ++i) {
+    const struct vtpc_page* page = cache.requests[i].page;
+    if (page->file == file && page->index == index) {
+      return i;
+    }
+  }
+  return SIZE_MAX;
+}
+
+static bool writeback_before(
+    const struct vtpc_page* page, uint16_t file, off_t index
+) {
+  return page->file->id < file ||
+         (page->file->id == file && page->index < index);
+}
+
+// Picks the request to serve next: the one with the earliest deadline if
+// that has passed, else the first at or after the elevator position, going
+// round to the lowest once past the last.
+static size_t writeback_pick(void) {
+  size_t earliest = 0;
+  for (size_t i = 1; i < cache.nrequests; ++i) {
+    if (cache.requests[i].deadline < cache.requests[earliest].deadline) {
+      earliest = i;
+    }
+  }
+  if (cache.requests[earliest].deadline <= clock_now()) {
+    cache.stats.writeback_expired += 1;
+    return earliest;
+  }
+
+  size_t next = SIZE_MAX;
+  size_t lowest = 0;
+  for (size_t i = 0; i < cache.nrequests; ++i) {
+    const struct vtpc_page* page = cache.requests[i].page;
+    if (writeback_before(
+            page, cache.requests[lowest].page->file->id,
+            cache.requests[lowest].page->index
+        )) {
+      lowest = i;
+    }
+    if (!writeback_before(page, cache.elevator_file, cache.elevator_index) &&
+        (next == SIZE_MAX ||
+         writeback_before(
+             page, cache.requests[next].page->file->id,
+             cache.requests[next].page->index
+         ))) {
+      next = i;
+    }
+  }
+  return next != SIZE_MAX ? next : lowest;
+}
+
+// Writes the iovecs at offset, resuming after short writes.
+static int write_vector(int fd, struct iovec* iov, int count, off_t offset) {
+  while (count > 0) {
+    const ssize_t local = cache.backend->write(fd, iov, count, offset);
+    if (local < 0 && errno == EINTR) {
+      continue;
+    }
+    if (local <= 0) {
+      if (local == 0) {
+        errno = EIO;
+      }
+      return -1;
+    }
+    offset += local;
+    size_t left = (size_t)local;
+    while (count > 0 && left >= iov->iov_len) {
+      left -= iov->iov_len;
+      iov += 1;
+      count -= 1;
+    }
+    if (count > 0) {
+      iov->iov_base = (char*)iov->iov_base + left;
+      iov->iov_len -= left;
+    }
+  }
+  return 0;
+}
+
+// Writes count bytes at offset straight to a file that cannot be read, for
+// a block that is not cached and would have to be loaded to merge them in.
+// The cache lock is held throughout, so no write to the block through the
+// cache can land in between.
+static int file_write_around(
+    struct vtpc_file* file, off_t offset, const void* buf, size_t count
+) {
+  const int fd = file_tail(file);
+  struct iovec iov = {.iov_base = (void*)buf, .iov_len = count};
+  if (fd < 0 || write_vector(fd, &iov, 1, offset) != 0) {
+    return -1;
+  }
+  clock_gettime(CLOCK_REALTIME, &file->written);
+  cache.stats.write_arounds += 1;
+  return 0;
+}
+
+// Takes the picked request and the queued ones of the blocks around it off
+// the queue and writes them with one call, without the cache lock. Writers
+// wait in page_stable until it is done, so the frames hold still.
+static void writeback_dispatch(void) {
+  const struct vtpc_page* picked = cache.requests[writeback_pick()].page;
+  struct vtpc_file* file = picked->file;
+  off_t first = picked->index;
+  size_t count = 1;
+  while (count < VTPC_WRITEBACK_MERGE &&
+         writeback_find(file, first - 1) != SIZE_MAX) {
+    first -= 1;
+    count += 1;
+  }
+
+  struct vtpc_page* pages[VTPC_WRITEBACK_MERGE];
+  struct iovec iov[VTPC_WRITEBACK_MERGE];
+  count = 0;
+  while (count < VTPC_WRITEBACK_MERGE) {
+    const size_t i = writeback_find(file, first + (off_t)count);
+    if (i == SIZE_MAX) {
+      break;
+    }
+    struct vtpc_page* page = cache.requests[i].page;
+    cache.requests[i] = cache.requests[--cache.nrequests];
+    pages[count] = page;
+    iov[count] = (struct iovec){
+        .iov_base = page->data,
+        .iov_len = page->arena->size,
+    };
+    count += 1;
+  }
+
+  // Frames are written up to the end of file only, so the write never
+  // leaves the file longer than cached.
+  const off_t block = (off_t)file->block;
+  const off_t offset = first * block;
+  int fd = file->fd;
+  size_t length = count;
+  if (offset + ((off_t)count * block) > file->size) {
+    while (length > 0 && offset + ((off_t)(length - 1) * block) >= file->size) {
+      length -= 1;
+    }
+    if (length > 0) {
+      iov[length - 1].iov_len =
+          (size_t)(file->size - offset - ((off_t)(length - 1) * block));
+      fd = file_tail(file);
+    }
+  }
+  pthread_mutex_unlock(&cache.lock);
+  int status = 0;
+  if (length > 0) {
+    status = fd < 0 ? -1 : write_vector(fd, iov, (int)length, offset);
+  }
+  const int error = errno;
+  pthread_mutex_lock(&cache.lock);
+
+  cache.elevator_file = file->id;
+  cache.elevator_index = first + (off_t)count;
+  cache.stats.writeback_writes += 1;
+  cache.stats.writeback_merged += count - 1;
+  cache.stats.writebacks += count;
+  for (size_t i = 0; i < count; ++i) {
+    pages[i]->writeback = false;
+    pages[i]->dirty = pages[i]->dirty || status != 0;
+    page_unpin(pages[i]);
+  }
+
+  if (status != 0) {
+    file->error = error;
+    cache.writeback_failed += 1;
+    cache.writeback_error = error;
+  } else {
+    clock_gettime(CLOCK_REALTIME, &file->written);
+  }
+}
+
+static void* writeback_main(void* arg) {
+  (void)arg;
+
+  pthread_mutex_lock(&cache.lock);
+  for (;;) {
+    while (cache.nrequests == 0) {
+      pthread_cond_wait(&cache.requests_cond, &cache.lock);
+    }
+    writeback_dispatch();
+  }
+  return NULL;
+}
+
+// Queues the victim and the dirty pages after it towards the hot end of its
+// queue as background writeback.
+static void writeback_cold(struct vtpc_page* victim) {
+  const struct vtpc_page* queue = page_queue(victim);
+  size_t queued = 0;
+  for (struct vtpc_page* page = victim;
+       page != queue && queued < VTPC_WRITEBACK_BATCH;
+       page = page->lru_prev) {
+    if (page->dirty && page->pins == 0 && page->state == VTPC_PAGE_UPTODATE &&
+        page_current(page)) {
+      if (!writeback_submit(page, false)) {
+        break;
+      }
+      queued += 1;
+    }
+  }
+}
+
+// Starts background writeback of the dirty victim and what follows it in
+// the LRU list, and waits for progress. Fails if a write failed meanwhile.
+static int writeback_wait(struct vtpc_page* victim) {
+  const uint64_t failed = cache.writeback_failed;
+  writeback_cold(victim);
+  pthread_cond_wait(&cache.loaded, &cache.lock);
+  if (cache.writeback_failed != failed) {
+    errno = cache.writeback_error;
+    return -1;
+  }
+  return 0;
+}
+
+static bool page_stealable(
+    const struct vtpc_page* page,
+    enum vtpc_steal steal,
+    const struct vtpc_group* only
+) {
+  const struct vtpc_group* group = page_group(page);
+  if (only != NULL) {
+    return group == only;
+  }
+  switch (steal) {
+    case VTPC_STEAL_OVER_LIMIT:
+      return group->resident > group->limit;
+    case VTPC_STEAL_UNRESERVED:
+      return group->resident > group->reserve;
+    case VTPC_STEAL_ANY:
+    default:
+      return true;
+  }
+}
+
+// An eviction pass: what it may take and how many bytes it needs, and what
+// it has found so far.
+struct vtpc_evict {
+  const struct vtpc_arena* arena;
+  enum vtpc_steal steal;
+  const struct vtpc_group* only;
+  size_t needed;
+  bool force;
+  bool spared;
+  size_t evicted;
+  size_t freed;
+  struct vtpc_page* dirty;
+};
+
+// Sweeps the queue once from its cold end, up to the page that was at its
+// hot end at the start, as spared pages go in front of it. The small queue
+// is swept only while it holds more than share bytes.
+static void evict_sweep(
+    struct vtpc_evict* pass, struct vtpc_page* queue, size_t share
+) {
+  const struct vtpc_page* last = queue->lru_next;
+  struct vtpc_page* page = queue->lru_prev;
+  bool done = page == queue;
+  while (!done && pass->freed < pass->needed &&
+         (queue != &cache.small || cache.small_resident > share)) {
+    struct vtpc_page* prev = page->lru_prev;
+    done = page == last;
+    if (page->pins == 0 && page->state == VTPC_PAGE_UPTODATE &&
+        page_stealable(page, pass->steal, pass->only)) {
+      if (policy_spare(page, pass->force)) {
+        pass->spared = true;
+      } else if (!page->dirty || !page_current(page)) {
+        page->trim = page->arena != pass->arena && !page->zero;
+        cache.stats.group_evictions[page->file->group] += 1;
+        policy_evict(page);
+        pass->freed += page->arena->size;
+        page_remove(page);
+        pass->evicted += 1;
+      } else if (pass->dirty == NULL) {
+        pass->dirty = page;
+      }
+    }
+    page = prev;
+  }
+}
+
+// Evicts clean pages that are not pinned and that the pass may steal, in the
+// order of the policy, until they make up the bytes needed. Evicting more
+// would only shrink what the cache holds below its capacity. S3-FIFO takes
+// from its small queue while that is over its share and then from the
+// main queue. Sweeps that only gave pages another round are repeated.
+// Frames of other arenas than the one space is needed in give their memory
+// back then, keeping what the arenas hold near the capacity. Returns the
+// number evicted and the first dirty candidate seen.
+static size_t evict_pass(
+    struct vtpc_page** dirty,
+    const struct vtpc_arena* arena,
+    size_t needed,
+    enum vtpc_steal steal,
+    const struct vtpc_group* only
+) {
+  struct vtpc_evict pass = {
+      .arena = arena,
+      .steal = steal,
+      .only = only,
+      .needed = needed,
+      .spared = true,
+  };
+  const size_t share = cache.capacity / 100 * VTPC_SMALL_PERCENT;
+  for (unsigned sweep = 0; sweep < VTPC_EVICT_SWEEPS && pass.evicted == 0 &&
+                           (pass.spared || sweep == 0);
+       ++sweep) {
+    pass.force = sweep + 1 == VTPC_EVICT_SWEEPS;
+    pass.spared = false;
+    evict_sweep(&pass, &cache.small, share);
+    evict_sweep(&pass, &cache.lru, 0);
+    if (pass.evicted == 0) {
+      evict_sweep(&pass, &cache.small, 0);
+    }
+  }
+  if (*dirty == NULL) {
+    *dirty = pass.dirty;
+  }
+  cache.stats.evictions += pass.evicted;
+  return pass.evicted;
+}
+
+// Evicts pages of the given group only, or else steals from groups over
+// their limit first and then from groups over their reservation, taking
+// reserved pages only when nothing else is left.
+static size_t evict_pages(
+    struct vtpc_page** dirty,
+    const struct vtpc_arena* arena,
+    size_t needed,
+    const struct vtpc_group* only
+) {
+  if (only != NULL) {
+    return evict_pass(dirty, arena, needed, VTPC_STEAL_ANY, only);
+  }
+  if (cache.grouped) {
+    size_t evicted =
+        evict_pass(dirty, arena, needed, VTPC_STEAL_OVER_LIMIT, NULL);
+    if (evicted == 0) {
+      evicted = evict_pass(dirty, arena, needed, VTPC_STEAL_UNRESERVED, NULL);
+    }
+    if (evicted != 0 || *dirty != NULL) {
+      return evicted;
+    }
+  }
+  return evict_pass(dirty, arena, needed, VTPC_STEAL_ANY, NULL);
+}
+
+// Takes a free frame of the arena for a page of the group or evicts pages
+// to get one, the group's own ones if it is at its limit. When the cache has
+// room but this thread's magazines are empty, the frames other threads hold
+// in theirs are reaped before anything is evicted. Dirty victims are written
+// back first, which drops the lock, so only callers that may block pass
+// may_block. A block larger than the whole capacity may still be resident
+// alone.
+static struct vtpc_page* page_alloc(
+    struct vtpc_arena* arena, struct vtpc_group* group, bool may_block
+) {
+  bool reaped = false;
+  for (;;) {
+    if (cache.retired != 0) {
+      cache_reclaim();
+    }
+    const bool capped = group->resident != 0 &&
+                        group->resident + arena->size > group->limit;
+    const bool fits = !capped &&
+                      (cache.resident == 0 ||
+                       cache.resident + arena->size <= cache.capacity);
+    const int64_t frame = fits ? vtpc_frames_alloc(arena->frames) : -1;
+    if (frame >= 0) {
+      cache.resident += arena->size;
+      return &arena->pages[frame];
+    }
+    if (fits && !reaped) {
+      vtpc_frames_reap(arena->frames);
+      reaped = true;
+      continue;
+    }
+
+    // Only the bytes over the capacity or the group's limit are evicted, or
+    // one block when the arena is out of frames.
+    size_t needed = arena->size;
+    if (capped) {
+      needed = group->resident + arena->size - group->limit;
+    } else if (!fits) {
+      needed = cache.resident + arena->size - cache.capacity;
+    }
+    struct vtpc_page* dirty = NULL;
+    if (evict_pages(&dirty, arena, needed, capped ? group : NULL) != 0) {
+      continue;
+    }
+
+    if (!may_block) {
+      return NULL;
+    }
+    if (dirty != NULL) {
+      if (writeback_wait(dirty) != 0) {
+        return NULL;
+      }
+      continue;
+    }
+    pthread_cond_wait(&cache.loaded, &cache.lock);
+    reaped = false;
+  }
+}
+
+// Evicts pages until no more bytes are in use than the capacity allows.
+static int cache_shrink(void) {
+  while (cache.resident > cache.capacity) {
+    const size_t needed = cache.resident - cache.capacity;
+    struct vtpc_page* dirty = NULL;
+    if (evict_pages(&dirty, NULL, needed, NULL) != 0) {
+      continue;
+    }
+    if (dirty != NULL) {
+      if (writeback_wait(dirty) != 0) {
+        return -1;
+      }
+      continue;
+    }
+    pthread_cond_wait(&cache.loaded, &cache.lock);
+  }
+  cache_reclaim();
+  return 0;
+}
+
+// Sets the capacity to the largest point of the miss-ratio curve where one
+// more page still turns at least the target fraction of accesses into hits.
+// Frames over a lowered capacity are evicted as pages are allocated.
+static void cache_autosize(void) {
+  double curve[VTPC_MRC_POINTS];
+  vtpc_mrc_curve(cache.mrc, curve, VTPC_MRC_POINTS);
+
+  size_t points = 1;
+  double previous = 1;
+  for (size_t i = 0; i < VTPC_MRC_POINTS; ++i) {
+    if ((previous - curve[i]) / VTPC_MRC_STEP >= cache.marginal) {
+      points = i + 1;
+    }
+    previous = curve[i];
+  }
+  const size_t capacity = points * VTPC_MRC_STEP * VTPC_PAGE_SIZE;
+  cache.capacity = capacity < VTPC_BUDGET ? capacity : VTPC_BUDGET;
+}
+
+// Returns the up-to-date page at index, loading it if it is not resident.
+// Reads that find the page in flight wait on that load instead of issuing a
+// second one. Without fill, a missing page is zero-filled instead of read.
+// With cold, a missing page is inserted at the cold end of the LRU list.
+static struct vtpc_page* page_get(
+    struct vtpc_file* file, off_t index, bool fill, bool cold
+) {
+  const uint64_t key = page_key(file, index);
+  const uint32_t weight = file->block / VTPC_PAGE_SIZE;
+  if (vtpc_mrc_access(cache.mrc, key, weight) && cache.marginal > 0) {
+    cache_autosize();
+  }
+
+  bool waited = false;
+  for (;;) {
+    struct vtpc_page* page = page_lookup(file, index);
+    if (page != NULL && page->state == VTPC_PAGE_LOADING) {
+      waited = true;
+      pthread_cond_wait(&cache.loaded, &cache.lock);
+      continue;
+    }
+    if (page != NULL) {
+      if (waited) {
+        cache.stats.prefetch_waits += 1;
+      } else {
+        cache.stats.hits += 1;
+      }
+      if (page->source == VTPC_SOURCE_PREFETCH) {
+        cache.stats.prefetch_used += 1;
+      } else if (page->source == VTPC_SOURCE_PREDICT) {
+        cache.stats.predict_used += 1;
+      }
+      page->source = VTPC_SOURCE_DEMAND;
+      policy_hit(page);
+      return page;
+    }
+
+    page = page_alloc(file->arena, &cache.groups[file->group], true);
+    if (page == NULL) {
+      return NULL;
+    }
+    if (page_lookup(file, index) != NULL) {
+      page_free(page);
+      continue;
+    }
+
+    cache.stats.misses += 1;
+    page_insert(page, file, index);
+    if (cold) {
+      lru_demote(page);
+    }
+    page_pin(page);
+
+    int status = VTPC_FILL_DATA;
+    int error = 0;
+    if (fill && index * (off_t)file->block < file->size) {
+      const bool probe = page_probes(page);
+      pthread_mutex_unlock(&cache.lock);
+      status = page_fill(page, file->fd, probe);
+      error = errno;
+      pthread_mutex_lock(&cache.lock);
+    } else {
+      memset(page->data, 0, file->block);
+    }
+
+    page_complete(page, status);
+    if (status < 0) {
+      errno = error;
+      return NULL;
+    }
+    return page;
+  }
+}
+
+static void* loader_main(void* arg) {
+  (void)arg;
+
+  pthread_mutex_lock(&cache.lock);
+  for (;;) {
+    while (cache.queued == 0) {
+      pthread_cond_wait(&cache.queued_cond, &cache.lock);
+    }
+
+    struct vtpc_page* page = cache.queue[cache.head];
+    cache.head = (cache.head + 1) % VTPC_PREFETCH_BUDGET;
+    cache.queued -= 1;
+
+    const bool probe = page_probes(page);
+    pthread_mutex_unlock(&cache.lock);
+    const int status = page_fill(page, page->file->fd, probe);
+    pthread_mutex_lock(&cache.lock);
+
+    page_complete(page, status);
+    cache.inflight -= 1;
+    if (cache.warming != 0) {
+      warm_feed();
+    }
+  }
+  return NULL;
+}
+
+// Queues loads for the pages of [offset, offset + len) that are neither
+// resident nor in flight, without blocking. Stops at the in-flight budget and
+// returns the offset up to which the range is resident or queued.
+static off_t prefetch_range(
+    struct vtpc_file* file, off_t offset, size_t len, enum vtpc_source source
+) {
+  if (offset < 0 || offset >= file->size) {
+    return offset;
+  }
+  off_t end = file->size;
+  if (len < (size_t)(end - offset)) {
+    end = offset + (off_t)len;
+  }
+
+  const off_t block = (off_t)file->block;
+  const off_t last = (end + block - 1) / block;
+  for (off_t index = offset / block; index < last; ++index) {
+    if (page_lookup(file, index) != NULL) {
+      continue;
+    }
+
+    struct vtpc_page* page = NULL;
+    if (cache.inflight < VTPC_PREFETCH_BUDGET) {
+      page = page_alloc(file->arena, &cache.groups[file->group], false);
+    }
+    if (page == NULL) {
+      cache.stats.prefetch_dropped += last - index;
+      end = index * block;
+      break;
+    }
+
+    page_insert(page, file, index);
+    page->source = source;
+    page_pin(page);
+    cache.queue[(cache.head + cache.queued) % VTPC_PREFETCH_BUDGET] = page;
+    cache.queued += 1;
+    cache.inflight += 1;
+    if (source == VTPC_SOURCE_PREDICT) {
+      cache.stats.predict_issued += 1;
+    } else {
+      cache.stats.prefetch_issued += 1;
+    }
+  }
+
+  pthread_cond_broadcast(&cache.queued_cond);
+  return end;
+}
+
+static void warm_stop(struct vtpc_file* file) {
+  if (file->warm != NULL) {
+    free(file->warm);
+    file->warm = NULL;
+    cache.warming -= 1;
+  }
+}
+
+// Queues the next manifest blocks of warming files while loads are below
+// the in-flight budget. Warm-up ends once the cache is full, so it never
+// evicts anything, least of all the hotter blocks it loaded first.
+static void warm_feed(void) {
+  for (struct vtpc_file* file = cache.files; file != NULL && cache.warming != 0;
+       file = file->next) {
+    while (file->warm != NULL && cache.inflight < VTPC_PREFETCH_BUDGET) {
+      if (cache.resident + file->arena->size > cache.capacity) {
+        warm_stop(file);
+        break;
+      }
+      const off_t offset =
+          (off_t)file->warm[file->warm_next] * (off_t)file->warm_block;
+      file->warm_next += 1;
+      if (file->warm_next == file->warm_count) {
+        warm_stop(file);
+      }
+
+      const uint64_t issued = cache.stats.prefetch_issued;
+      prefetch_range(file, offset, file->warm_block, VTPC_SOURCE_PREFETCH);
+      cache.stats.warm_issued += cache.stats.prefetch_issued - issued;
+    }
+  }
+}
+
+// Takes the file's entry from the manifest if the file is unchanged since,
+// and starts loading the blocks it lists in the background.
+static void warm_start(struct vtpc_file* file, const struct stat* st) {
+  struct vtpc_manifest_file entry = {
+      .dev = st->st_dev,
+      .ino = st->st_ino,
+      .size = st->st_size,
+      .mtime = ((int64_t)st->st_mtim.tv_sec * 1000000000) +
+               st->st_mtim.tv_nsec,
+  };
+  uint32_t* blocks = vtpc_manifest_take(cache.manifest, &entry);
+  if (blocks == NULL) {
+    return;
+  }
+  if (entry.count == 0) {
+    free(blocks);
+    return;
+  }
+  file->warm = blocks;
+  file->warm_count = entry.count;
+  file->warm_next = 0;
+  file->warm_block = entry.block;
+  cache.warming += 1;
+  warm_feed();
+}
+
+// Records the blocks the file has cached in the manifest, most recently
+// used first. Best effort: a file that cannot be recorded is left out.
+static void manifest_record(struct vtpc_file* file) {
+  size_t count = 0;
+  for (const struct vtpc_page* page = file->pages; page != NULL;
+       page = page->file_next) {
+    count += 1;
+  }
+  struct stat st;
+  if (count == 0 || fstat(file->fd, &st) != 0) {
+    return;
+  }
+  uint32_t* blocks = malloc(count * sizeof(*blocks));
+  if (blocks == NULL) {
+    return;
+  }
+
+  uint32_t used = 0;
+  struct vtpc_page* queues[] = {&cache.lru, &cache.small};
+  for (size_t i = 0; i < sizeof(queues) / sizeof(*queues); ++i) {
+    for (struct vtpc_page* page = queues[i]->lru_next; page != queues[i];
+         page = page->lru_next) {
+      if (page->file == file && page->state == VTPC_PAGE_UPTODATE &&
+          page->index <= UINT32_MAX && page_current(page)) {
+        blocks[used++] = (uint32_t)page->index;
+      }
+    }
+  }
+  const struct vtpc_manifest_file entry = {
+      .dev = st.st_dev,
+      .ino = st.st_ino,
+      .size = st.st_size,
+      .mtime = ((int64_t)st.st_mtim.tv_sec * 1000000000) + st.st_mtim.tv_nsec,
+      .block = (uint32_t)file->block,
+      .count = used,
+  };
+  vtpc_manifest_put(cache.manifest, &entry, blocks);
+  free(blocks);
+}
+
+// Records the files still open and writes the manifest out.
+static int manifest_save(void) {
+  for (struct vtpc_file* file = cache.files; file != NULL; file = file->next) {
+    manifest_record(file);
+  }
+  return vtpc_manifest_write(cache.manifest, cache.manifest_path);
+}
+
+// Trains the handle's stride streams on a read at offset and returns the
+// stream the read continues, or NULL if it starts or retrains one.
+static struct vtpc_stream* predict_stream(
+    struct vtpc_handle* handle, off_t offset
+) {
+  struct vtpc_stream* nearest = NULL;
+  struct vtpc_stream* oldest = &handle->streams[0];
+  off_t nearest_distance = VTPC_STREAM_WINDOW;
+
+  handle->clock += 1;
+  for (size_t i = 0; i < VTPC_STREAMS; ++i) {
+    struct vtpc_stream* stream = &handle->streams[i];
+    if (stream->stamp < oldest->stamp) {
+      oldest = stream;
+    }
+    if (stream->stamp == 0) {
+      continue;
+    }
+
+    const off_t delta = offset - stream->last;
+    if (stream->stride != 0 && delta == stream->stride) {
+      stream->last = offset;
+      stream->stamp = handle->clock;
+      stream->confidence += 1;
+      return stream;
+    }
+
+    const off_t distance = delta < 0 ? -delta : delta;
+    if (distance <= nearest_distance) {
+      nearest = stream;
+      nearest_distance = distance;
+    }
+  }
+
+  struct vtpc_stream* stream = nearest;
+  if (stream == NULL) {
+    stream = oldest;
+    stream->stride = 0;
+  } else if (nearest_distance == 0) {
+    stream->stamp = handle->clock;
+    return NULL;
+  } else {
+    stream->stride = offset - stream->last;
+  }
+  stream->last = offset;
+  stream->stamp = handle->clock;
+  stream->confidence = 0;
+  return NULL;
+}
+
+static struct vtpc_link* predict_link(struct vtpc_handle* handle, off_t page) {
+  return &handle->links[(uint64_t)page * 0x9E3779B97F4A7C15ULL % VTPC_LINKS];
+}
+
+// Issues prefetches for the reads expected to follow a read of count bytes at
+// offset: further records of a confirmed stride, or else the pages that
+// followed this one the last time it was read. Chasing stays enabled only
+// while revisited links keep predicting the same successor.
+static void predict(struct vtpc_handle* handle, off_t offset, size_t count) {
+  struct vtpc_file* file = handle->file;
+  const off_t block = (off_t)file->block;
+  const off_t page = offset / block;
+
+  if (handle->advice == POSIX_FADV_RANDOM) {
+    return;
+  }
+  if (handle->advice == POSIX_FADV_SEQUENTIAL) {
+    // Only the part of the window past what earlier reads already queued.
+    // The window always spans a block past the current one.
+    const off_t from = offset + (off_t)count;
+    const off_t to = from + (VTPC_SEQUENTIAL_BYTES > 2 * block
+                                 ? VTPC_SEQUENTIAL_BYTES
+                                 : 2 * block);
+    const off_t start = handle->ahead > from && handle->ahead < to
+                            ? handle->ahead
+                            : from;
+    handle->ahead =
+        prefetch_range(file, start, to - start, VTPC_SOURCE_PREDICT);
+    return;
+  }
+
+  if (handle->last_page >= 0 && handle->last_page != page) {
+    struct vtpc_link* link = predict_link(handle, handle->last_page);
+    if (link->from == handle->last_page && link->to == page) {
+      handle->chase_score += handle->chase_score < VTPC_CHASE_SCORE ? 1 : 0;
+    } else if (link->from == handle->last_page) {
+      handle->chase_score -= handle->chase_score > -VTPC_CHASE_SCORE ? 1 : 0;
+    }
+    link->from = handle->last_page;
+    link->to = page;
+  }
+  handle->last_page = page;
+
+  const struct vtpc_stream* stream = predict_stream(handle, offset);
+  if (stream != NULL) {
+    const size_t span = count < (size_t)block ? (size_t)block : count;
+    size_t depth = 2U << (stream->confidence < 4 ? stream->confidence : 4);
+    if (depth * span > VTPC_PREDICT_BYTES) {
+      depth = VTPC_PREDICT_BYTES < span ? 1 : VTPC_PREDICT_BYTES / span;
+    }
+    for (size_t k = 1; k <= depth; ++k) {
+      prefetch_range(
+          file, offset + ((off_t)k * stream->stride), count, VTPC_SOURCE_PREDICT
+      );
+    }
+    return;
+  }
+
+  off_t next = page;
+  for (size_t k = 0; k < VTPC_CHASE_DEPTH && handle->chase_score >= 0; ++k) {
+    const struct vtpc_link* link = predict_link(handle, next);
+    if (link->from != next) {
+      break;
+    }
+    next = link->to;
+    prefetch_range(file, next * block, block, VTPC_SOURCE_PREDICT);
+  }
+}
+
+static struct vtpc_file* file_find(dev_t dev, ino_t ino) {
+  struct vtpc_file* file = cache.files;
+  while (file != NULL && (file->dev != dev || file->ino != ino)) {
+    file = file->next;
+  }
+  return file;
+}
+
+// Copies the handle's buffered writes to the frame of their block. The
+// buffer keeps them while the block loads, and writes appended meanwhile
+// go out with them, so a reader holding the cache lock always finds the
+// data in one place or the other.
+static int combine_commit(struct vtpc_handle* handle) {
+  struct vtpc_combine* combine = &handle->combine;
+  pthread_mutex_lock(&handle->lock);
+  const unsigned long seq = combine->seq;
+  const off_t offset = combine->offset;
+  const size_t len = combine->len;
+  pthread_mutex_unlock(&handle->lock);
+  if (len == 0) {
+    return 0;
+  }
+
+  struct vtpc_file* file = handle->file;
+  const off_t block = (off_t)file->block;
+  const bool cold = handle->advice == POSIX_FADV_NOREUSE;
+  vtpc_trace(file->id, offset / VTPC_PAGE_SIZE, VTPC_TRACE_WRITE);
+  struct vtpc_page* page = page_get(file, offset / block, true, cold);
+  if (page == NULL) {
+    return -1;
+  }
+  page_stable(page);
+
+  // Another thread may have committed the run while the block loaded.
+  pthread_mutex_lock(&handle->lock);
+  if (combine->len != 0 && combine->seq == seq) {
+    page_own(page);
+    memcpy(page->data + (offset % block), combine->data, combine->len);
+    page->dirty = true;
+    page->version += 1;
+    if (offset + (off_t)combine->len > file->size) {
+      file->size = offset + (off_t)combine->len;
+    }
+    cache.stats.combined_writes += combine->writes;
+    cache.stats.combine_commits += 1;
+    combine->len = 0;
+    combine->writes = 0;
+    file->combiner = NULL;
+  }
+  pthread_mutex_unlock(&handle->lock);
+  if (cache.resident > cache.capacity && cache.resident > file->block) {
+    cache_shrink();
+  }
+  return 0;
+}
+
+// Commits the buffered writes to the file, before it is read, written or
+// mapped by other means.
+static int file_combine(struct vtpc_file* file) {
+  if (file->combiner == NULL) {
+    return 0;
+  }
+  return combine_commit(file->combiner);
+}
+
+// Forgets the handle's buffered writes. A commit of them in progress finds
+// the buffer empty and copies nothing.
+static void combine_discard(struct vtpc_handle* handle) {
+  pthread_mutex_lock(&handle->lock);
+  handle->combine.len = 0;
+  handle->combine.writes = 0;
+  pthread_mutex_unlock(&handle->lock);
+  handle->file->combiner = NULL;
+}
+
+// Starts a buffered run with a small write at pos, unless it would not fit
+// before the end of its block or the file may not be buffered.
+static bool combine_start(
+    struct vtpc_handle* handle, off_t pos, const void* buf, size_t count
+) {
+  struct vtpc_file* file = handle->file;
+  const off_t block = (off_t)file->block;
+  size_t limit = (size_t)(block - (pos % block));
+  if (limit > VTPC_COMBINE_BYTES) {
+    limit = VTPC_COMBINE_BYTES;
+  }
+  if (file->maps != NULL || file->combiner != NULL || !file->readable ||
+      count > limit) {
+    return false;
+  }
+
+  struct vtpc_combine* combine = &handle->combine;
+  pthread_mutex_lock(&handle->lock);
+  combine->seq = ++cache.combine_seq;
+  combine->offset = pos;
+  combine->len = count;
+  combine->limit = limit;
+  combine->writes = 1;
+  memcpy(combine->data, buf, count);
+  handle->pos = pos + (off_t)count;
+  pthread_mutex_unlock(&handle->lock);
+  file->combiner = handle;
+  return true;
+}
+
+static void file_wait_idle(struct vtpc_file* file) {
+  while (file->busy != 0) {
+    pthread_cond_wait(&cache.loaded, &cache.lock);
+  }
+}
+
+// Readies the file to be cut at length: no load or write may be in flight,
+// and whichever handle buffers writes to it has them committed, or dropped
+// if they start past the new end, so none of its bytes land there later.
+// Commits and waits drop the cache lock and let another run start, so this
+// repeats until the file is idle with nothing buffered.
+static int file_settle(struct vtpc_file* file, off_t length) {
+  for (;;) {
+    struct vtpc_handle* combiner = file->combiner;
+    if (combiner != NULL && combiner->combine.offset >= length) {
+      combine_discard(combiner);
+    } else if (file_combine(file) != 0) {
+      return -1;
+    }
+    file_wait_idle(file);
+    if (file->combiner == NULL) {
+      return 0;
+    }
+  }
+}
+
+static void file_drop(struct vtpc_file* file) {
+  file_wait_idle(file);
+  while (file->pages != NULL) {
+    page_remove(file->pages);
+  }
+  cache_reclaim();
+}
+
+// Sets the cached size of the idle file to length. Shrinking moves the file
+// to a new epoch, which leaves its blocks past the end stale without
+// visiting them; only the block across the new end is cleared past it now.
+// Mapped files, and files out of room for cuts, drop their stale blocks at
+// once instead, so that no mapping shows them.
+static void file_cut(struct vtpc_file* file, off_t length) {
+  const off_t block = (off_t)file->block;
+  if (length < file->size) {
+    const off_t index = (length + block - 1) / block;
+    if (file->maps != NULL || file->ncuts == VTPC_CUTS) {
+      struct vtpc_page* page = file->pages;
+      while (page != NULL) {
+        struct vtpc_page* next = page->file_next;
+        if (!page_current(page) || page->index >= index) {
+          page_remove(page);
+        }
+        page = next;
+      }
+      file->ncuts = 0;
+    } else {
+      file->epoch += 1;
+      while (file->ncuts != 0 && file->cuts[file->ncuts - 1].index >= index) {
+        file->ncuts -= 1;
+      }
+      file->cuts[file->ncuts++] = (struct vtpc_cut){
+          .epoch = file->epoch,
+          .index = index,
+      };
+    }
+
+    const size_t shift = (size_t)(length % block);
+    struct vtpc_page* page = shift != 0 ? page_lookup(file, index - 1) : NULL;
+    if (page != NULL && !page->zero) {
+      memset(page->data + shift, 0, (size_t)block - shift);
+      page->version += 1;
+      if (file->maps != NULL) {
+        page_zap(page);
+      }
+    }
+  }
+  file->size = length;
+}
+
+// Sets the size of the file on disk and in the cache to length, once no
+// buffered run or write in flight can land past it.
+static int file_truncate(struct vtpc_file* file, off_t length) {
+  if (file_settle(file, length) != 0 ||
+      cache.backend->truncate(file->fd, length) != 0) {
+    return -1;
+  }
+  file_cut(file, length);
+  if (file->solid > length) {
+    file->solid = length;
+  }
+  struct stat st;
+  if (fstat(file->fd, &st) == 0) {
+    file_stamp(file, &st);
+  }
+  return 0;
+}
+
+static bool page_writable(struct vtpc_page* page) {
+  return page->dirty && !page->writeback &&
+         page->state == VTPC_PAGE_UPTODATE && page_current(page);
+}
+
+// Returns the page of the file with the lowest index in [first, last) that
+// is dirty and not queued yet, or NULL.
+static struct vtpc_page* file_next_dirty(
+    const struct vtpc_file* file, off_t first, off_t last
+) {
+  struct vtpc_page* next = NULL;
+  for (struct vtpc_page* page = file->pages; page != NULL;
+       page = page->file_next) {
+    if (page->index >= first && page->index < last && page_writable(page) &&
+        (next == NULL || page->index < next->index)) {
+      next = page;
+    }
+  }
+  return next;
+}
+
+// Queues the dirty pages of [first, last) for writeback ahead of background
+// work, in offset order so that runs fit in the queue whole, and waits until
+// none is dirty or being written. Reports, and clears, the first writeback
+// error of the file since the last report.
+static int file_write(struct vtpc_file* file, off_t first, off_t last) {
+  off_t cursor = first;
+  for (;;) {
+    if (file->error != 0) {
+      errno = file->error;
+      file->error = 0;
+      return -1;
+    }
+
+    bool full = false;
+    struct vtpc_page* next = NULL;
+    while (!full && (next = file_next_dirty(file, cursor, last)) != NULL) {
+      cursor = next->index;
+      struct vtpc_page* page = next;
+      while (page != NULL && page_writable(page)) {
+        if (!writeback_submit(page, true)) {
+          full = true;
+          break;
+        }
+        cursor += 1;
+        page = cursor < last ? page_lookup(file, cursor) : NULL;
+      }
+    }
+    // Pages written to while queued are dirty again, so start over.
+    if (!full) {
+      cursor = first;
+      writeback_hurry(file);
+    }
+
+    bool busy = false;
+    for (struct vtpc_page* page = file->pages; page != NULL && !busy;
+         page = page->file_next) {
+      busy = page->index >= first && page->index < last &&
+             ((page->dirty && page_current(page)) || page->writeback);
+    }
+    if (!busy) {
+      return 0;
+    }
+    pthread_cond_wait(&cache.loaded, &cache.lock);
+  }
+}
+
+static int file_flush(struct vtpc_file* file) {
+  for (;;) {
+    if (file->combiner != NULL) {
+      if (combine_commit(file->combiner) != 0) {
+        return -1;
+      }
+      continue;
+    }
+
+    if (file_write(file, 0, VTPC_INDEX_MAX) != 0) {
+      return -1;
+    }
+    if (file->combiner == NULL) {
+      return 0;
+    }
+  }
+}
+
+// Writes back the dirty pages of [first, last), queued together and waited
+// for once, and drops every page of the range that is clean and idle
+// afterwards.
+static int file_dontneed(struct vtpc_file* file, off_t first, off_t last) {
+  if (file_write(file, first, last) != 0) {
+    return -1;
+  }
+  struct vtpc_page* page = file->pages;
+  while (page != NULL) {
+    struct vtpc_page* next = page->file_next;
+    if (page->index >= first && page->index < last && page->pins == 0 &&
+        page->state == VTPC_PAGE_UPTODATE &&
+        (!page->dirty || !page_current(page))) {
+      page_remove(page);
+    }
+    page = next;
+  }
+  return 0;
+}
+
+// Opens path with the backend's flags, dropping O_DIRECT for file systems
+// that refuse it.
+static int backend_open(const char* path, int flags, int access) {
+  const int extra = cache.backend->open_flags;
+  int fd = open(path, flags | extra, access);
+  if (fd < 0 && errno == EINVAL && (extra & O_DIRECT) != 0) {
+    fd = open(path, flags | (extra & ~O_DIRECT), access);
+  }
+  return fd;
+}
+
+static int watch_add(const char* path) {
+  if (path == NULL) {
+    return -1;
+  }
+  return inotify_add_watch(
+      cache.inotify, path, IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE
+  );
+}
+
+// Leaves every cached block of the file stale, as another process changed
+// it, and takes its size on disk. Blocks this process dirtied are written
+// first, over the other writer's, and nothing is dropped should that fail;
+// writes landing while it waits are written too.
+static void file_invalidate(struct vtpc_file* file) {
+  for (;;) {
+    if (file_flush(file) != 0) {
+      return;
+    }
+    file_wait_idle(file);
+    if (file->combiner == NULL &&
+        file_next_dirty(file, 0, VTPC_INDEX_MAX) == NULL) {
+      break;
+    }
+  }
+
+  struct stat st;
+  if (fstat(file->fd, &st) != 0) {
+    return;
+  }
+  file_cut(file, 0);
+  file->size = st.st_size;
+  file_stamp(file, &st);
+  file_find_hole(file);
+  cache.stats.invalidations += 1;
+}
+
+// Moves the file to the one another process renamed over its path, unless
+// that one is cached already, and returns whether it moved. The blocks
+// cached are still those of the old file.
+static bool file_reopen(struct vtpc_file* file, const struct stat* st) {
+  if (file_find(st->st_dev, st->st_ino) != NULL) {
+    return false;
+  }
+  const int fd =
+      backend_open(file->path, file->writable ? O_RDWR : O_RDONLY, 0);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat opened;
+  if (fstat(fd, &opened) != 0 || file_flush(file) != 0) {
+    close(fd);
+    return false;
+  }
+
+  file_wait_idle(file);
+  file_set_fd(file, fd);
+  file->dev = opened.st_dev;
+  file->ino = opened.st_ino;
+  if (file->watch >= 0) {
+    inotify_rm_watch(cache.inotify, file->watch);
+    file->watch = watch_add(file->path);
+  }
+  return true;
+}
+
+// Compares the file with its stamp, and invalidates its blocks if another
+// process changed it. Writebacks in flight change the file too and note
+// when they finished, so they are waited for first.
+static void file_revalidate(struct vtpc_file* file) {
+  file->checked = clock_now();
+  cache.stats.revalidations += 1;
+  file_wait_idle(file);
+
+  struct stat st;
+  bool changed = file->path != NULL && stat(file->path, &st) == 0 &&
+                 (st.st_dev != file->dev || st.st_ino != file->ino) &&
+                 file_reopen(file, &st);
+  if (!changed && fstat(file->fd, &st) == 0 &&
+      !stamp_matches(&file->stamp, &st)) {
+    changed = !stamp_written(file, &st);
+    if (!changed) {
+      file_stamp(file, &st);
+    }
+  }
+  if (changed) {
+    file_invalidate(file);
+  }
+}
+
+// Revalidates the file if the interval has passed since its last check.
+static void file_check(struct vtpc_file* file) {
+  if (cache.revalidate != 0 &&
+      clock_now() - file->checked >= cache.revalidate) {
+    file_revalidate(file);
+  }
+}
+
+// Gives the file an id no other cached file has, or fails with EMFILE if all
+// are taken. Ids come back round-robin, so a freed one is reused as late as
+// possible, once the ghosts and samples keyed by it have likely aged out.
+static int file_id_take(struct vtpc_file* file) {
+  for (uint32_t i = 0; i <= UINT16_MAX; ++i) {
+    const uint16_t id = cache.next_id++;
+    const uint64_t bit = 1ULL << (id % 64U);
+    if ((cache.ids[id / 64U] & bit) == 0) {
+      cache.ids[id / 64U] |= bit;
+      file->id = id;
+      return 0;
+    }
+  }
+  errno = EMFILE;
+  return -1;
+}
+
+static void file_id_put(const struct vtpc_file* file) {
+  cache.ids[file->id / 64U] &= ~(1ULL << (file->id % 64U));
+}
+
+// Drops a reference held by a handle or a mapping. The last one writes back
+// the file's dirty pages and forgets the file.
+static int file_release(struct vtpc_file* file) {
+  file->refs -= 1;
+  if (file->refs != 0) {
+    return 0;
+  }
+
+  const int status = file_flush(file);
+  const int error = errno;
+  warm_stop(file);
+  if (cache.manifest != NULL) {
+    manifest_record(file);
+  }
+  file_drop(file);
+
+  struct vtpc_file** link = &cache.files;
+  while (*link != file) {
+    link = &(*link)->next;
+  }
+  *link = file->next;
+  if (file->watch >= 0) {
+    inotify_rm_watch(cache.inotify, file->watch);
+  }
+  close(file->fd);
+  if (file->tail >= 0) {
+    close(file->tail);
+  }
+  file_id_put(file);
+  free(file->path);
+  free(file);
+  pthread_cond_broadcast(&cache.loaded);
+
+  errno = error;
+  return status;
+}
+
+// Resolves a handle with one array load. Lookups do not need the cache
+// lock; the slot is only reused by an open under the lock.
+static struct vtpc_handle* handle_get(int fd) {
+  const size_t slot = (unsigned)fd & ((1U << VTPC_HANDLE_BITS) - 1);
+  if (fd <= 0 || slot >= VTPC_HANDLES ||
+      atomic_load_explicit(&cache.handles[slot].id, memory_order_acquire) !=
+          fd) {
+    errno = EBADF;
+    return NULL;
+  }
+  return &cache.handles[slot];
+}
+
+// Resolves the handle before taking the cache lock, so that a descriptor
+// that is not open fails without it, then takes the lock and checks that
+// the handle was not closed in between. Returns NULL without the lock if
+// fd is not open.
+static struct vtpc_handle* handle_acquire(int fd) {
+  struct vtpc_handle* handle = handle_get(fd);
+  if (handle == NULL) {
+    return NULL;
+  }
+  pthread_mutex_lock(&cache.lock);
+  if (atomic_load_explicit(&handle->id, memory_order_relaxed) != fd) {
+    pthread_mutex_unlock(&cache.lock);
+    errno = EBADF;
+    return NULL;
+  }
+  return handle;
+}
+
+// Appends a small write to the handle's buffered run if it continues it,
+// taking only the handle lock. Returns false if the write needs the cache.
+// A run of an O_APPEND handle starts at the cached end of file and stays
+// the tail of the file, as every other write commits it first, so appends
+// continue it wherever the handle was moved.
+static bool combine_append(int fd, const void* buf, size_t count) {
+  struct vtpc_handle* handle = handle_get(fd);
+  if (handle == NULL) {
+    return false;
+  }
+
+  // Faults on a mapped source take the cache lock and then handle locks,
+  // so copy it before taking this one.
+  char data[VTPC_COMBINE_BYTES];
+  memcpy(data, buf, count);
+
+  pthread_mutex_lock(&handle->lock);
+  struct vtpc_combine* combine = &handle->combine;
+  const bool appended =
+      atomic_load_explicit(&handle->id, memory_order_relaxed) == fd &&
+      combine->len != 0 &&
+      (handle->append ||
+       handle->pos == combine->offset + (off_t)combine->len) &&
+      combine->len + count <= combine->limit;
+  if (appended) {
+    memcpy(combine->data + combine->len, data, count);
+    combine->len += count;
+    combine->writes += 1;
+    handle->pos = combine->offset + (off_t)combine->len;
+  }
+  pthread_mutex_unlock(&handle->lock);
+  return appended;
+}
+
+static void handle_free_slot(size_t slot) {
+  cache.handles[slot].next_free = cache.free_handle;
+  cache.free_handle = slot + 1;
+}
+
+// Opens a handle on the file behind fd, which is kept for the file's I/O if
+// the file is new or needs write access and closed otherwise. Returns the
+// handle, or -1 with fd closed. The slot is taken first, as waiting for the
+// file to go idle drops the cache lock and lets other opens in.
+static int handle_attach(
+    const char* path, int fd, int mode, struct stat* st
+) {
+  size_t slot = 0;
+  if (cache.free_handle != 0) {
+    slot = cache.free_handle - 1;
+    cache.free_handle = cache.handles[slot].next_free;
+  } else if (cache.used_handles < VTPC_HANDLES) {
+    slot = cache.used_handles++;
+  } else {
+    close(fd);
+    errno = EMFILE;
+    return -1;
+  }
+
+  struct vtpc_link* links = malloc(VTPC_LINKS * sizeof(*links));
+  if (links == NULL) {
+    handle_free_slot(slot);
+    close(fd);
+    errno = ENOMEM;
+    return -1;
+  }
+
+  // The last close flushes and frees a file without the cache lock, so wait
+  // for one on its way out rather than attach to it. Its flush changes the
+  // file after st was taken.
+  const bool writable = (mode & O_ACCMODE) != O_RDONLY;
+  struct vtpc_file* file = file_find(st->st_dev, st->st_ino);
+  bool waited = false;
+  while (file != NULL && file->refs == 0) {
+    pthread_cond_wait(&cache.loaded, &cache.lock);
+    file = file_find(st->st_dev, st->st_ino);
+    waited = true;
+  }
+  if (waited && fstat(fd, st) != 0) {
+    handle_free_slot(slot);
+    free(links);
+    close(fd);
+    return -1;
+  }
+  if (file == NULL) {
+    file = calloc(1, sizeof(*file));
+    if (file == NULL || file_id_take(file) != 0) {
+      const int error = file == NULL ? ENOMEM : errno;
+      handle_free_slot(slot);
+      free(links);
+      free(file);
+      close(fd);
+      errno = error;
+      return -1;
+    }
+    file->dev = st->st_dev;
+    file->ino = st->st_ino;
+    file->refs = 1;
+    file->fd = -1;
+    file->tail = -1;
+    file_set_fd(file, fd);
+    file->writable = writable;
+    file->size = st->st_size;
+    file_find_hole(file);
+    file->block = VTPC_PAGE_SIZE;
+    file->arena = cache.arenas[0];
+    // Without a path the file is only checked through its descriptor.
+    file->path = realpath(path, NULL);
+    file_stamp(file, st);
+    file->checked = clock_now();
+    file->watch = cache.watching ? watch_add(file->path) : -1;
+    file->next = cache.files;
+    cache.files = file;
+    if (cache.manifest != NULL && file->readable) {
+      warm_start(file, st);
+    }
+  } else {
+    // Waits drop the cache lock, so hold the file against its last close.
+    file->refs += 1;
+    if (writable && !file->writable) {
+      file_wait_idle(file);
+      file_set_fd(file, fd);
+      file->writable = true;
+    } else {
+      close(fd);
+    }
+    file_revalidate(file);
+  }
+
+  struct vtpc_handle* handle = &cache.handles[slot];
+  memset(
+      &handle->file, 0, sizeof(*handle) - offsetof(struct vtpc_handle, file)
+  );
+  handle->file = file;
+  handle->access = mode & O_ACCMODE;
+  handle->append = (mode & O_APPEND) != 0;
+  handle->links = links;
+  for (size_t i = 0; i < VTPC_LINKS; ++i) {
+    handle->links[i].from = -1;
+  }
+  handle->last_page = -1;
+  handle->advice = POSIX_FADV_NORMAL;
+
+  handle->generation = (handle->generation % (VTPC_HANDLE_GENERATIONS - 1)) + 1;
+  const int id = (int)((handle->generation << VTPC_HANDLE_BITS) | slot);
+  atomic_store_explicit(&handle->id, id, memory_order_release);
+  return id;
+}
+
+static struct vtpc_map* map_find(const char* addr) {
+  struct vtpc_map* map = cache.maps;
+  while (map != NULL && (addr < map->addr || addr >= map->addr + map->len)) {
+    map = map->next;
+  }
+  return map;
+}
+
+static bool map_overlaps(const void* buf, size_t count) {
+  const char* begin = buf;
+  for (const struct vtpc_map* map = cache.maps; map != NULL; map = map->next) {
+    if (begin < map->addr + map->len && map->addr < begin + count) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Serves a fault on a mapped region by copying the cache frame of the page
+// into it, one system page at a time whatever the block size. If the page
+// cannot be loaded, the faulting thread is woken to fault again and retry.
+static void map_fault(char* addr) {
+  pthread_mutex_lock(&cache.lock);
+
+  bool served = false;
+  struct vtpc_map* map = map_find(addr);
+  if (map != NULL) {
+    struct vtpc_file* file = map->file;
+    const off_t slot = (addr - map->addr) / VTPC_PAGE_SIZE;
+    const off_t offset = map->offset + (slot * VTPC_PAGE_SIZE);
+    const off_t block = (off_t)file->block;
+    vtpc_trace(file->id, offset / VTPC_PAGE_SIZE, VTPC_TRACE_FAULT);
+    struct vtpc_page* page = page_get(file, offset / block, true, false);
+
+    // The region may have been unmapped while the page was loading.
+    map = map_find(addr);
+    if (page != NULL && map != NULL && map->file == file) {
+      struct uffdio_copy copy = {
+          .dst = (uintptr_t)(map->addr + (slot * VTPC_PAGE_SIZE)),
+          .src = (uintptr_t)(page->data + (offset % block)),
+          .len = VTPC_PAGE_SIZE,
+      };
+      served = ioctl(cache.uffd, UFFDIO_COPY, &copy) == 0 || errno == EEXIST;
+      cache.stats.map_faults += 1;
+    }
+  }
+
+  if (!served) {
+    struct uffdio_range range = {
+        .start = (uintptr_t)addr & ~(uintptr_t)(VTPC_PAGE_SIZE - 1),
+        .len = VTPC_PAGE_SIZE,
+    };
+    ioctl(cache.uffd, UFFDIO_WAKE, &range);
+  }
+  pthread_mutex_unlock(&cache.lock);
+}
+
+static void* fault_main(void* arg) {
+  (void)arg;
+
+  for (;;) {
+    struct uffd_msg msg;
+    const ssize_t size = read(cache.uffd, &msg, sizeof(msg));
+    if (size < 0 && errno != EINTR && errno != EAGAIN) {
+      return NULL;
+    }
+    if (size == sizeof(msg) && msg.event == UFFD_EVENT_PAGEFAULT) {
+      map_fault((char*)(uintptr_t)msg.arg.pagefault.address);
+    }
+  }
+}
+
+// Opens the userfaultfd shared by all regions and starts its fault handler.
+static int map_init(void) {
+  if (cache.uffd >= 0) {
+    return 0;
+  }
+
+  const int uffd = (int)syscall(SYS_userfaultfd, O_CLOEXEC);
+  if (uffd < 0) {
+    return -1;
+  }
+  struct uffdio_api api = {.api = UFFD_API};
+  if (ioctl(uffd, UFFDIO_API, &api) != 0) {
+    close(uffd);
+    return -1;
+  }
+
+  cache.uffd = uffd;
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, fault_main, NULL) != 0) {
+    cache.uffd = -1;
+    close(uffd);
+    errno = EAGAIN;
+    return -1;
+  }
+  pthread_detach(thread);
+  return 0;
+}
+
 int vtpc_open(const char* path, int mode, int access) {
-  return open(path, mode, access);
+  if (cache_ready() != 0) {
+    return -1;
+  }
+
+  // Writes land at the cached position, so the kernel must not move them to
+  // its idea of the end of file. Nor may it truncate a file whose writes may
+  // be in flight: that is done under the cache lock once they are out. The
+  // descriptor may serve every handle of the file, and partial blocks are
+  // read before written, so write-only opens read too where the file lets
+  // them; otherwise partial writes to uncached blocks go around the cache.
+  const int flags = mode & ~(O_APPEND | O_TRUNC);
+  int fd = -1;
+  if ((mode & O_ACCMODE) == O_WRONLY) {
+    fd = backend_open(path, (flags & ~O_ACCMODE) | O_RDWR, access);
+  }
+  if (fd < 0 && ((mode & O_ACCMODE) != O_WRONLY || errno == EACCES)) {
+    fd = backend_open(path, flags, access);
+  }
+  if (fd < 0) {
+    return -1;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return -1;
+  }
+
+  pthread_mutex_lock(&cache.lock);
+  const int handle = handle_attach(path, fd, mode, &st);
+  int error = errno;
+  // Read-only handles keep the file as it is, whatever O_TRUNC says.
+  const bool truncate = handle >= 0 && (mode & O_TRUNC) != 0 &&
+                        (mode & O_ACCMODE) != O_RDONLY;
+  const int status = truncate ? file_truncate(handle_get(handle)->file, 0) : 0;
+  if (status != 0) {
+    error = errno;
+  }
+  pthread_mutex_unlock(&cache.lock);
+
+  if (status != 0) {
+    vtpc_close(handle);
+    errno = error;
+    return -1;
+  }
+  errno = error;
+  return handle;
 }
 
 int vtpc_close(int fd) {
-  return close(fd);
+  struct vtpc_handle* handle = handle_acquire(fd);
+  if (handle == NULL) {
+    return -1;
+  }
+  pthread_mutex_lock(&handle->lock);
+  atomic_store_explicit(&handle->id, 0, memory_order_release);
+  pthread_mutex_unlock(&handle->lock);
+
+  // The slot stays taken until the buffered run is out, and the run is
+  // dropped if it cannot be written.
+  struct vtpc_file* file = handle->file;
+  int status = combine_commit(handle);
+  int error = errno;
+  if (status != 0) {
+    combine_discard(handle);
+  }
+  handle_free_slot((size_t)(handle - cache.handles));
+
+  free(handle->links);
+  handle->links = NULL;
+  handle->file = NULL;
+
+  if (file_release(file) != 0 && status == 0) {
+    status = -1;
+    error = errno;
+  }
+  pthread_mutex_unlock(&cache.lock);
+  errno = error;
+  return status;
+}
+
+// Copies a chunk of a frame without the cache lock. A writer may change the
+// frame meanwhile, which is a data race in the C sense: the copy may come out
+// torn. The caller sees the page version changed and throws the copy away, so
+// no torn bytes reach the reader. tsan.supp names this function, which must
+// stay out of line for that, and only this copy may race.
+__attribute__((noinline)) static void frame_peek(char* to, const char* from,
+                                                 size_t len, bool stream) {
+  if (stream) {
+    vtpc_copy_stream(to, from, len);
+  } else {
+    memcpy(to, from, len);
+  }
 }
 
 ssize_t vtpc_read(int fd, void* buf, size_t count) {
-  return read(fd, buf, count);
+  struct vtpc_handle* handle = handle_acquire(fd);
+  if (handle == NULL) {
+    return -1;
+  }
+  if (handle->access == O_WRONLY) {
+    pthread_mutex_unlock(&cache.lock);
+    errno = EBADF;
+    return -1;
+  }
+
+  struct vtpc_file* file = handle->file;
+  file_check(file);
+  pthread_mutex_lock(&handle->lock);
+  const off_t pos = handle->pos;
+  const struct vtpc_combine* combine = &handle->combine;
+  const off_t end = combine->offset + (off_t)combine->len;
+  const bool apart = file->combiner == handle && end <= file->size &&
+                     (pos >= end || pos + (off_t)count <= combine->offset);
+  pthread_mutex_unlock(&handle->lock);
+
+  // The read must see buffered writes, unless they are this handle's own
+  // and lie outside it.
+  if (!apart && file_combine(file) != 0) {
+    pthread_mutex_unlock(&cache.lock);
+    return -1;
+  }
+  if (pos >= file->size) {
+    pthread_mutex_unlock(&cache.lock);
+    return 0;
+  }
+  if ((off_t)count > file->size - pos) {
+    count = file->size - pos;
+  }
+  predict(handle, pos, count);
+
+  const bool cold = handle->advice == POSIX_FADV_NOREUSE;
+  const bool stream = count >= VTPC_STREAM_COPY_BYTES;
+  bool raced = false;
+  size_t done = 0;
+  while (done < count) {
+    const off_t offset = pos + (off_t)done;
+    const size_t shift = offset % file->block;
+    size_t chunk = file->block - shift;
+    if (chunk > count - done) {
+      chunk = count - done;
+    }
+
+    if (!raced) {
+      vtpc_trace(file->id, offset / VTPC_PAGE_SIZE, VTPC_TRACE_READ);
+    }
+    struct vtpc_page* page =
+        page_get(file, offset / (off_t)file->block, true, cold);
+    if (page == NULL) {
+      break;
+    }
+
+    // Large chunks are copied without the cache lock, from a frame that
+    // stays allocated while the read is in its epoch. The frame and version
+    // are taken under the lock, as writers may give the page another frame
+    // meanwhile, and a copy that raced a write or the removal of the page
+    // is redone, under the lock this time. Finding the page and checking
+    // the copy still take the lock, so an optimistic chunk locks it twice:
+    // this only keeps eviction and writers from waiting on the copy.
+    const bool optimistic = !raced && chunk >= VTPC_OPTIMISTIC_BYTES &&
+                            vtpc_reclaim_enter(cache.reclaim);
+    const unsigned long version = page->version;
+    const char* data = page->data;
+    if (optimistic) {
+      pthread_mutex_unlock(&cache.lock);
+    }
+    if (optimistic) {
+      frame_peek((char*)buf + done, data + shift, chunk, stream);
+    } else if (stream) {
+      vtpc_copy_stream((char*)buf + done, data + shift, chunk);
+    } else {
+      memcpy((char*)buf + done, data + shift, chunk);
+    }
+    if (optimistic) {
+      pthread_mutex_lock(&cache.lock);
+      vtpc_reclaim_exit(cache.reclaim);
+      cache.stats.optimistic_reads += 1;
+      // Allocations may be waiting for the frames this read held back.
+      if (cache.retired != 0) {
+        pthread_cond_broadcast(&cache.loaded);
+      }
+      raced = page->version != version;
+      if (raced) {
+        cache.stats.optimistic_retries += 1;
+        continue;
+      }
+    }
+    raced = false;
+    done += chunk;
+
+    // A sequential reader will not come back to pages it has finished.
+    if (handle->advice == POSIX_FADV_SEQUENTIAL &&
+        shift + chunk == file->block) {
+      lru_demote(page);
+    }
+  }
+
+  if (stream) {
+    vtpc_copy_fence();
+  }
+  pthread_mutex_lock(&handle->lock);
+  handle->pos = pos + (off_t)done;
+  pthread_mutex_unlock(&handle->lock);
+  pthread_mutex_unlock(&cache.lock);
+
+  if (done == 0 && count != 0) {
+    return -1;
+  }
+  return (ssize_t)done;
 }
 
 ssize_t vtpc_write(int fd, const void* buf, size_t count) {
-  return write(fd, buf, count);
+  if (count != 0 && count < VTPC_COMBINE_BYTES &&
+      combine_append(fd, buf, count)) {
+    return (ssize_t)count;
+  }
+
+  struct vtpc_handle* handle = handle_acquire(fd);
+  if (handle == NULL) {
+    return -1;
+  }
+  if (handle->access == O_RDONLY) {
+    pthread_mutex_unlock(&cache.lock);
+    errno = EBADF;
+    return -1;
+  }
+
+  // Faults on a mapped source are served under the cache lock, so copy it
+  // out before taking the lock for the write itself.
+  if (map_overlaps(buf, count)) {
+    pthread_mutex_unlock(&cache.lock);
+    void* bounce = malloc(count);
+    if (bounce == NULL) {
+      errno = ENOMEM;
+      return -1;
+    }
+    memcpy(bounce, buf, count);
+    const ssize_t status = vtpc_write(fd, bounce, count);
+    free(bounce);
+    return status;
+  }
+
+  struct vtpc_file* file = handle->file;
+  file_check(file);
+  // Appends go to the cached end of file, which must include every buffered
+  // run, even one started while another was being committed.
+  int status = file_combine(file);
+  while (status == 0 && handle->append && file->combiner != NULL) {
+    status = file_combine(file);
+  }
+  if (status != 0) {
+    pthread_mutex_unlock(&cache.lock);
+    return -1;
+  }
+  pthread_mutex_lock(&handle->lock);
+  const off_t pos = handle->append ? file->size : handle->pos;
+  pthread_mutex_unlock(&handle->lock);
+  if (count != 0 && count < VTPC_COMBINE_BYTES &&
+      combine_start(handle, pos, buf, count)) {
+    pthread_mutex_unlock(&cache.lock);
+    return (ssize_t)count;
+  }
+  // Loads drop the cache lock and let other appends in, so the append
+  // claims its range first; what it fails to write is given back if no
+  // append came after it.
+  if (handle->append) {
+    file->size = pos + (off_t)count;
+  }
+
+  // Frames are written back by DMA, so large writes need not pass through
+  // the CPU caches on their way in.
+  const bool stream = count >= VTPC_STREAM_COPY_BYTES;
+  size_t done = 0;
+  while (done < count) {
+    const off_t offset = pos + (off_t)done;
+    const off_t index = offset / (off_t)file->block;
+    const size_t shift = offset % file->block;
+    size_t chunk = file->block - shift;
+    if (chunk > count - done) {
+      chunk = count - done;
+    }
+
+    const bool fill = chunk != file->block;
+    const bool cold = handle->advice == POSIX_FADV_NOREUSE;
+    vtpc_trace(file->id, offset / VTPC_PAGE_SIZE, VTPC_TRACE_WRITE);
+    if (fill && !file->readable && index * (off_t)file->block < file->size &&
+        page_lookup(file, index) == NULL) {
+      const char* from = (const char*)buf + done;
+      if (file_write_around(file, offset, from, chunk) != 0) {
+        break;
+      }
+      done += chunk;
+      if (offset + (off_t)chunk > file->size) {
+        file->size = offset + (off_t)chunk;
+      }
+      continue;
+    }
+    struct vtpc_page* page = page_get(file, index, fill, cold);
+    if (page == NULL) {
+      break;
+    }
+    page_stable(page);
+    page_own(page);
+    if (stream) {
+      vtpc_copy_stream(page->data + shift, (const char*)buf + done, chunk);
+    } else {
+      memcpy(page->data + shift, (const char*)buf + done, chunk);
+    }
+    page->dirty = true;
+    page->version += 1;
+    done += chunk;
+    if (file->maps != NULL) {
+      page_zap(page);
+    }
+
+    if (offset + (off_t)chunk > file->size) {
+      file->size = offset + (off_t)chunk;
+    }
+  }
+
+  if (stream) {
+    vtpc_copy_fence();
+  }
+  if (handle->append && done < count && file->size == pos + (off_t)count) {
+    file->size = pos + (off_t)done;
+  }
+  // Zero pages given frames may have pushed the cache past its capacity,
+  // though like in page_alloc one block may exceed it alone. A failed
+  // writeback here leaves the page dirty for fsync to report.
+  if (cache.resident > cache.capacity && cache.resident > file->block) {
+    cache_shrink();
+  }
+  pthread_mutex_lock(&handle->lock);
+  handle->pos = pos + (off_t)done;
+  pthread_mutex_unlock(&handle->lock);
+  pthread_mutex_unlock(&cache.lock);
+
+  if (done == 0 && count != 0) {
+    return -1;
+  }
+  return (ssize_t)done;
+}
+
+// Moves the position for a seek from the start or the current position that
+// leaves the buffered run going, which needs only the handle lock. Returns
+// false if the seek needs the cache lock: to end the run, or to fail.
+static bool seek_quick(int fd, off_t offset, int whence, off_t* result) {
+  struct vtpc_handle* handle = handle_get(fd);
+  if (handle == NULL || (whence != SEEK_SET && whence != SEEK_CUR)) {
+    return false;
+  }
+  pthread_mutex_lock(&handle->lock);
+  const off_t base = whence == SEEK_SET ? 0 : handle->pos;
+  const struct vtpc_combine* combine = &handle->combine;
+  const bool quick =
+      atomic_load_explicit(&handle->id, memory_order_relaxed) == fd &&
+      offset >= -base && (offset <= 0 || base <= INT64_MAX - offset) &&
+      (combine->len == 0 ||
+       offset + base == combine->offset + (off_t)combine->len);
+  if (quick) {
+    handle->pos = offset + base;
+    *result = handle->pos;
+  }
+  pthread_mutex_unlock(&handle->lock);
+  return quick;
 }
 
 off_t vtpc_lseek(int fd, off_t offset, int whence) {
-  return lseek(fd, offset, whence);
+  off_t result = 0;
+  if (seek_quick(fd, offset, whence, &result)) {
+    return result;
+  }
+
+  struct vtpc_handle* handle = handle_acquire(fd);
+  if (handle == NULL) {
+    return -1;
+  }
+  if (whence != SEEK_SET && whence != SEEK_CUR && whence != SEEK_END) {
+    pthread_mutex_unlock(&cache.lock);
+    errno = EINVAL;
+    return -1;
+  }
+  // The end of file must include buffered writes, and other writers' too.
+  struct vtpc_file* file = handle->file;
+  if (whence == SEEK_END) {
+    file_check(file);
+  }
+  if (whence == SEEK_END && file_combine(file) != 0) {
+    pthread_mutex_unlock(&cache.lock);
+    return -1;
+  }
+
+  pthread_mutex_lock(&handle->lock);
+  const off_t base = whence == SEEK_SET   ? 0
+                     : whence == SEEK_CUR ? handle->pos
+                                          : file->size;
+  if (offset < -base || (offset > 0 && base > INT64_MAX - offset)) {
+    pthread_mutex_unlock(&handle->lock);
+    pthread_mutex_unlock(&cache.lock);
+    errno = offset < 0 ? EINVAL : EOVERFLOW;
+    return -1;
+  }
+  offset += base;
+  const struct vtpc_combine* combine = &handle->combine;
+  const bool broken =
+      combine->len != 0 && offset != combine->offset + (off_t)combine->len;
+  handle->pos = offset;
+  pthread_mutex_unlock(&handle->lock);
+
+  // A seek away ends the buffered run. Should the commit fail, the run
+  // stays buffered and the next write, fsync or close reports the error.
+  if (broken) {
+    combine_commit(handle);
+  }
+  pthread_mutex_unlock(&cache.lock);
+  return offset;
+}
+
+int vtpc_ftruncate(int fd, off_t length) {
+  if (length < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  struct vtpc_handle* handle = handle_acquire(fd);
+  if (handle == NULL) {
+    return -1;
+  }
+  if (handle->access == O_RDONLY) {
+    pthread_mutex_unlock(&cache.lock);
+    errno = EINVAL;
+    return -1;
+  }
+
+  const int status = file_truncate(handle->file, length);
+  const int error = errno;
+  pthread_mutex_unlock(&cache.lock);
+
+  errno = error;
+  return status;
 }
 
 int vtpc_fsync(int fd) {
-  return fsync(fd);
+  struct vtpc_handle* handle = handle_acquire(fd);
+  if (handle == NULL) {
+    return -1;
+  }
+
+  struct vtpc_file* file = handle->file;
+  if (file_flush(file) != 0) {
+    pthread_mutex_unlock(&cache.lock);
+    return -1;
+  }
+
+  // The sync runs without the cache lock. Keeping the file busy meanwhile
+  // holds off reopening it or upgrading it for writes, which close the
+  // descriptor being synced, and its last close.
+  const int io = file->fd;
+  const struct vtpc_backend* backend = cache.backend;
+  file->busy += 1;
+  pthread_mutex_unlock(&cache.lock);
+  const int status = backend->sync(io);
+  const int error = errno;
+
+  pthread_mutex_lock(&cache.lock);
+  file->busy -= 1;
+  pthread_cond_broadcast(&cache.loaded);
+  pthread_mutex_unlock(&cache.lock);
+  errno = error;
+  return status;
+}
+
+int vtpc_prefetch(int fd, off_t offset, size_t len) {
+  struct vtpc_handle* handle = handle_acquire(fd);
+  if (handle == NULL) {
+    return -1;
+  }
+  if (offset < 0) {
+    pthread_mutex_unlock(&cache.lock);
+    errno = EINVAL;
+    return -1;
+  }
+
+  prefetch_range(handle->file, offset, len, VTPC_SOURCE_PREFETCH);
+  pthread_mutex_unlock(&cache.lock);
+  return 0;
+}
+
+int vtpc_fadvise(int fd, off_t offset, off_t len, int advice) {
+  struct vtpc_handle* handle = handle_acquire(fd);
+  if (handle == NULL) {
+    return -1;
+  }
+  if (offset < 0 || len < 0) {
+    pthread_mutex_unlock(&cache.lock);
+    errno = EINVAL;
+    return -1;
+  }
+
+  struct vtpc_file* file = handle->file;
+  const off_t end = len == 0 ? file->size : offset + len;
+  int status = 0;
+  switch (advice) {
+    case POSIX_FADV_NORMAL:
+    case POSIX_FADV_SEQUENTIAL:
+    case POSIX_FADV_RANDOM:
+    case POSIX_FADV_NOREUSE:
+      handle->advice = advice;
+      break;
+    case POSIX_FADV_WILLNEED:
+      if (end > offset) {
+        prefetch_range(
+            file, offset, (size_t)(end - offset), VTPC_SOURCE_PREFETCH
+        );
+      }
+      break;
+    case POSIX_FADV_DONTNEED:
+      status = file_combine(file);
+      if (status != 0) {
+        break;
+      }
+      status = file_dontneed(
+          file,
+          offset / (off_t)file->block,
+          (end + (off_t)file->block - 1) / (off_t)file->block
+      );
+      break;
+    default:
+      errno = EINVAL;
+      status = -1;
+      break;
+  }
+
+  pthread_mutex_unlock(&cache.lock);
+  return status;
+}
+
+void* vtpc_mmap(int fd, off_t offset, size_t len) {
+  if (offset < 0 || offset % VTPC_PAGE_SIZE != 0 || len == 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+  len = (len + VTPC_PAGE_SIZE - 1) / VTPC_PAGE_SIZE * VTPC_PAGE_SIZE;
+
+  struct vtpc_handle* handle = handle_acquire(fd);
+  if (handle == NULL) {
+    return NULL;
+  }
+  if (handle->access == O_WRONLY) {
+    pthread_mutex_unlock(&cache.lock);
+    errno = EBADF;
+    return NULL;
+  }
+
+  // Mapped files are not buffered, as the mapping is read without the cache.
+  if (file_combine(handle->file) != 0) {
+    pthread_mutex_unlock(&cache.lock);
+    return NULL;
+  }
+
+  struct vtpc_map* map = calloc(1, sizeof(*map));
+  if (map == NULL || map_init() != 0) {
+    const int error = map == NULL ? ENOMEM : errno;
+    pthread_mutex_unlock(&cache.lock);
+    free(map);
+    errno = error;
+    return NULL;
+  }
+
+  char* addr =
+      mmap(NULL, len, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  struct uffdio_register reg = {
+      .range = {.start = (uintptr_t)addr, .len = len},
+      .mode = UFFDIO_REGISTER_MODE_MISSING,
+  };
+  if (addr == MAP_FAILED || ioctl(cache.uffd, UFFDIO_REGISTER, &reg) != 0) {
+    const int error = errno;
+    if (addr != MAP_FAILED) {
+      munmap(addr, len);
+    }
+    pthread_mutex_unlock(&cache.lock);
+    free(map);
+    errno = error;
+    return NULL;
+  }
+
+  struct vtpc_file* file = handle->file;
+  file->refs += 1;
+  map->file = file;
+  map->addr = addr;
+  map->len = len;
+  map->offset = offset;
+  map->next = cache.maps;
+  cache.maps = map;
+  map->file_next = file->maps;
+  file->maps = map;
+
+  pthread_mutex_unlock(&cache.lock);
+  return addr;
+}
+
+int vtpc_munmap(void* addr, size_t len) {
+  len = (len + VTPC_PAGE_SIZE - 1) / VTPC_PAGE_SIZE * VTPC_PAGE_SIZE;
+
+  pthread_mutex_lock(&cache.lock);
+  struct vtpc_map** link = &cache.maps;
+  while (*link != NULL && (*link)->addr != addr) {
+    link = &(*link)->next;
+  }
+  struct vtpc_map* map = *link;
+  if (map == NULL || map->len != len) {
+    pthread_mutex_unlock(&cache.lock);
+    errno = EINVAL;
+    return -1;
+  }
+  *link = map->next;
+
+  struct vtpc_file* file = map->file;
+  struct vtpc_map** file_link = &file->maps;
+  while (*file_link != map) {
+    file_link = &(*file_link)->file_next;
+  }
+  *file_link = map->file_next;
+
+  struct uffdio_range range = {.start = (uintptr_t)map->addr, .len = map->len};
+  ioctl(cache.uffd, UFFDIO_UNREGISTER, &range);
+  munmap(map->addr, map->len);
+  free(map);
+
+  const int status = file_release(file);
+  pthread_mutex_unlock(&cache.lock);
+  return status;
+}
+
+int vtpc_trace_start(const char* path) {
+  if (cache_ready() != 0) {
+    return -1;
+  }
+  pthread_mutex_lock(&cache.lock);
+  const int status = vtpc_trace_open(path, VTPC_PAGE_SIZE);
+  pthread_mutex_unlock(&cache.lock);
+  return status;
+}
+
+int vtpc_trace_stop(void) {
+  pthread_mutex_lock(&cache.lock);
+  const int status = vtpc_trace_close();
+  pthread_mutex_unlock(&cache.lock);
+  return status;
+}
+
+static void trace_exit(void) {
+  pthread_mutex_lock(&cache.lock);
+  if (atomic_load(&vtpc_trace_active)) {
+    vtpc_trace_close();
+  }
+  pthread_mutex_unlock(&cache.lock);
+}
+
+int vtpc_manifest_open(const char* path) {
+  if (cache_ready() != 0) {
+    return -1;
+  }
+  char* copy = strdup(path);
+  if (copy == NULL) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  pthread_mutex_lock(&cache.lock);
+  if (cache.manifest == NULL) {
+    cache.manifest = vtpc_manifest_create();
+  }
+  int status = -1;
+  if (cache.manifest == NULL) {
+    errno = ENOMEM;
+  } else {
+    status = vtpc_manifest_read(cache.manifest, path);
+  }
+  if (status == 0) {
+    free(cache.manifest_path);
+    cache.manifest_path = copy;
+    copy = NULL;
+  }
+  const int error = errno;
+  pthread_mutex_unlock(&cache.lock);
+
+  free(copy);
+  errno = error;
+  return status;
+}
+
+int vtpc_manifest_save(void) {
+  pthread_mutex_lock(&cache.lock);
+  int status = -1;
+  if (cache.manifest_path == NULL) {
+    errno = EINVAL;
+  } else {
+    status = manifest_save();
+  }
+  const int error = errno;
+  pthread_mutex_unlock(&cache.lock);
+  errno = error;
+  return status;
+}
+
+static void manifest_exit(void) {
+  pthread_mutex_lock(&cache.lock);
+  if (cache.manifest_path != NULL) {
+    manifest_save();
+  }
+  pthread_mutex_unlock(&cache.lock);
+}
+
+int vtpc_set_capacity(size_t bytes) {
+  if (cache_ready() != 0) {
+    return -1;
+  }
+  if (bytes == 0 || bytes > VTPC_BUDGET) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  pthread_mutex_lock(&cache.lock);
+  cache.marginal = 0;
+  cache.capacity = bytes;
+  const int status = cache_shrink();
+  pthread_mutex_unlock(&cache.lock);
+  return status;
+}
+
+int vtpc_set_backend(const char* name) {
+  if (cache_ready() != 0) {
+    return -1;
+  }
+  const struct vtpc_backend* backend = vtpc_backend_find(name);
+  if (backend == NULL) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&cache.lock);
+  const bool busy = cache.files != NULL;
+  if (!busy) {
+    cache.backend = backend;
+  }
+  pthread_mutex_unlock(&cache.lock);
+
+  if (busy) {
+    errno = EBUSY;
+    return -1;
+  }
+  return 0;
+}
+
+int vtpc_set_policy(const char* name) {
+  if (cache_ready() != 0) {
+    return -1;
+  }
+  const int policy = policy_find(name);
+  if (policy < 0) {
+    return -1;
+  }
+
+  // Without open files no page is cached, so the queues are empty.
+  pthread_mutex_lock(&cache.lock);
+  const bool busy = cache.files != NULL;
+  if (!busy) {
+    cache.policy = policy;
+    cache.cold_target = cache.capacity / 4;
+    vtpc_ghost_clear(cache.ghost);
+  }
+  pthread_mutex_unlock(&cache.lock);
+
+  if (busy) {
+    errno = EBUSY;
+    return -1;
+  }
+  return 0;
+}
+
+int vtpc_set_revalidate(uint64_t interval_ns) {
+  if (cache_ready() != 0) {
+    return -1;
+  }
+  pthread_mutex_lock(&cache.lock);
+  cache.revalidate = interval_ns;
+  pthread_mutex_unlock(&cache.lock);
+  return 0;
+}
+
+static struct vtpc_file* watch_find(int watch) {
+  struct vtpc_file* file = cache.files;
+  while (file != NULL && file->watch != watch) {
+    file = file->next;
+  }
+  return file;
+}
+
+// The descriptors of a watch thread. It gets its own copy, as stopping it
+// takes them out of the cache before it may have started.
+struct vtpc_watch {
+  int inotify;
+  int stop;
+};
+
+// Revalidates files as inotify reports changes to them, until the stop
+// eventfd is written. The check drops the cache lock, so it holds a
+// reference to keep a close from freeing the file.
+static void* watch_main(void* arg) {
+  const struct vtpc_watch watch = *(const struct vtpc_watch*)arg;
+  free(arg);
+
+  struct pollfd fds[] = {
+      {.fd = watch.inotify, .events = POLLIN},
+      {.fd = watch.stop, .events = POLLIN},
+  };
+  _Alignas(struct inotify_event) char buffer[4096];
+  for (;;) {
+    if (poll(fds, 2, -1) < 0 && errno != EINTR) {
+      return NULL;
+    }
+    if (fds[1].revents != 0) {
+      return NULL;
+    }
+    if (fds[0].revents == 0) {
+      continue;
+    }
+    const ssize_t size = read(watch.inotify, buffer, sizeof(buffer));
+    if (size < 0 && errno != EINTR) {
+      return NULL;
+    }
+    pthread_mutex_lock(&cache.lock);
+    ssize_t at = 0;
+    while (at < size) {
+      const struct inotify_event* event = (const void*)(buffer + at);
+      at += (ssize_t)(sizeof(*event) + event->len);
+      struct vtpc_file* file = watch_find(event->wd);
+      if (file != NULL && file->refs != 0) {
+        file->refs += 1;
+        file_revalidate(file);
+        file_release(file);
+      }
+    }
+    pthread_mutex_unlock(&cache.lock);
+  }
+}
+
+// Creates the inotify instance and starts the thread reading it.
+static int watch_start(void) {
+  struct vtpc_watch* watch = malloc(sizeof(*watch));
+  if (watch == NULL) {
+    return -1;
+  }
+  const int inotify = inotify_init1(IN_CLOEXEC);
+  const int stop = eventfd(0, EFD_CLOEXEC);
+  int error = errno;
+  if (inotify >= 0 && stop >= 0) {
+    watch->inotify = inotify;
+    watch->stop = stop;
+    if (pthread_create(&cache.watcher, NULL, watch_main, watch) == 0) {
+      cache.inotify = inotify;
+      cache.watch_stop = stop;
+      return 0;
+    }
+    error = EAGAIN;
+  }
+  if (inotify >= 0) {
+    close(inotify);
+  }
+  if (stop >= 0) {
+    close(stop);
+  }
+  free(watch);
+  errno = error;
+  return -1;
+}
+
+// Stops the thread watch_start started and closes its descriptors. The
+// caller has taken them out of the cache and dropped the cache lock, which
+// the thread may be waiting for.
+static void watch_end(int inotify, int stop, pthread_t watcher) {
+  const uint64_t one = 1;
+  if (write(stop, &one, sizeof(one)) == sizeof(one)) {
+    pthread_join(watcher, NULL);
+  } else {
+    pthread_detach(watcher);
+  }
+  close(inotify);
+  close(stop);
+}
+
+int vtpc_set_watch(bool watch) {
+  if (cache_ready() != 0) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&cache.lock);
+  if (watch && cache.inotify < 0 && watch_start() != 0) {
+    const int error = errno;
+    pthread_mutex_unlock(&cache.lock);
+    errno = error;
+    return -1;
+  }
+
+  cache.watching = watch;
+  for (struct vtpc_file* file = cache.files; file != NULL; file = file->next) {
+    if (watch && file->watch < 0) {
+      file->watch = watch_add(file->path);
+    } else if (!watch && file->watch >= 0) {
+      inotify_rm_watch(cache.inotify, file->watch);
+      file->watch = -1;
+    }
+  }
+
+  // The instance leaves the cache before the thread is stopped, so that a
+  // call starting to watch again meanwhile makes a new one.
+  const int inotify = watch ? -1 : cache.inotify;
+  const int stop = cache.watch_stop;
+  const pthread_t watcher = cache.watcher;
+  if (inotify >= 0) {
+    cache.inotify = -1;
+    cache.watch_stop = -1;
+  }
+  pthread_mutex_unlock(&cache.lock);
+
+  if (inotify >= 0) {
+    watch_end(inotify, stop, watcher);
+  }
+  return 0;
+}
+
+int vtpc_set_device(const struct vtpc_device* device) {
+  if (cache_ready() != 0) {
+    return -1;
+  }
+  const struct vtpc_backend* sim = vtpc_backend_find("sim");
+
+  // The backend is checked and the device validated before either changes,
+  // so a failed call leaves both as they were.
+  pthread_mutex_lock(&cache.lock);
+  int status = 0;
+  if (cache.backend != sim && cache.files != NULL) {
+    errno = EBUSY;
+    status = -1;
+  } else {
+    status = vtpc_backend_set_device(device);
+  }
+  if (status == 0) {
+    cache.backend = sim;
+  }
+  const int error = errno;
+  pthread_mutex_unlock(&cache.lock);
+
+  errno = error;
+  return status;
+}
+
+int vtpc_set_group(int fd, unsigned group) {
+  if (group >= VTPC_GROUPS) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  struct vtpc_handle* handle = handle_acquire(fd);
+  if (handle == NULL) {
+    return -1;
+  }
+  struct vtpc_file* file = handle->file;
+  for (const struct vtpc_page* page = file->pages; page != NULL;
+       page = page->file_next) {
+    if (!page->zero) {
+      cache.groups[file->group].resident -= page->arena->size;
+      cache.groups[group].resident += page->arena->size;
+    }
+  }
+  file->group = (uint8_t)group;
+  pthread_mutex_unlock(&cache.lock);
+  return 0;
+}
+
+int vtpc_set_share(unsigned group, size_t reserve, size_t limit) {
+  if (cache_ready() != 0) {
+    return -1;
+  }
+  if (group >= VTPC_GROUPS || (limit != 0 && reserve > limit)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  pthread_mutex_lock(&cache.lock);
+  size_t reserved = reserve;
+  for (size_t i = 0; i < VTPC_GROUPS; ++i) {
+    reserved += i != group ? cache.groups[i].reserve : 0;
+  }
+  const bool valid = reserved <= VTPC_BUDGET;
+  if (valid) {
+    cache.groups[group].reserve = reserve;
+    cache.groups[group].limit = limit != 0 ? limit : SIZE_MAX;
+    cache.grouped = false;
+    for (size_t i = 0; i < VTPC_GROUPS; ++i) {
+      cache.grouped = cache.grouped || cache.groups[i].reserve != 0 ||
+                      cache.groups[i].limit != SIZE_MAX;
+    }
+  }
+  pthread_mutex_unlock(&cache.lock);
+
+  if (!valid) {
+    errno = EINVAL;
+    return -1;
+  }
+  return 0;
+}
+
+int vtpc_set_block_size(int fd, size_t bytes) {
+  if (bytes < VTPC_PAGE_SIZE || bytes > VTPC_BLOCK_MAX ||
+      (bytes & (bytes - 1)) != 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  struct vtpc_handle* handle = handle_acquire(fd);
+  if (handle == NULL) {
+    return -1;
+  }
+  struct vtpc_file* file = handle->file;
+  if (file->block == bytes) {
+    pthread_mutex_unlock(&cache.lock);
+    return 0;
+  }
+  if (file->maps != NULL) {
+    pthread_mutex_unlock(&cache.lock);
+    errno = EBUSY;
+    return -1;
+  }
+  struct vtpc_arena* arena = arena_get(bytes);
+  if (arena == NULL) {
+    pthread_mutex_unlock(&cache.lock);
+    return -1;
+  }
+
+  // Flush until nothing is loading either, so no write slips in before the
+  // drop.
+  int status = 0;
+  while ((status = file_flush(file)) == 0 && file->busy != 0) {
+    file_wait_idle(file);
+  }
+  if (status != 0) {
+    pthread_mutex_unlock(&cache.lock);
+    return -1;
+  }
+
+  // Page indices change meaning with the block size, so the cached pages and
+  // whatever the predictors learned about them go.
+  file_drop(file);
+  file->block = bytes;
+  file->arena = arena;
+  for (size_t slot = 0; slot < cache.used_handles; ++slot) {
+    struct vtpc_handle* other = &cache.handles[slot];
+    if (atomic_load_explicit(&other->id, memory_order_relaxed) == 0 ||
+        other->file != file) {
+      continue;
+    }
+    for (size_t i = 0; i < VTPC_LINKS; ++i) {
+      other->links[i].from = -1;
+    }
+    other->last_page = -1;
+    other->ahead = 0;
+  }
+  pthread_mutex_unlock(&cache.lock);
+  return 0;
+}
+
+int vtpc_autosize(double marginal) {
+  if (cache_ready() != 0) {
+    return -1;
+  }
+  if (!(marginal >= 0)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  pthread_mutex_lock(&cache.lock);
+  cache.marginal = marginal;
+  pthread_mutex_unlock(&cache.lock);
+  return 0;
+}
+
+void vtpc_get_stats(struct vtpc_stats* stats) {
+  pthread_mutex_lock(&cache.lock);
+  *stats = cache.stats;
+  stats->capacity = cache.capacity;
+  stats->retired_frames = cache.retired;
+  stats->mrc_step = (uint64_t)VTPC_MRC_STEP * VTPC_PAGE_SIZE;
+  for (size_t i = 0; i < VTPC_GROUPS; ++i) {
+    stats->group_resident[i] = cache.groups[i].resident;
+  }
+  if (cache.mrc != NULL) {
+    vtpc_mrc_curve(cache.mrc, stats->mrc, VTPC_MRC_POINTS);
+  } else {
+    for (size_t i = 0; i < VTPC_MRC_POINTS; ++i) {
+      stats->mrc[i] = 1;
+    }
+  }
+  pthread_mutex_unlock(&cache.lock);
 }
@@ -1,10 +1,225 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <sys/types.h>
 
+#define VTPC_MRC_POINTS 32
+#define VTPC_GROUPS 16
+
+struct vtpc_stats {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  uint64_t writebacks;
+  uint64_t prefetch_issued;
+  uint64_t prefetch_dropped;
+  uint64_t prefetch_waits;
+  uint64_t prefetch_used;
+  uint64_t prefetch_unused;
+
+  // Prefetches issued by the per-descriptor stride and chain detector.
+  uint64_t predict_issued;
+  uint64_t predict_used;
+  uint64_t predict_unused;
+
+  uint64_t map_faults;
+
+  // Small sequential writes gathered per descriptor, and the commits that
+  // copied them to the cache in runs.
+  uint64_t combined_writes;
+  uint64_t combine_commits;
+
+  // Partial writes to uncached blocks of files opened without read
+  // permission, which go straight to the file as the blocks cannot be read.
+  uint64_t write_arounds;
+
+  // Loaded blocks found all zeros and cached as the shared zero frame, and
+  // how many of them were holes that needed no read.
+  uint64_t zero_pages;
+  uint64_t zero_holes;
+
+  // Chunks copied without the cache lock, which is still taken to find the
+  // page and check the copy, and those redone because the page changed or
+  // was evicted meanwhile. Evicted frames such reads may still be copying
+  // from wait in retired_frames before they are reused.
+  uint64_t optimistic_reads;
+  uint64_t optimistic_retries;
+  uint64_t retired_frames;
+
+  // Misses on blocks the eviction policy remembered evicting recently.
+  uint64_t ghost_hits;
+
+  // Checks of cached files against the disk, and files found changed by
+  // another process, whose blocks were invalidated.
+  uint64_t revalidations;
+  uint64_t invalidations;
+
+  // Blocks queued for loading from the hot-set manifest.
+  uint64_t warm_issued;
+
+  // Writeback scheduling: pages queued, writes issued after merging
+  // adjacent pages, pages merged into another's write, writes served first
+  // for a passed deadline, and the deepest the queue got.
+  uint64_t writeback_queued;
+  uint64_t writeback_writes;
+  uint64_t writeback_merged;
+  uint64_t writeback_expired;
+  uint64_t writeback_depth_max;
+
+  // Bytes of frames the files of each share group hold, and pages of the
+  // group evicted.
+  uint64_t group_resident[VTPC_GROUPS];
+  uint64_t group_evictions[VTPC_GROUPS];
+
+  // Capacity in bytes, and the miss-ratio curve estimated from sampled reuse
+  // distances: mrc[i] is the expected miss ratio at (i + 1) * mrc_step bytes.
+  uint64_t capacity;
+  uint64_t mrc_step;
+  double mrc[VTPC_MRC_POINTS];
+};
+
+// How the latency of a simulated device request is drawn: always the mean,
+// uniformly from [0, 2 * mean], or exponentially around the mean.
+enum vtpc_latency {
+  VTPC_LATENCY_FIXED,
+  VTPC_LATENCY_UNIFORM,
+  VTPC_LATENCY_EXPONENTIAL,
+};
+
+// A simulated storage device. Each request waits for one of depth service
+// slots and for its turn under the IOPS cap, then takes a latency drawn
+// from the distribution plus its transfer time at bandwidth bytes per
+// second, which requests share. Zero bandwidth or iops means unlimited,
+// and the seed makes the latencies of a run reproducible.
+struct vtpc_device {
+  uint64_t latency_ns;
+  enum vtpc_latency distribution;
+  uint64_t bandwidth;
+  uint32_t depth;
+  uint64_t iops;
+  uint64_t seed;
+};
+
 int vtpc_open(const char* path, int mode, int access);
 int vtpc_close(int fd);
 ssize_t vtpc_read(int fd, void* buf, size_t count);
 ssize_t vtpc_write(int fd, const void* buf, size_t count);
 off_t vtpc_lseek(int fd, off_t offset, int whence);
 int vtpc_fsync(int fd);
+
+// Sets the size of the file, cutting off or zero-extending its contents.
+// Cached blocks past a lowered end are not visited but become stale, and
+// are dropped as they are next found, never written back.
+int vtpc_ftruncate(int fd, off_t length);
+
+// Queues asynchronous loads of the pages covering [offset, offset + len) and
+// returns without waiting for them. Pages that are already resident or in
+// flight are skipped, and pages beyond the in-flight budget are dropped.
+int vtpc_prefetch(int fd, off_t offset, size_t len);
+
+// Tells the cache how the descriptor will be used, with the POSIX_FADV_*
+// values of posix_fadvise. SEQUENTIAL widens readahead and evicts pages the
+// reader has passed first, RANDOM disables readahead and NOREUSE inserts
+// missed pages at the cold end; these apply to the whole descriptor.
+// WILLNEED prefetches the range, and DONTNEED writes back its dirty pages
+// and drops it. A zero len extends the range to the end of file.
+int vtpc_fadvise(int fd, off_t offset, off_t len, int advice);
+
+// Maps [offset, offset + len) of the file read-only. Pages are installed from
+// the cache on first access and unmapped again when the cache evicts or
+// rewrites them, so the region always shows the cached contents. The offset
+// must be page aligned. Returns NULL on failure.
+void* vtpc_mmap(int fd, off_t offset, size_t len);
+
+// Unmaps a region vtpc_mmap returned, as a whole: addr must be its start and
+// len its length, or fails with EINVAL. Partial unmapping is not supported.
+int vtpc_munmap(void* addr, size_t len);
+
+// Records every page access to a binary trace at path until stopped, for
+// replay by vtpc_sim. Setting VTPC_TRACE to a path traces a whole run.
+int vtpc_trace_start(const char* path);
+int vtpc_trace_stop(void);
+
+// Keeps a hot-set manifest at path: the blocks each file had cached, most
+// recently used first, recorded when its last descriptor closes. Entries of
+// an existing manifest at path are loaded, and opening a listed file that
+// still has the inode, size and mtime recorded loads its blocks in the
+// background in that order, into free frames only. vtpc_manifest_save
+// writes the manifest, adding the files still open. Setting VTPC_MANIFEST
+// to a path does the same for a whole run, saving at exit.
+int vtpc_manifest_open(const char* path);
+int vtpc_manifest_save(void);
+
+// Resizes the cache to the given number of bytes, at most the capacity it
+// was built with, and turns the auto-sizer off. Shrinking evicts at once,
+// writing back dirty pages.
+int vtpc_set_capacity(size_t bytes);
+
+// Sets the unit in which the file is cached, a power of two from 4 KiB to
+// 2 MiB; files start with 4 KiB. Larger blocks suit large sequential or
+// strided scans, with fewer misses and larger reads. The file's cached
+// blocks are written back and dropped, so call it right after vtpc_open.
+// Fails with EBUSY while the file is mapped.
+int vtpc_set_block_size(int fd, size_t bytes);
+
+// Puts the file in one of VTPC_GROUPS share groups; files start in group 0.
+// Its cached blocks are charged to the new group from then on.
+int vtpc_set_group(int fd, unsigned group);
+
+// Gives the group a reservation and a share of the cache, in bytes. Pages of
+// the group are not evicted for other groups while it holds no more than
+// reserve, unless every other page is reserved too, and the group holds at
+// most limit, evicting its own pages beyond it. Groups over their limit,
+// after the limit is lowered, lose pages first. A zero limit means none.
+// Fails with EINVAL if the reservations add up to more than the capacity
+// the cache was built with.
+int vtpc_set_share(unsigned group, size_t reserve, size_t limit);
+
+// Lets the cache size itself from its miss-ratio curve, growing while one
+// more page would turn at least marginal of all accesses into hits and
+// shrinking where it would not. A zero marginal turns it off.
+int vtpc_autosize(double marginal);
+
+// Selects the storage backend the cache does file I/O through: "pread" for
+// pread and pwritev through the kernel page cache, "direct" for the same
+// with O_DIRECT where the file system allows it, the default, "uring" for
+// io_uring with O_DIRECT, and "sim" for a simulated device over "pread".
+// Fails with EBUSY while files are open. Setting VTPC_BACKEND to a name
+// selects one for a whole run.
+int vtpc_set_backend(const char* name);
+
+// Sets the device the "sim" backend emulates and selects that backend.
+// Without a call it emulates an SSD: 100 us, 1 GB/s, 32 deep. Fails with
+// EBUSY while files are open under another backend, and with EINVAL for an
+// unknown distribution, changing nothing either way.
+int vtpc_set_device(const struct vtpc_device* device);
+
+// Selects how the cache picks pages to evict: "lru", the default, moves a
+// page to the front of a list on every hit; "clock-pro" and "s3-fifo" only
+// count the hit and give hit pages another round when the eviction hand
+// reaches them, so a hit writes to no other page. CLOCK-Pro protects pages
+// reused within a short distance as hot, and S3-FIFO lets new blocks into
+// its main queue only once reused. Both remember recently evicted blocks to
+// recognize early evictions. Hits are still found and counted under the
+// cache lock, so under every policy they are serialized: the choice changes
+// hit ratios, not how many threads can hit at once. Fails with EBUSY while
+// files are open. Setting VTPC_POLICY to a name selects one for a whole run.
+int vtpc_set_policy(const char* name);
+
+// Sets how often cached files are checked against the disk, by their size,
+// modification time and inode. A file is checked whenever vtpc_open finds
+// it cached, and on reads and writes once interval_ns has passed since its
+// last check unless that is zero, the default. The blocks of a file another
+// process changed are invalidated, after this process's dirty blocks are
+// written; a file another process renamed over the path is reopened.
+int vtpc_set_revalidate(uint64_t interval_ns);
+
+// Starts or stops watching cached files with inotify, which checks a file
+// as soon as another process writes it. Renames over a path are still only
+// noticed by the checks above. Stopping closes the inotify instance and
+// waits for the thread reading it to end.
+int vtpc_set_watch(bool watch);
+
+void vtpc_get_stats(struct vtpc_stats* stats);
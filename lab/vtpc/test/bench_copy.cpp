@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "exception.hpp"
+
+extern "C" {
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "copy.h"
+}
+
+namespace {
+
+constexpr size_t line = 64;
+constexpr size_t hot_bytes = 4U << 20U;
+constexpr size_t total_bytes = 256U << 20U;
+
+// Counts last-level cache misses of this thread, if the kernel lets us.
+class llc_misses {
+public:
+  llc_misses() {
+    perf_event_attr attr{};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+
+  llc_misses(const llc_misses&) = delete;
+  auto operator=(const llc_misses&) -> llc_misses& = delete;
+
+  ~llc_misses() {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  [[nodiscard]] auto available() const -> bool {
+    return fd_ >= 0;
+  }
+
+  auto start() -> void {
+    if (fd_ >= 0) {
+      ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+
+  auto stop() -> uint64_t {
+    uint64_t count = 0;
+    if (fd_ >= 0) {
+      ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(fd_, &count, sizeof(count)) != sizeof(count)) {
+        count = 0;
+      }
+    }
+    return count;
+  }
+
+private:
+  int fd_ = -1;
+};
+
+// Touches one byte per cache line of the caller's working set.
+auto scan(const std::vector<char>& hot) -> uint64_t {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < hot.size(); i += line) {
+    sum += static_cast<unsigned char>(hot[i]);
+  }
+  return sum;
+}
+
+struct result {
+  double gbps;
+  double scan_ns;
+  double misses;
+};
+
+// Copies size bytes over and over, rescanning a hot working set after each
+// copy: the rescan slows down and misses the LLC as far as the copy evicted
+// the working set.
+auto measure(vtpc_copy_fn* copy, size_t size, llc_misses& counter) -> result {
+  std::vector<char> src(size, 'a');
+  std::vector<char> dst(size, 'b');
+  std::vector<char> hot(hot_bytes, 'c');
+  const size_t rounds = std::clamp<size_t>(total_bytes / size, 16, 1024);
+
+  volatile uint64_t sink = scan(hot);
+  std::chrono::duration<double> copying{};
+  std::chrono::duration<double> scanning{};
+  uint64_t misses = 0;
+  for (size_t round = 0; round < rounds; ++round) {
+    const auto start = std::chrono::steady_clock::now();
+    copy(dst.data(), src.data(), size);
+    vtpc_copy_fence();
+    const auto copied = std::chrono::steady_clock::now();
+    counter.start();
+    sink = sink + scan(hot);
+    misses += counter.stop();
+    copying += copied - start;
+    scanning += std::chrono::steady_clock::now() - copied;
+  }
+
+  if (std::memcmp(dst.data(), src.data(), size) != 0) {
+    throw vt::exception() << "copy of " << size << " bytes differs";
+  }
+  const auto count = static_cast<double>(rounds);
+  return {
+      .gbps = count * static_cast<double>(size) / copying.count() / 1e9,
+      .scan_ns = scanning.count() * 1e9 / count /
+                 static_cast<double>(hot_bytes / line),
+      .misses = static_cast<double>(misses) / count,
+  };
+}
+
+}  // namespace
+
+auto main() -> int try {
+  llc_misses counter;
+  if (!counter.available()) {
+    std::cout << "LLC miss counter is not available, showing rescan time "
+                 "only\n";
+  }
+  std::cout << "hot set " << hot_bytes / 1024 << " KiB, stream threshold "
+            << VTPC_STREAM_COPY_BYTES / 1024 << " KiB\n";
+  std::cout << std::setw(10) << "size" << std::setw(8) << "kernel"
+            << std::setw(10) << "GB/s" << std::setw(16) << "rescan ns/line"
+            << std::setw(14) << "LLC misses" << '\n';
+
+  for (const size_t size : {4096UL, 65536UL, 1UL << 20U, 16UL << 20U,
+                            64UL << 20U}) {
+    for (const char* name : {"memcpy", "sse2", "avx2", "avx512"}) {
+      vtpc_copy_fn* copy = vtpc_copy_kernel(name);
+      if (copy == nullptr) {
+        continue;
+      }
+      const result r = measure(copy, size, counter);
+      std::cout << std::setw(10) << size << std::setw(8) << name << std::fixed
+                << std::setprecision(2) << std::setw(10) << r.gbps
+                << std::setw(16) << r.scan_ns << std::setprecision(0)
+                << std::setw(14);
+      if (counter.available()) {
+        std::cout << r.misses;
+      } else {
+        std::cout << "-";
+      }
+      std::cout << '\n';
+    }
+  }
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
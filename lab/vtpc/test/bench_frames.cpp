@@ -0,0 +1,129 @@
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "exception.hpp"
+
+extern "C" {
+#include "frame.h"
+}
+
+namespace {
+
+constexpr uint32_t frames_count = 1U << 14U;
+constexpr size_t hold = 4;
+constexpr size_t rounds = 1U << 16U;
+
+// The single global free list that magazines replace.
+class locked_list {
+public:
+  explicit locked_list(uint32_t count) {
+    for (uint32_t frame = 0; frame < count; ++frame) {
+      free_.push_back(frame);
+    }
+  }
+
+  auto alloc() -> int64_t {
+    const std::lock_guard lock(mutex_);
+    if (free_.empty()) {
+      return -1;
+    }
+    const uint32_t frame = free_.back();
+    free_.pop_back();
+    return frame;
+  }
+
+  auto free(uint32_t frame) -> void {
+    const std::lock_guard lock(mutex_);
+    free_.push_back(frame);
+  }
+
+private:
+  std::mutex mutex_;
+  std::vector<uint32_t> free_;
+};
+
+class magazines {
+public:
+  explicit magazines(uint32_t count) : frames_(vtpc_frames_create(count)) {
+    if (frames_ == nullptr) {
+      throw vt::exception() << "vtpc_frames_create failed";
+    }
+  }
+
+  magazines(const magazines&) = delete;
+  auto operator=(const magazines&) -> magazines& = delete;
+
+  ~magazines() {
+    vtpc_frames_destroy(frames_);
+  }
+
+  auto alloc() -> int64_t {
+    return vtpc_frames_alloc(frames_);
+  }
+
+  auto free(uint32_t frame) -> void {
+    vtpc_frames_free(frames_, frame);
+  }
+
+private:
+  vtpc_frames* frames_;
+};
+
+// Returns allocations plus frees per second with every thread repeatedly
+// taking a few frames and giving them back.
+template <class Allocator>
+auto measure(size_t threads) -> double {
+  Allocator allocator(frames_count);
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  workers.reserve(threads);
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&allocator] {
+      std::array<int64_t, hold> held{};
+      for (size_t i = 0; i < rounds; ++i) {
+        for (int64_t& frame : held) {
+          frame = allocator.alloc();
+        }
+        for (const int64_t frame : held) {
+          if (frame >= 0) {
+            allocator.free(static_cast<uint32_t>(frame));
+          }
+        }
+      }
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  return static_cast<double>(2 * hold * rounds * threads) / elapsed.count();
+}
+
+}  // namespace
+
+auto main() -> int try {
+  std::cout << std::setw(8) << "threads" << std::setw(16) << "magazine Mop/s"
+            << std::setw(16) << "locked Mop/s" << '\n';
+  for (size_t threads = 1; threads <= 64; threads *= 2) {
+    const double magazine = measure<magazines>(threads);
+    const double locked = measure<locked_list>(threads);
+    std::cout << std::setw(8) << threads << std::fixed << std::setprecision(1)
+              << std::setw(16) << magazine / 1e6 << std::setw(16)
+              << locked / 1e6 << '\n';
+  }
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
@@ -0,0 +1,144 @@
+#include <sys/types.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "exception.hpp"
+#include "vtpc_file.hpp"
+#include "workload.hpp"
+
+extern "C" {
+#include <unistd.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+constexpr size_t page = 4096;
+constexpr size_t file_pages = 2048;
+constexpr size_t hot_pages = 128;
+constexpr size_t accesses = 200000;
+constexpr size_t hits_per_thread = 200000;
+constexpr double skew = 0.99;
+
+const char* const policies[] = {"lru", "clock-pro", "s3-fifo"};
+
+auto read_page(int fd, std::string& buffer, off_t offset) -> void {
+  if (vtpc_lseek(fd, offset, SEEK_SET) != offset ||
+      vtpc_read(fd, buffer.data(), page) != static_cast<ssize_t>(page)) {
+    throw vt::exception() << "failed to read at " << offset;
+  }
+}
+
+auto read_all(int fd, const vt::workload::stream& accesses) -> void {
+  std::string buffer(page, 0);
+  for (const vt::workload::access& access : accesses) {
+    read_page(fd, buffer, access.offset);
+  }
+}
+
+// Returns the hit ratio of a zipf workload over the file, which is eight
+// times the cache, with a full sequential scan every scan_every accesses
+// if that is nonzero.
+auto hit_ratio(const char* policy, size_t scan_every) -> double {
+  if (vtpc_set_policy(policy) != 0) {
+    throw vt::exception() << "failed to select " << policy;
+  }
+  const vt::workload::shape shape{.blocks = file_pages, .block_size = page};
+  vt::workload::stream pages = vt::workload::zipfian(shape, accesses, skew);
+  if (scan_every != 0) {
+    pages = vt::workload::interleave(
+        pages, vt::workload::sequential(shape, file_pages), scan_every
+    );
+  }
+
+  const int fd = vt::open_random("/tmp/policy");
+  const vtpc_stats before = vt::stats();
+  read_all(fd, pages);
+  const vtpc_stats after = vt::stats();
+  vtpc_close(fd);
+
+  const auto hits = static_cast<double>(after.hits - before.hits);
+  const auto misses = static_cast<double>(after.misses - before.misses);
+  return hits / (hits + misses);
+}
+
+// Returns reads per second with every thread reading a working set that
+// fits in the cache, so that every read is a hit.
+auto hit_throughput(const char* policy, size_t threads) -> double {
+  if (vtpc_set_policy(policy) != 0) {
+    throw vt::exception() << "failed to select " << policy;
+  }
+  const vt::workload::shape hot{.blocks = hot_pages, .block_size = page};
+  std::vector<vt::workload::stream> streams;
+  for (size_t t = 0; t < threads; ++t) {
+    vt::workload::shape shape = hot;
+    shape.seed = t + 1;
+    streams.push_back(vt::workload::zipfian(shape, hits_per_thread, skew));
+  }
+  const int warm = vt::open_random("/tmp/policy");
+  read_all(warm, vt::workload::sequential(hot, hot_pages));
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  workers.reserve(threads);
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&streams, t] {
+      const int fd = vt::open_random("/tmp/policy");
+      read_all(fd, streams[t]);
+      vtpc_close(fd);
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  vtpc_close(warm);
+
+  return static_cast<double>(hits_per_thread * threads) / elapsed.count();
+}
+
+}  // namespace
+
+auto main() -> int try {
+  vt::create("/tmp/policy", file_pages * page);
+
+  std::cout << "hit ratio, " << file_pages << " pages, zipf " << skew << '\n';
+  std::cout << std::setw(12) << "policy" << std::setw(10) << "zipf"
+            << std::setw(14) << "zipf+scan" << '\n';
+  for (const char* policy : policies) {
+    const double plain = hit_ratio(policy, 0);
+    const double scanned = hit_ratio(policy, accesses / 8);
+    std::cout << std::setw(12) << policy << std::fixed << std::setprecision(4)
+              << std::setw(10) << plain << std::setw(14) << scanned << '\n';
+  }
+
+  std::cout << "\nhit throughput, " << hot_pages << " cached pages, Mop/s\n";
+  std::cout << std::setw(8) << "threads";
+  for (const char* policy : policies) {
+    std::cout << std::setw(12) << policy;
+  }
+  std::cout << '\n';
+  for (size_t threads = 1; threads <= 16; threads *= 2) {
+    std::cout << std::setw(8) << threads;
+    for (const char* policy : policies) {
+      const double rate = hit_throughput(policy, threads);
+      std::cout << std::fixed << std::setprecision(2) << std::setw(12)
+                << rate / 1e6;
+    }
+    std::cout << '\n';
+  }
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
@@ -0,0 +1,287 @@
+#include <sys/types.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "exception.hpp"
+#include "file.hpp"
+#include "histogram.hpp"
+#include "timed_file.hpp"
+#include "workload.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+}
+
+namespace {
+
+constexpr const char* path = "/tmp/bench_vtpc";
+constexpr size_t stream_ops = 1 << 20;
+constexpr size_t scans_per_stream = 8;
+constexpr size_t alignment = 4096;
+constexpr double skew = 0.99;
+constexpr size_t stride = 16;
+
+const char* const usage =
+    "usage: bench_vtpc [--file-size=BYTES] [--block-size=BYTES]\n"
+    "                  [--duration=SECONDS] [--write-percent=PERCENT]\n"
+    "                  [--workloads=seq,uniform,zipf,hotspot,strided,scan]\n"
+    "                  [--backends=libc,direct,vtpc] [--per-op]\n"
+    "Sizes take a k, m or g suffix. --per-op prints the latency of each\n"
+    "kind of call after each run.\n";
+
+struct options {
+  size_t file_size = 64 << 20;
+  size_t block_size = 4096;
+  double duration = 2;
+  size_t write_percent = 30;
+  std::vector<std::string> workloads = {
+      "seq", "uniform", "zipf", "hotspot", "strided", "scan"
+  };
+  std::vector<std::string> backends = {"libc", "direct", "vtpc"};
+  bool per_op = false;
+};
+
+struct result {
+  size_t ops;
+  double seconds;
+  uint64_t p50;
+  uint64_t p99;
+  uint64_t p999;
+};
+
+auto parse_size(std::string_view text) -> size_t {
+  size_t shift = 0;
+  if (!text.empty()) {
+    switch (text.back()) {
+      case 'k':
+        shift = 10;
+        break;
+      case 'm':
+        shift = 20;
+        break;
+      case 'g':
+        shift = 30;
+        break;
+      default:
+        break;
+    }
+  }
+  if (shift != 0) {
+    text.remove_suffix(1);
+  }
+  return std::stoull(std::string(text)) << shift;
+}
+
+auto split(std::string_view text) -> std::vector<std::string> {
+  std::vector<std::string> items;
+  while (!text.empty()) {
+    const size_t comma = std::min(text.find(','), text.size());
+    items.emplace_back(text.substr(0, comma));
+    text.remove_prefix(std::min(comma + 1, text.size()));
+  }
+  return items;
+}
+
+auto parse(int argc, char** argv) -> options {
+  options options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];  // NOLINT
+    const size_t equals = arg.find('=');
+    const std::string_view name = arg.substr(0, equals);
+    const std::string_view value =
+        equals == std::string_view::npos ? "" : arg.substr(equals + 1);
+    if (name == "--file-size") {
+      options.file_size = parse_size(value);
+    } else if (name == "--block-size") {
+      options.block_size = parse_size(value);
+    } else if (name == "--duration") {
+      options.duration = std::stod(std::string(value));
+    } else if (name == "--write-percent") {
+      options.write_percent = std::stoull(std::string(value));
+    } else if (name == "--workloads") {
+      options.workloads = split(value);
+    } else if (name == "--backends") {
+      options.backends = split(value);
+    } else if (arg == "--per-op") {
+      options.per_op = true;
+    } else {
+      throw vt::exception() << usage;
+    }
+  }
+  // O_DIRECT needs aligned blocks, and the file must hold at least one.
+  if (options.block_size == 0 || options.block_size % alignment != 0 ||
+      options.file_size < options.block_size || options.write_percent > 100) {
+    throw vt::exception() << usage;
+  }
+  return options;
+}
+
+// Builds the workload's accesses ahead of the run, so that drawing them
+// costs nothing while it is timed. "scan" is "zipf" with a sequential pass
+// over the whole file every so often.
+auto generate(const std::string& workload, const options& options)
+    -> vt::workload::stream {
+  const vt::workload::shape shape{
+      .blocks = options.file_size / options.block_size,
+      .block_size = options.block_size,
+      .write_ratio = static_cast<double>(options.write_percent) / 100,
+  };
+  if (workload == "seq") {
+    return vt::workload::sequential(shape, stream_ops);
+  }
+  if (workload == "uniform") {
+    return vt::workload::uniform(shape, stream_ops);
+  }
+  if (workload == "zipf") {
+    return vt::workload::zipfian(shape, stream_ops, skew);
+  }
+  if (workload == "hotspot") {
+    return vt::workload::hotspot(shape, stream_ops, 0.1, 0.9);
+  }
+  if (workload == "strided") {
+    return vt::workload::strided(shape, stream_ops, stride);
+  }
+  if (workload == "scan") {
+    vt::workload::shape scan = shape;
+    scan.write_ratio = 0;
+    return vt::workload::interleave(
+        vt::workload::zipfian(shape, stream_ops, skew),
+        vt::workload::sequential(scan, shape.blocks),
+        stream_ops / scans_per_stream
+    );
+  }
+  throw vt::exception() << "unknown workload " << workload;
+}
+
+auto open(const std::string& backend) -> std::unique_ptr<vt::file> {
+  if (backend == "libc") {
+    return vt::file::open_libc(path);
+  }
+  if (backend == "direct") {
+    return vt::file::open_direct(path);
+  }
+  if (backend == "vtpc") {
+    return vt::file::open_vtpc(path);
+  }
+  throw vt::exception() << "unknown backend " << backend;
+}
+
+auto create(size_t size) -> void {
+  const std::string chunk(1 << 20, 'x');
+  const int raw = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  for (size_t done = 0; raw >= 0 && done < size; done += chunk.size()) {
+    const size_t count = std::min(chunk.size(), size - done);
+    if (write(raw, chunk.data(), count) != static_cast<ssize_t>(count)) {
+      close(raw);
+      throw vt::exception() << "failed to create " << path;
+    }
+  }
+  if (raw < 0 || close(raw) != 0) {
+    throw vt::exception() << "failed to create " << path;
+  }
+}
+
+// Replays the operations in a loop until the duration is up, timing each,
+// and syncs the file at the end within the run.
+auto run(
+    vt::file& file, const vt::workload::stream& ops, const options& options
+) -> result {
+  using clock = std::chrono::steady_clock;
+  const std::unique_ptr<char, decltype(&std::free)> buffer(
+      static_cast<char*>(std::aligned_alloc(alignment, options.block_size)),
+      &std::free
+  );
+  std::fill_n(buffer.get(), options.block_size, 'y');
+
+  vt::histogram latencies;
+  size_t count = 0;
+  const clock::time_point start = clock::now();
+  const clock::time_point deadline =
+      start + std::chrono::duration_cast<clock::duration>(
+                  std::chrono::duration<double>(options.duration)
+              );
+  clock::time_point now = start;
+  for (; now < deadline; ++count) {
+    const vt::workload::access& next = ops[count % ops.size()];
+    file.seek(next.offset);
+    if (next.write) {
+      file.write(buffer.get(), next.size);
+    } else {
+      file.read(buffer.get(), next.size);
+    }
+    const clock::time_point done = clock::now();
+    latencies.record(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(done - now)
+            .count()
+    );
+    now = done;
+  }
+  file.sync();
+  const std::chrono::duration<double> elapsed = clock::now() - start;
+
+  return {
+      .ops = count,
+      .seconds = elapsed.count(),
+      .p50 = latencies.percentile(0.5),
+      .p99 = latencies.percentile(0.99),
+      .p999 = latencies.percentile(0.999),
+  };
+}
+
+}  // namespace
+
+auto main(int argc, char** argv) -> int try {
+  const options options = parse(argc, argv);
+  create(options.file_size);
+
+  std::cout << "file " << (options.file_size >> 20U) << " MiB, block "
+            << options.block_size << " B, " << options.write_percent
+            << "% writes, " << options.duration << " s per run\n";
+  std::cout << std::setw(10) << "workload" << std::setw(8) << "backend"
+            << std::setw(12) << "ops/s" << std::setw(10) << "MB/s"
+            << std::setw(10) << "p50 us" << std::setw(10) << "p99 us"
+            << std::setw(10) << "p999 us" << '\n';
+  for (const std::string& workload : options.workloads) {
+    const vt::workload::stream ops = generate(workload, options);
+    for (const std::string& backend : options.backends) {
+      std::unique_ptr<vt::timed_file> timed;
+      const result result = [&] {
+        std::unique_ptr<vt::file> file = open(backend);
+        if (options.per_op) {
+          timed = std::make_unique<vt::timed_file>(std::move(file));
+          return run(*timed, ops, options);
+        }
+        return run(*file, ops, options);
+      }();
+      const double rate = static_cast<double>(result.ops) / result.seconds;
+      std::cout << std::setw(10) << workload << std::setw(8) << backend
+                << std::fixed << std::setprecision(0) << std::setw(12) << rate
+                << std::setprecision(1) << std::setw(10)
+                << rate * static_cast<double>(options.block_size) / 1e6
+                << std::setprecision(2) << std::setw(10)
+                << static_cast<double>(result.p50) / 1e3 << std::setw(10)
+                << static_cast<double>(result.p99) / 1e3 << std::setw(10)
+                << static_cast<double>(result.p999) / 1e3 << '\n';
+      if (timed) {
+        timed->print(std::cout);
+      }
+    }
+  }
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
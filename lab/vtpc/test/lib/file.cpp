@@ -124,6 +124,21 @@ auto file::open_libc(std::string_view path) -> std::unique_ptr<file> {
   return std::make_unique<io_file>(path, std::move(io));
 }
 
+auto file::open_direct(std::string_view path) -> std::unique_ptr<file> {
+  io io = {
+      .open = [](const char* path, int mode, int access) {
+        return ::open(path, mode | O_DIRECT, access);
+      },
+      .close = ::close,
+      .read = ::read,
+      .write = ::write,
+      .lseek = ::lseek,
+      .fsync = ::fsync,
+  };
+
+  return std::make_unique<io_file>(path, std::move(io));
+}
+
 auto file::open_vtpc(std::string_view path) -> std::unique_ptr<file> {
   io io = {
       .open = ::vtpc_open,
@@ -40,6 +40,9 @@ public:
   }
 
   static auto open_libc(std::string_view path) -> std::unique_ptr<file>;
+  // libc with O_DIRECT, bypassing the kernel page cache: buffers, sizes and
+  // offsets must be aligned to the logical block size of the device.
+  static auto open_direct(std::string_view path) -> std::unique_ptr<file>;
   static auto open_vtpc(std::string_view path) -> std::unique_ptr<file>;
 };
 
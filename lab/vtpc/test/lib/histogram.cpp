@@ -0,0 +1,83 @@
+#include "histogram.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace vt {
+
+auto histogram::count() const -> uint64_t {
+  uint64_t count = 0;
+  for (const auto& bucket : buckets_) {
+    count += bucket.load(std::memory_order_relaxed);
+  }
+  return count;
+}
+
+auto histogram::mean() const -> double {
+  uint64_t count = 0;
+  double sum = 0;
+  for (size_t i = 0; i < nbuckets; ++i) {
+    const uint64_t n = buckets_[i].load(std::memory_order_relaxed);
+    const double mid =
+        (static_cast<double>(lowest(i)) + static_cast<double>(highest(i))) / 2;
+    count += n;
+    sum += static_cast<double>(n) * mid;
+  }
+  return count == 0 ? 0 : sum / static_cast<double>(count);
+}
+
+auto histogram::max() const -> uint64_t {
+  for (size_t i = nbuckets; i > 0; --i) {
+    if (buckets_[i - 1].load(std::memory_order_relaxed) != 0) {
+      return highest(i - 1);
+    }
+  }
+  return 0;
+}
+
+auto histogram::percentile(double p) const -> uint64_t {
+  const uint64_t n = count();
+  if (n == 0) {
+    return 0;
+  }
+  const auto rank = std::max<uint64_t>(
+      1, static_cast<uint64_t>(std::ceil(p * static_cast<double>(n)))
+  );
+  // Values recorded since the count was taken may move the rank along, and
+  // the last bucket stands in for them.
+  uint64_t seen = 0;
+  for (size_t i = 0; i < nbuckets; ++i) {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      return highest(i);
+    }
+  }
+  return max();
+}
+
+auto histogram::reset() -> void {
+  for (auto& bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+auto histogram::lowest(size_t index) -> uint64_t {
+  if (index < 2 * sub_buckets) {
+    return index;
+  }
+  const size_t shift = (index >> sub_bits) - 1;
+  return ((index & (sub_buckets - 1)) + sub_buckets) << shift;
+}
+
+auto histogram::highest(size_t index) -> uint64_t {
+  if (index < 2 * sub_buckets) {
+    return index;
+  }
+  const size_t shift = (index >> sub_bits) - 1;
+  return lowest(index) + ((uint64_t{1} << shift) - 1);
+}
+
+}  // namespace vt
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace vt {
+
+// A log-linear histogram of latencies in nanoseconds, as in HdrHistogram.
+// Values below 2^(sub_bits + 1) get a bucket each, and every power of two
+// above is split into 2^sub_bits buckets, so no bucket is wider than 1/32
+// of the values it holds. Recording is one relaxed atomic add and may race
+// with other recorders and readers; readers see each value counted or not
+// yet. Statistics are read off the buckets, to their precision.
+class histogram {
+public:
+  static constexpr unsigned sub_bits = 5;
+
+  auto record(uint64_t value) -> void {
+    buckets_[index(value)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] auto count() const -> uint64_t;
+  // The mean of the midpoints of the buckets.
+  [[nodiscard]] auto mean() const -> double;
+  [[nodiscard]] auto max() const -> uint64_t;
+  // The highest value of the bucket holding the given fraction of values,
+  // or 0 if there are none.
+  [[nodiscard]] auto percentile(double p) const -> uint64_t;
+
+  auto reset() -> void;
+
+private:
+  static constexpr size_t sub_buckets = size_t{1} << sub_bits;
+  static constexpr size_t nbuckets = (65 - sub_bits) << sub_bits;
+
+  static constexpr auto index(uint64_t value) -> size_t {
+    const unsigned width = 64 - __builtin_clzll(value | 1);
+    if (width <= sub_bits + 1) {
+      return value;
+    }
+    const unsigned shift = width - sub_bits - 1;
+    return (size_t{shift} << sub_bits) + (value >> shift);
+  }
+
+  static auto lowest(size_t index) -> uint64_t;
+  static auto highest(size_t index) -> uint64_t;
+
+  std::array<std::atomic<uint64_t>, nbuckets> buckets_{};
+};
+
+}  // namespace vt
@@ -0,0 +1,47 @@
+#include "memory_file.hpp"
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "file.hpp"
+
+namespace vt {
+
+memory_file::memory_file(std::shared_ptr<std::string> data)
+    : data_(std::move(data)) {
+}
+
+auto memory_file::read(char* buffer, size_t count) -> void {
+  if (pos_ > data_->size() || count > data_->size() - pos_) {
+    throw vt::file_exception(0)
+        << "failed to read " << count << " bytes at " << pos_
+        << " from memory: EOF";
+  }
+  std::memcpy(buffer, data_->data() + pos_, count);
+  pos_ += count;
+}
+
+auto memory_file::write(const char* buffer, size_t count) -> void {
+  if (pos_ + count > data_->size()) {
+    data_->resize(pos_ + count);
+  }
+  std::memcpy(data_->data() + pos_, buffer, count);
+  pos_ += count;
+}
+
+auto memory_file::seek(off_t offset) -> void {
+  if (offset < 0) {
+    throw vt::file_exception(-1) << "failed to seek to offset " << offset;
+  }
+  pos_ = static_cast<size_t>(offset);
+}
+
+auto memory_file::sync() -> void {
+}
+
+}  // namespace vt
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "file.hpp"
+
+namespace vt {
+
+// A file held in a string, as the model a real file is checked against.
+// Files made over one string share its contents but each has a position of
+// its own, like descriptors of one file. Accesses to disjoint bytes may run
+// concurrently as long as no write grows the string.
+class memory_file final : public file {
+public:
+  using file::read;
+  using file::write;
+
+  explicit memory_file(std::shared_ptr<std::string> data);
+  ~memory_file() override = default;
+
+  auto read(char* buffer, size_t count) -> void override;
+  auto write(const char* buffer, size_t count) -> void override;
+  auto seek(off_t offset) -> void override;
+  auto sync() -> void override;
+
+private:
+  std::shared_ptr<std::string> data_;
+  size_t pos_ = 0;
+};
+
+}  // namespace vt
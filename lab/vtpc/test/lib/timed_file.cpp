@@ -0,0 +1,121 @@
+#include "timed_file.hpp"
+
+#include <sys/types.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <ios>
+#include <memory>
+#include <ostream>
+#include <utility>
+
+#include "file.hpp"
+#include "histogram.hpp"
+
+namespace vt {
+
+namespace {
+
+// Records the time from its construction to its destruction, so that calls
+// which throw are timed too.
+class timer {
+public:
+  explicit timer(histogram& histogram)
+      : histogram_(histogram), start_(std::chrono::steady_clock::now()) {
+  }
+
+  timer(const timer&) = delete;
+  auto operator=(const timer&) -> timer& = delete;
+
+  ~timer() {
+    const auto elapsed = std::chrono::steady_clock::now() - start_;
+    histogram_.record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()
+    ));
+  }
+
+private:
+  histogram& histogram_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+enum op : size_t { op_read, op_write, op_seek, op_sync, ops };
+
+// Calls of each kind this thread made on any timed file since it last
+// timed one. Counting them per thread keeps atomics off the untimed path.
+thread_local std::array<uint64_t, ops> untimed{};
+
+// Makes the call, timing it if it is the every-th of its kind.
+template <typename Call>
+auto sample(op op, uint64_t every, histogram& histogram, const Call& call)
+    -> void {
+  if (++untimed[op] < every) {
+    call();
+    return;
+  }
+  untimed[op] = 0;
+  const timer timer(histogram);
+  call();
+}
+
+}  // namespace
+
+timed_file::timed_file(std::unique_ptr<file> file, uint64_t every)
+    : file_(std::move(file)), every_(std::max<uint64_t>(every, 1)) {
+}
+
+auto timed_file::read(char* buffer, size_t count) -> void {
+  sample(op_read, every_, reads_, [&] { file_->read(buffer, count); });
+}
+
+auto timed_file::write(const char* buffer, size_t count) -> void {
+  sample(op_write, every_, writes_, [&] { file_->write(buffer, count); });
+}
+
+auto timed_file::seek(off_t offset) -> void {
+  sample(op_seek, every_, seeks_, [&] { file_->seek(offset); });
+}
+
+auto timed_file::sync() -> void {
+  sample(op_sync, every_, syncs_, [&] { file_->sync(); });
+}
+
+auto timed_file::print(std::ostream& out) const -> void {
+  const std::ios_base::fmtflags flags = out.flags();
+  const std::streamsize precision = out.precision();
+  out << std::setw(8) << "op" << std::setw(12) << "count" << std::setw(10)
+      << "mean us" << std::setw(10) << "p50 us" << std::setw(10) << "p90 us"
+      << std::setw(10) << "p99 us" << std::setw(10) << "p999 us"
+      << std::setw(10) << "max us" << '\n';
+  const std::pair<const char*, const histogram*> rows[] = {
+      {"read", &reads_},
+      {"write", &writes_},
+      {"seek", &seeks_},
+      {"sync", &syncs_},
+  };
+  const auto us = [](uint64_t ns) { return static_cast<double>(ns) / 1e3; };
+  out << std::fixed << std::setprecision(2);
+  for (const auto& [name, histogram] : rows) {
+    if (histogram->count() == 0) {
+      continue;
+    }
+    out << std::setw(8) << name << std::setw(12) << histogram->count()
+        << std::setw(10) << histogram->mean() / 1e3 << std::setw(10)
+        << us(histogram->percentile(0.5)) << std::setw(10)
+        << us(histogram->percentile(0.9)) << std::setw(10)
+        << us(histogram->percentile(0.99)) << std::setw(10)
+        << us(histogram->percentile(0.999)) << std::setw(10)
+        << us(histogram->max()) << '\n';
+  }
+  if (every_ > 1) {
+    out << "one call in " << every_ << " of each kind timed\n";
+  }
+  out.flags(flags);
+  out.precision(precision);
+}
+
+}  // namespace vt
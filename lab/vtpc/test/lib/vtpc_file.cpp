@@ -0,0 +1,51 @@
+#include "vtpc_file.hpp"
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <string>
+
+#include "exception.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "vtpc.h"
+}
+
+namespace vt {
+
+auto stats() -> vtpc_stats {
+  vtpc_stats stats{};
+  vtpc_get_stats(&stats);
+  return stats;
+}
+
+auto open_or_throw(const char* path, int mode, int access) -> int {
+  const int fd = vtpc_open(path, mode, access);
+  if (fd < 0) {
+    throw vt::exception() << "failed to open " << path;
+  }
+  return fd;
+}
+
+auto open_random(const char* path, int mode) -> int {
+  const int fd = open_or_throw(path, mode);
+  if (vtpc_fadvise(fd, 0, 0, POSIX_FADV_RANDOM) != 0) {
+    throw vt::exception() << "failed to advise " << path;
+  }
+  return fd;
+}
+
+auto create(const char* path, size_t size) -> void {
+  const std::string content(size, 'x');
+  const int raw = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (raw < 0 || write(raw, content.data(), content.size()) !=
+                     static_cast<ssize_t>(content.size())) {
+    throw vt::exception() << "failed to create " << path;
+  }
+  close(raw);
+}
+
+}  // namespace vt
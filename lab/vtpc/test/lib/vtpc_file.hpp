@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+
+extern "C" {
+#include <fcntl.h>
+
+#include "vtpc.h"
+}
+
+// Helpers for tests that call the vtpc interface directly rather than
+// through vt::file.
+namespace vt {
+
+// The counters of the cache as of the call.
+auto stats() -> vtpc_stats;
+
+// Opens path through the cache, throwing if that fails.
+auto open_or_throw(const char* path, int mode, int access = 0644) -> int;
+
+// Opens path through the cache for random access, so that reads bring in
+// only the pages asked for and hit ratios reflect the policy alone.
+auto open_random(const char* path, int mode = O_RDONLY) -> int;
+
+// Writes a file of size bytes of 'x' around the cache.
+auto create(const char* path, size_t size) -> void;
+
+}  // namespace vt
@@ -0,0 +1,258 @@
+#include "workload.hpp"
+
+#include <sys/types.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "exception.hpp"
+
+// trace.h declares C11 atomics, which C++23 has in <stdatomic.h>, and which
+// must be declared outside the extern "C" block.
+#include <stdatomic.h>
+
+extern "C" {
+#include "trace.h"
+}
+
+namespace vt::workload {
+
+namespace {
+
+// Turns block numbers into accesses, drawing which of them write.
+class builder {
+public:
+  explicit builder(const shape& shape)
+      : shape_(shape), random_(shape.seed), writes_(shape.write_ratio) {
+    if (shape.blocks == 0 || shape.block_size == 0) {
+      throw vt::exception() << "a workload needs a file of at least a block";
+    }
+  }
+
+  auto random() -> std::mt19937_64& {
+    return random_;
+  }
+
+  auto add(size_t block) -> void {
+    stream_.push_back({
+        .offset = static_cast<off_t>(block * shape_.block_size),
+        .size = shape_.block_size,
+        .write = writes_(random_),
+    });
+  }
+
+  auto take() -> stream {
+    return std::move(stream_);
+  }
+
+private:
+  shape shape_;
+  std::mt19937_64 random_;
+  std::bernoulli_distribution writes_;
+  stream stream_;
+};
+
+// A multiplier that permutes [0, n), to spread ranks over the file.
+auto spreader(size_t n) -> size_t {
+  constexpr size_t prime = 7919;
+  return std::gcd(prime, n) == 1 ? prime : 1;
+}
+
+}  // namespace
+
+auto sequential(const shape& shape, size_t count) -> stream {
+  builder out(shape);
+  for (size_t i = 0; i < count; ++i) {
+    out.add(i % shape.blocks);
+  }
+  return out.take();
+}
+
+auto uniform(const shape& shape, size_t count) -> stream {
+  builder out(shape);
+  std::uniform_int_distribution<size_t> blocks(0, shape.blocks - 1);
+  for (size_t i = 0; i < count; ++i) {
+    out.add(blocks(out.random()));
+  }
+  return out.take();
+}
+
+auto shuffled(const shape& shape, size_t count) -> stream {
+  builder out(shape);
+  std::vector<size_t> order(shape.blocks);
+  std::iota(order.begin(), order.end(), 0);
+  for (size_t i = 0; i < count; ++i) {
+    if (i % shape.blocks == 0) {
+      std::shuffle(order.begin(), order.end(), out.random());
+    }
+    out.add(order[i % shape.blocks]);
+  }
+  return out.take();
+}
+
+auto zipfian(const shape& shape, size_t count, double theta) -> stream {
+  builder out(shape);
+  std::vector<double> cdf(shape.blocks);
+  double sum = 0;
+  for (size_t i = 0; i < shape.blocks; ++i) {
+    sum += 1 / std::pow(static_cast<double>(i + 1), theta);
+    cdf[i] = sum;
+  }
+
+  const size_t spread = spreader(shape.blocks);
+  std::uniform_real_distribution<double> uniform(0, sum);
+  for (size_t i = 0; i < count; ++i) {
+    const auto rank = static_cast<size_t>(
+        std::lower_bound(cdf.begin(), cdf.end(), uniform(out.random())) -
+        cdf.begin()
+    );
+    out.add((std::min(rank, shape.blocks - 1) * spread) % shape.blocks);
+  }
+  return out.take();
+}
+
+auto hotspot(
+    const shape& shape, size_t count, double hot_blocks, double hot_accesses
+) -> stream {
+  builder out(shape);
+  const auto hot = std::clamp<size_t>(
+      static_cast<size_t>(hot_blocks * static_cast<double>(shape.blocks)),
+      1,
+      shape.blocks
+  );
+  std::bernoulli_distribution in_hot(hot_accesses);
+  std::uniform_int_distribution<size_t> hot_block(0, hot - 1);
+  std::uniform_int_distribution<size_t> cold_block(
+      hot == shape.blocks ? 0 : hot, shape.blocks - 1
+  );
+  for (size_t i = 0; i < count; ++i) {
+    const bool pick_hot = in_hot(out.random());
+    out.add(pick_hot ? hot_block(out.random()) : cold_block(out.random()));
+  }
+  return out.take();
+}
+
+auto strided(const shape& shape, size_t count, size_t stride) -> stream {
+  builder out(shape);
+  stride = std::max<size_t>(stride, 1);
+  size_t column = 0;
+  size_t block = 0;
+  for (size_t i = 0; i < count; ++i) {
+    out.add(block);
+    block += stride;
+    if (block >= shape.blocks) {
+      column = (column + 1) % std::min(stride, shape.blocks);
+      block = column;
+    }
+  }
+  return out.take();
+}
+
+auto mix(
+    const std::vector<std::pair<double, stream>>& parts,
+    size_t count,
+    uint64_t seed
+) -> stream {
+  std::vector<double> weights;
+  for (const auto& [weight, part] : parts) {
+    if (part.empty()) {
+      throw vt::exception() << "cannot mix an empty stream";
+    }
+    weights.push_back(weight);
+  }
+  std::mt19937_64 random(seed);
+  std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+  std::vector<size_t> next(parts.size(), 0);
+
+  stream out;
+  out.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    const size_t p = pick(random);
+    const stream& part = parts[p].second;
+    out.push_back(part[next[p]]);
+    next[p] = (next[p] + 1) % part.size();
+  }
+  return out;
+}
+
+auto interleave(const stream& base, const stream& inserted, size_t every)
+    -> stream {
+  stream out;
+  out.reserve(base.size() + ((base.size() / every + 1) * inserted.size()));
+  for (size_t i = 0; i < base.size(); ++i) {
+    if (i % every == 0) {
+      out.insert(out.end(), inserted.begin(), inserted.end());
+    }
+    out.push_back(base[i]);
+  }
+  return out;
+}
+
+auto replay(std::string_view path, std::optional<uint16_t> file) -> stream {
+  std::ifstream in{std::string(path), std::ios::binary};
+  if (!in) {
+    throw vt::exception() << "failed to open trace " << path;
+  }
+  const std::string data(std::istreambuf_iterator<char>(in), {});
+  vtpc_trace_header header{};
+  if (data.size() < sizeof(header)) {
+    throw vt::exception() << "failed to read trace " << path;
+  }
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (header.magic != VTPC_TRACE_MAGIC) {
+    throw vt::exception() << path << " is not a vtpc trace";
+  }
+
+  // Each chunk is in time order, and a thread's chunks in file order, so a
+  // stable sort by time merges the threads.
+  std::vector<vtpc_trace_event> events;
+  size_t offset = sizeof(header);
+  while (offset + sizeof(vtpc_trace_chunk) <= data.size()) {
+    vtpc_trace_chunk chunk{};
+    std::memcpy(&chunk, data.data() + offset, sizeof(chunk));
+    offset += sizeof(chunk);
+    const size_t bytes = chunk.count * sizeof(vtpc_trace_event);
+    if (offset + bytes > data.size()) {
+      break;
+    }
+    const size_t first = events.size();
+    events.resize(first + chunk.count);
+    std::memcpy(events.data() + first, data.data() + offset, bytes);
+    offset += bytes;
+  }
+  std::stable_sort(
+      events.begin(),
+      events.end(),
+      [](const vtpc_trace_event& a, const vtpc_trace_event& b) {
+        return a.time < b.time;
+      }
+  );
+
+  stream out;
+  out.reserve(events.size());
+  for (const vtpc_trace_event& event : events) {
+    if (file && event.file != *file) {
+      continue;
+    }
+    out.push_back({
+        .offset = static_cast<off_t>(event.page) * header.page_size,
+        .size = header.page_size,
+        .write = event.op == VTPC_TRACE_WRITE,
+    });
+  }
+  return out;
+}
+
+}  // namespace vt::workload
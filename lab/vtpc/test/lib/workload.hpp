@@ -0,0 +1,78 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Precomputed streams of block accesses, built before a run so that drawing
+// them stays out of timed sections. Generators draw block numbers over a
+// file of a given shape; the same seed gives the same stream.
+namespace vt::workload {
+
+struct access {
+  off_t offset;
+  size_t size;
+  bool write;
+};
+
+using stream = std::vector<access>;
+
+// A file of blocks of block_size bytes. Each access writes its block with
+// probability write_ratio and reads it otherwise.
+struct shape {
+  size_t blocks;
+  size_t block_size;
+  double write_ratio = 0;
+  uint64_t seed = 1;
+};
+
+// Blocks 0, 1, 2, ... wrapping around at the end of the file.
+auto sequential(const shape& shape, size_t count) -> stream;
+
+// Every block equally likely.
+auto uniform(const shape& shape, size_t count) -> stream;
+
+// Every block once in a random order, then again in another, as a walk of
+// linked records scattered over the file.
+auto shuffled(const shape& shape, size_t count) -> stream;
+
+// Block ranks drawn with probability proportional to 1 / (rank + 1)^theta,
+// theta > 0, and spread over the file so that popular blocks are not
+// neighbours.
+auto zipfian(const shape& shape, size_t count, double theta) -> stream;
+
+// A fraction hot_blocks of the file, at its start, taking a fraction
+// hot_accesses of the accesses, uniform within and outside it.
+auto hotspot(
+    const shape& shape, size_t count, double hot_blocks, double hot_accesses
+) -> stream;
+
+// Every stride-th block, starting over one block further each time the end
+// of the file is passed, as a column-wise scan of a row-major table.
+auto strided(const shape& shape, size_t count, size_t stride) -> stream;
+
+// Draws each access from one of the streams, picked by weight, taking the
+// accesses of each stream in order and starting it over when done.
+auto mix(
+    const std::vector<std::pair<double, stream>>& parts,
+    size_t count,
+    uint64_t seed = 1
+) -> stream;
+
+// The base stream with all of inserted spliced in before every every-th
+// access, such as a full scan now and then in a skewed workload.
+auto interleave(const stream& base, const stream& inserted, size_t every)
+    -> stream;
+
+// The accesses of a trace vtpc recorded with VTPC_TRACE, of all threads in
+// time order, restricted to one file if given. Accesses are of a page of
+// the trace's page size each; faults count as reads.
+auto replay(std::string_view path, std::optional<uint16_t> file = std::nullopt)
+    -> stream;
+
+}  // namespace vt::workload
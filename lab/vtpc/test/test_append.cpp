@@ -0,0 +1,128 @@
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "exception.hpp"
+#include "vtpc_file.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+constexpr const char* path = "/tmp/append";
+constexpr uint32_t writers = 4;
+constexpr uint32_t records = 5000;
+constexpr size_t small = 48;
+constexpr size_t large = 6000;
+
+struct header {
+  uint32_t size;
+  uint32_t writer;
+  uint32_t seq;
+};
+
+// Mostly small records, which the handle buffers, and every hundredth one
+// across several blocks. The body repeats a byte of the writer and seq.
+auto record(uint32_t writer, uint32_t seq) -> std::string {
+  const size_t size = seq % 100 == 99 ? large : small;
+  std::string data(size, static_cast<char>('a' + ((writer + seq) % 26)));
+  const header head{static_cast<uint32_t>(size), writer, seq};
+  std::memcpy(data.data(), &head, sizeof(head));
+  return data;
+}
+
+auto read_file() -> std::string {
+  const int raw = open(path, O_RDONLY);
+  std::string content;
+  char buffer[1 << 16];
+  ssize_t size = 0;
+  while (raw >= 0 && (size = read(raw, buffer, sizeof(buffer))) > 0) {
+    content.append(buffer, static_cast<size_t>(size));
+  }
+  close(raw);
+  return content;
+}
+
+}  // namespace
+
+auto main() -> int try {
+  const int init = vtpc_open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (init < 0 || vtpc_close(init) != 0) {
+    throw vt::exception() << "failed to create " << path;
+  }
+
+  // Appends from several handles interleave whole, in each writer's order,
+  // however far back a handle was seeked.
+  const uint64_t combined = vt::stats().combined_writes;
+  std::atomic<bool> failed = false;
+  std::vector<std::thread> threads;
+  for (uint32_t w = 0; w < writers; ++w) {
+    threads.emplace_back([&, w] {
+      const int fd = vtpc_open(path, O_WRONLY | O_APPEND, 0);
+      for (uint32_t seq = 0; seq < records && fd >= 0; ++seq) {
+        const std::string data = record(w, seq);
+        if (seq % 1000 == 0) {
+          vtpc_lseek(fd, 0, SEEK_SET);
+        }
+        if (vtpc_write(fd, data.data(), data.size()) !=
+            static_cast<ssize_t>(data.size())) {
+          failed = true;
+          break;
+        }
+      }
+      failed = failed || fd < 0 || vtpc_close(fd) != 0;
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (failed) {
+    throw vt::exception() << "a writer failed to append";
+  }
+  if (vt::stats().combined_writes == combined) {
+    throw vt::exception() << "no append was buffered";
+  }
+
+  const std::string content = read_file();
+  std::vector<uint32_t> next(writers, 0);
+  size_t at = 0;
+  while (at + sizeof(header) <= content.size()) {
+    header head{};
+    std::memcpy(&head, content.data() + at, sizeof(head));
+    if (head.writer >= writers || head.seq != next[head.writer] ||
+        at + head.size > content.size() ||
+        record(head.writer, head.seq) != content.substr(at, head.size)) {
+      throw vt::exception() << "record at " << at << " is out of order or torn";
+    }
+    next[head.writer] += 1;
+    at += head.size;
+  }
+  if (at != content.size()) {
+    throw vt::exception() << "the file ends in a partial record";
+  }
+  for (uint32_t w = 0; w < writers; ++w) {
+    if (next[w] != records) {
+      throw vt::exception() << "writer " << w << " lost "
+                            << records - next[w] << " records";
+    }
+  }
+  std::cout << content.size() << " bytes appended by " << writers
+            << " writers\n";
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
@@ -0,0 +1,172 @@
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "exception.hpp"
+#include "vtpc_file.hpp"
+
+extern "C" {
+#include <fcntl.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+constexpr size_t page = 4096;
+constexpr size_t pages = 64;
+constexpr uint64_t latency_ns = 2 * 1000 * 1000;
+constexpr uint64_t sync_latency_ns = 200 * 1000 * 1000;
+constexpr const char* path = "/tmp/backend";
+
+// Writes the content through the cache and reads it back after the file
+// was closed and forgotten. The file on disk ends where the content does,
+// even off a block boundary.
+auto round_trip(const std::string& content) -> void {
+  int fd = vt::open_or_throw(path, O_RDWR | O_CREAT | O_TRUNC);
+  if (vtpc_write(fd, content.data(), content.size()) !=
+          static_cast<ssize_t>(content.size()) ||
+      vtpc_fsync(fd) != 0 || vtpc_close(fd) != 0) {
+    throw vt::exception() << "failed to write " << path;
+  }
+  struct stat st{};
+  if (stat(path, &st) != 0 ||
+      st.st_size != static_cast<off_t>(content.size())) {
+    throw vt::exception() << path << " has " << st.st_size << " bytes, not "
+                          << content.size();
+  }
+  fd = vt::open_or_throw(path, O_RDONLY);
+  std::string actual(content.size(), 0);
+  if (vtpc_read(fd, actual.data(), actual.size()) !=
+      static_cast<ssize_t>(actual.size())) {
+    throw vt::exception() << "failed to read " << path;
+  }
+  vtpc_close(fd);
+  if (actual != content) {
+    throw vt::exception() << "content differs";
+  }
+}
+
+// Reads the file page by page with the advice, returning how long it took.
+auto timed_scan(int advice) -> std::chrono::nanoseconds {
+  const int fd = vt::open_or_throw(path, O_RDONLY);
+  if (vtpc_fadvise(fd, 0, 0, advice) != 0) {
+    throw vt::exception() << "vtpc_fadvise failed";
+  }
+  std::string buffer(page, 0);
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < pages; ++i) {
+    if (vtpc_read(fd, buffer.data(), page) != static_cast<ssize_t>(page)) {
+      throw vt::exception() << "failed to read page " << i;
+    }
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  vtpc_close(fd);
+  return elapsed;
+}
+
+// Opens the file for writes while a sync of it is waiting for the device.
+// The open gives the file a writable descriptor and closes the one being
+// synced, so it must wait until the sync returns.
+auto check_sync_holds_file() -> void {
+  const vtpc_device device{
+      .latency_ns = sync_latency_ns,
+      .distribution = VTPC_LATENCY_FIXED,
+      .bandwidth = 0,
+      .depth = 0,
+      .iops = 0,
+      .seed = 1,
+  };
+  if (vtpc_set_device(&device) != 0) {
+    throw vt::exception() << "vtpc_set_device failed";
+  }
+  const int reader = vt::open_or_throw(path, O_RDONLY);
+  const auto start = std::chrono::steady_clock::now();
+  int status = 0;
+  std::thread syncer([&] { status = vtpc_fsync(reader); });
+  std::this_thread::sleep_for(std::chrono::nanoseconds(sync_latency_ns / 4));
+  const int writer = vt::open_or_throw(path, O_RDWR);
+  const auto opened = std::chrono::steady_clock::now() - start;
+  syncer.join();
+  vtpc_close(writer);
+  vtpc_close(reader);
+  if (status != 0) {
+    throw vt::exception() << "vtpc_fsync failed";
+  }
+  if (opened < std::chrono::nanoseconds(sync_latency_ns)) {
+    throw vt::exception() << "opening for writes took "
+                          << opened.count() / 1000
+                          << " us, not waiting for the sync";
+  }
+}
+
+}  // namespace
+
+auto main() -> int try {
+  std::string content(pages * page, ' ');
+  for (size_t i = 0; i < content.size(); ++i) {
+    content[i] = static_cast<char>('a' + ((i / page + i) % 26));
+  }
+
+  for (const char* name : {"pread", "direct", "uring", "sim"}) {
+    if (vtpc_set_backend(name) != 0) {
+      if (std::string(name) == "uring" && errno != EINVAL) {
+        std::cout << "io_uring unavailable, skipped\n";
+        continue;
+      }
+      throw vt::exception() << "failed to select " << name;
+    }
+    round_trip(content.substr(0, content.size() - 100));
+    round_trip(content);
+  }
+
+  // Every miss waits for the device, and readahead overlaps the waits.
+  const vtpc_device device{
+      .latency_ns = latency_ns,
+      .distribution = VTPC_LATENCY_FIXED,
+      .bandwidth = 0,
+      .depth = 8,
+      .iops = 0,
+      .seed = 1,
+  };
+  vtpc_device unknown = device;
+  unknown.distribution =
+      static_cast<vtpc_latency>(VTPC_LATENCY_EXPONENTIAL + 1);
+  if (vtpc_set_device(&unknown) != -1 || errno != EINVAL) {
+    throw vt::exception() << "an unknown distribution was accepted";
+  }
+  vtpc_set_backend("pread");
+  const int fd = vt::open_or_throw(path, O_RDONLY);
+  if (vtpc_set_device(&device) != -1 || errno != EBUSY) {
+    throw vt::exception() << "the backend changed while a file was open";
+  }
+  vtpc_close(fd);
+  if (vtpc_set_device(&device) != 0) {
+    throw vt::exception() << "vtpc_set_device failed";
+  }
+  const auto random = timed_scan(POSIX_FADV_RANDOM);
+  const auto sequential = timed_scan(POSIX_FADV_SEQUENTIAL);
+  if (random < std::chrono::nanoseconds(pages * latency_ns) ||
+      sequential >= random) {
+    throw vt::exception() << "random scan took " << random.count()
+                          << " ns, sequential " << sequential.count()
+                          << " ns";
+  }
+
+  std::cout << "random scan " << random.count() / 1000 << " us, sequential "
+            << sequential.count() / 1000 << " us\n";
+
+  check_sync_holds_file();
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
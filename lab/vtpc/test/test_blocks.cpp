@@ -0,0 +1,128 @@
+#include <sys/types.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "exception.hpp"
+#include "file.hpp"
+#include "vtpc_file.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+constexpr size_t page = 4096;
+constexpr size_t size = 4U << 20U;
+constexpr const char* path = "/tmp/blocks";
+
+auto misses() -> uint64_t {
+  vtpc_stats stats{};
+  vtpc_get_stats(&stats);
+  return stats.misses;
+}
+
+// Reads the whole file a page at a time with the given block size and
+// returns the number of misses it took.
+auto scan(const std::string& content, size_t block) -> uint64_t {
+  const int fd = vtpc_open(path, O_RDONLY, 0);
+  if (fd < 0 || vtpc_set_block_size(fd, block) != 0 ||
+      vtpc_fadvise(fd, 0, 0, POSIX_FADV_RANDOM) != 0) {
+    throw vt::exception() << "failed to open " << path << " with " << block
+                          << " byte blocks";
+  }
+
+  const uint64_t before = misses();
+  std::string actual(page, 0);
+  for (size_t offset = 0; offset < size; offset += page) {
+    if (vtpc_read(fd, actual.data(), page) != static_cast<ssize_t>(page)) {
+      throw vt::exception() << "failed to read at " << offset;
+    }
+    if (actual != content.substr(offset, page)) {
+      throw vt::exception() << "content differs at " << offset << " with "
+                            << block << " byte blocks";
+    }
+  }
+  const uint64_t count = misses() - before;
+  vtpc_close(fd);
+  return count;
+}
+
+}  // namespace
+
+auto main() -> int try {
+  std::string content(size, ' ');
+  for (size_t i = 0; i < content.size(); ++i) {
+    content[i] = static_cast<char>('a' + ((i / page + i) % 26));
+  }
+  {
+    auto vtpc = vt::file::open_vtpc(path);
+    vtpc->seek(0);
+    vtpc->write(content);
+    vtpc->sync();
+  }
+
+  const int fd = vt::open_or_throw(path, O_RDWR);
+  for (const size_t bad : {size_t{0}, page / 2, page + 1, 3 * page, size}) {
+    errno = 0;
+    if (vtpc_set_block_size(fd, bad) != -1 || errno != EINVAL) {
+      throw vt::exception() << "block size " << bad << " was accepted";
+    }
+  }
+
+  // Writes straddling block boundaries land at the right bytes, through
+  // the cache and on disk.
+  constexpr size_t block = 64U << 10U;
+  if (vtpc_set_block_size(fd, block) != 0) {
+    throw vt::exception() << "vtpc_set_block_size failed";
+  }
+  for (size_t i = 1; i < 8; ++i) {
+    const size_t offset = (i * block) - (i * 100);
+    const std::string text(i * 200, static_cast<char>('0' + i));
+    content.replace(offset, text.size(), text);
+    if (vtpc_lseek(fd, static_cast<off_t>(offset), SEEK_SET) !=
+            static_cast<off_t>(offset) ||
+        vtpc_write(fd, text.data(), text.size()) !=
+            static_cast<ssize_t>(text.size())) {
+      throw vt::exception() << "failed to write at " << offset;
+    }
+  }
+  if (vtpc_fsync(fd) != 0) {
+    throw vt::exception() << "vtpc_fsync failed";
+  }
+  vtpc_close(fd);
+
+  const int raw = open(path, O_RDONLY);
+  std::string disk(size, 0);
+  if (raw < 0 || pread(raw, disk.data(), size, 0) !=
+                     static_cast<ssize_t>(size)) {
+    throw vt::exception() << "failed to read " << path;
+  }
+  close(raw);
+  if (disk != content) {
+    throw vt::exception() << "written blocks differ on disk";
+  }
+
+  // Larger blocks take proportionally fewer misses to scan the file.
+  const uint64_t small = scan(content, page);
+  const uint64_t large = scan(content, block);
+  const uint64_t huge = scan(content, 2U << 20U);
+  if (small < size / page || large > size / block || huge > 2) {
+    throw vt::exception() << "scan missed " << small << ", " << large
+                          << " and " << huge << " times";
+  }
+  std::cout << "misses " << small << " with 4 KiB blocks, " << large
+            << " with 64 KiB, " << huge << " with 2 MiB\n";
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
@@ -0,0 +1,157 @@
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+
+#include "exception.hpp"
+#include "vtpc_file.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+constexpr size_t page = 4096;
+constexpr const char* path = "/tmp/coherence";
+
+// Writes the file as another process would, without vtpc, filled with
+// fill and stamped with a modification time of its own.
+auto rewrite(const char* target, size_t pages, char fill) -> void {
+  const std::string content(pages * page, fill);
+  const int raw = open(target, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  const timespec times[2] = {{fill, 0}, {fill, 0}};
+  if (raw < 0 ||
+      write(raw, content.data(), content.size()) !=
+          static_cast<ssize_t>(content.size()) ||
+      futimens(raw, times) != 0) {
+    throw vt::exception() << "failed to write " << target;
+  }
+  close(raw);
+}
+
+// Reads the file from the start through vtpc and checks that it holds
+// pages of fill.
+auto expect(int fd, size_t pages, char fill) -> void {
+  const auto size = static_cast<off_t>(pages * page);
+  if (vtpc_lseek(fd, 0, SEEK_END) != size) {
+    throw vt::exception() << "cached size is not " << size;
+  }
+  std::string buffer(pages * page, 0);
+  if (vtpc_lseek(fd, 0, SEEK_SET) != 0 ||
+      vtpc_read(fd, buffer.data(), buffer.size()) != size) {
+    throw vt::exception() << "failed to read " << path;
+  }
+  if (buffer.find_first_not_of(fill) != std::string::npos) {
+    throw vt::exception() << "read stale data instead of '" << fill << "'";
+  }
+}
+
+// Watches the file while another process rewrites it with fill, and waits
+// for the watcher to invalidate it without any check on access.
+auto watch_rewrite(int fd, char fill) -> void {
+  if (vtpc_set_watch(true) != 0) {
+    throw vt::exception() << "failed to watch " << path;
+  }
+  const uint64_t watched = vt::stats().invalidations;
+  rewrite(path, 2, fill);
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (vt::stats().invalidations == watched) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      throw vt::exception() << "the watcher did not notice the write";
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  expect(fd, 2, fill);
+  if (vtpc_set_watch(false) != 0) {
+    throw vt::exception() << "failed to stop watching " << path;
+  }
+}
+
+// Counts the entries of a directory, such as the threads or descriptors of
+// the process under /proc/self.
+auto entries(const char* dir) -> size_t {
+  return static_cast<size_t>(
+      std::distance(std::filesystem::directory_iterator(dir), {})
+  );
+}
+
+}  // namespace
+
+auto main() -> int try {
+  rewrite(path, 2, 'a');
+  const int fd = vt::open_or_throw(path, O_RDWR);
+  expect(fd, 2, 'a');
+
+  // Opening the cached file again finds it changed.
+  rewrite(path, 3, 'b');
+  const uint64_t invalidations = vt::stats().invalidations;
+  const int again = vt::open_or_throw(path, O_RDONLY);
+  if (vt::stats().invalidations != invalidations + 1) {
+    throw vt::exception() << "open did not notice the file changed";
+  }
+  expect(fd, 3, 'b');
+
+  // The cache's own writes are no change.
+  const std::string own(page, 'c');
+  if (vtpc_lseek(fd, 0, SEEK_SET) != 0 ||
+      vtpc_write(fd, own.data(), own.size()) !=
+          static_cast<ssize_t>(own.size()) ||
+      vtpc_fsync(fd) != 0) {
+    throw vt::exception() << "failed to write " << path;
+  }
+  vtpc_close(again);
+  vtpc_close(vt::open_or_throw(path, O_RDONLY));
+  if (vt::stats().invalidations != invalidations + 1) {
+    throw vt::exception() << "the cache's own write invalidated the file";
+  }
+
+  // With an interval, reads check the file again.
+  vtpc_set_revalidate(1000000);
+  rewrite(path, 1, 'd');
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  expect(fd, 1, 'd');
+
+  // A file renamed over the path is reopened.
+  const std::string replacement = std::string(path) + ".new";
+  rewrite(replacement.c_str(), 2, 'e');
+  if (std::rename(replacement.c_str(), path) != 0) {
+    throw vt::exception() << "failed to rename over " << path;
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  expect(fd, 2, 'e');
+
+  // The watcher invalidates without any check on access. Stopping it ends
+  // its thread and closes its descriptors, and it starts again afresh.
+  vtpc_set_revalidate(0);
+  const size_t threads = entries("/proc/self/task");
+  const size_t descriptors = entries("/proc/self/fd");
+  watch_rewrite(fd, 'f');
+  watch_rewrite(fd, 'g');
+  if (entries("/proc/self/task") != threads ||
+      entries("/proc/self/fd") != descriptors) {
+    throw vt::exception() << "the stopped watcher left a thread or descriptor";
+  }
+
+  vtpc_close(fd);
+  const vtpc_stats stats = vt::stats();
+  std::cout << stats.revalidations << " checks, " << stats.invalidations
+            << " invalidations\n";
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
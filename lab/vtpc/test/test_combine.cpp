@@ -0,0 +1,134 @@
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "exception.hpp"
+#include "vtpc_file.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+constexpr size_t count = 4096;
+constexpr const char* path = "/tmp/combine";
+
+// Reads size bytes at offset through the descriptor.
+auto read_at(int fd, off_t offset, size_t size) -> std::string {
+  std::string text(size, 0);
+  if (vtpc_lseek(fd, offset, SEEK_SET) != offset) {
+    throw vt::exception() << "failed to seek to " << offset;
+  }
+  const ssize_t done = vtpc_read(fd, text.data(), size);
+  if (done < 0) {
+    throw vt::exception() << "failed to read at " << offset;
+  }
+  text.resize(done);
+  return text;
+}
+
+}  // namespace
+
+auto main() -> int try {
+  const int writer = vt::open_or_throw(path, O_RDWR | O_CREAT | O_TRUNC);
+  const int reader = vt::open_or_throw(path, O_RDONLY);
+
+  // Short writes in a row are gathered, and every one of them is visible
+  // to another descriptor right after it returns.
+  const vtpc_stats before = vt::stats();
+  std::string content;
+  for (size_t i = 0; i < count; ++i) {
+    const std::string text = std::to_string(i);
+    if (vtpc_write(writer, text.data(), text.size()) !=
+        static_cast<ssize_t>(text.size())) {
+      throw vt::exception() << "failed to write '" << text << "'";
+    }
+    content += text;
+    if (i % 97 == 0) {
+      const auto offset = static_cast<off_t>(content.size() - text.size());
+      if (read_at(reader, offset, 64) != text) {
+        throw vt::exception() << "'" << text << "' is not visible";
+      }
+    }
+  }
+  const vtpc_stats after = vt::stats();
+  const uint64_t combined = after.combined_writes - before.combined_writes;
+  const uint64_t commits = after.combine_commits - before.combine_commits;
+  if (combined < count / 2 || commits * 16 > combined) {
+    throw vt::exception() << "combined " << combined << " writes in "
+                          << commits << " commits";
+  }
+
+  // The writer reads its own writes, and an overwrite in the middle wins
+  // over what was buffered before it.
+  if (read_at(writer, 0, content.size()) != content) {
+    throw vt::exception() << "writer does not read its writes";
+  }
+  if (vtpc_lseek(writer, 100, SEEK_SET) != 100 ||
+      vtpc_write(writer, "xyz", 3) != 3 || vtpc_write(writer, "w", 1) != 1) {
+    throw vt::exception() << "failed to overwrite";
+  }
+  content.replace(100, 4, "xyzw");
+  if (read_at(reader, 0, content.size()) != content) {
+    throw vt::exception() << "reader does not see the overwrite";
+  }
+
+  // Close commits what is still buffered, and fsync writes it to disk.
+  if (vtpc_write(writer, "tail", 4) != 4 || vtpc_close(writer) != 0) {
+    throw vt::exception() << "failed to close the writer";
+  }
+  content.replace(104, 4, "tail");
+  if (vtpc_fsync(reader) != 0) {
+    throw vt::exception() << "vtpc_fsync failed";
+  }
+  const int raw = open(path, O_RDONLY);
+  std::string disk(content.size(), 0);
+  if (raw < 0 || pread(raw, disk.data(), disk.size(), 0) !=
+                     static_cast<ssize_t>(disk.size())) {
+    throw vt::exception() << "failed to read " << path;
+  }
+  close(raw);
+  if (disk != content) {
+    throw vt::exception() << "buffered writes differ on disk";
+  }
+
+  // Truncating through another descriptor commits a run buffered before
+  // the new end and drops one past it, so no buffered byte reappears there,
+  // and so does opening with O_TRUNC.
+  const int buffered = vt::open_or_throw(path, O_RDWR);
+  const int cutter = vt::open_or_throw(path, O_RDWR);
+  if (vtpc_lseek(buffered, 50, SEEK_SET) != 50 ||
+      vtpc_write(buffered, "abcd", 4) != 4 || vtpc_ftruncate(cutter, 52) != 0 ||
+      vtpc_write(buffered, "ef", 2) != 2 || vtpc_ftruncate(cutter, 20) != 0) {
+    throw vt::exception() << "failed to truncate under a buffered run";
+  }
+  content.resize(20);
+  if (read_at(reader, 0, 2 * content.size()) != content) {
+    throw vt::exception() << "buffered bytes survived vtpc_ftruncate";
+  }
+  if (vtpc_write(buffered, "gh", 2) != 2) {
+    throw vt::exception() << "failed to write past the end";
+  }
+  vtpc_close(vt::open_or_throw(path, O_RDWR | O_TRUNC));
+  vtpc_close(buffered);
+  vtpc_close(cutter);
+  if (read_at(reader, 0, 64) != "") {
+    throw vt::exception() << "buffered bytes survived O_TRUNC";
+  }
+  vtpc_close(reader);
+
+  std::cout << "combined " << combined << " writes in " << commits
+            << " commits\n";
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
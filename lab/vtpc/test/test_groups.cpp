@@ -0,0 +1,95 @@
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "exception.hpp"
+#include "vtpc_file.hpp"
+
+extern "C" {
+#include <unistd.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+constexpr size_t page = 4096;
+constexpr size_t interactive_pages = 32;
+constexpr size_t scanner_pages = 1024;
+constexpr size_t scanner_limit = 64 * page;
+
+// Reads every page of the file and returns how many reads missed.
+auto scan(int fd, size_t pages) -> uint64_t {
+  const uint64_t before = vt::stats().misses;
+  std::string buffer(page, 0);
+  for (size_t i = 0; i < pages; ++i) {
+    const auto offset = static_cast<off_t>(i * page);
+    if (vtpc_lseek(fd, offset, SEEK_SET) != offset ||
+        vtpc_read(fd, buffer.data(), page) != static_cast<ssize_t>(page)) {
+      throw vt::exception() << "failed to read page " << i;
+    }
+  }
+  return vt::stats().misses - before;
+}
+
+}  // namespace
+
+auto main() -> int try {
+  vt::create("/tmp/groups_interactive", interactive_pages * page);
+  vt::create("/tmp/groups_scanner", scanner_pages * page);
+  const int interactive = vt::open_random("/tmp/groups_interactive");
+  const int scanner = vt::open_random("/tmp/groups_scanner");
+
+  // Unshared, a scan of a large file pushes the small one out.
+  scan(interactive, interactive_pages);
+  scan(scanner, scanner_pages);
+  if (scan(interactive, interactive_pages) != interactive_pages) {
+    throw vt::exception() << "interactive file survived an unshared scan";
+  }
+
+  // A scanner at its limit evicts its own pages.
+  if (vtpc_set_group(scanner, 2) != 0 ||
+      vtpc_set_share(2, 0, scanner_limit) != 0) {
+    throw vt::exception() << "failed to limit the scanner";
+  }
+  scan(scanner, scanner_pages);
+  const uint64_t limited = scan(interactive, interactive_pages);
+  const uint64_t resident = vt::stats().group_resident[2];
+  if (limited != 0 || resident > scanner_limit) {
+    throw vt::exception() << "limited scanner holds " << resident
+                          << " bytes, interactive file missed " << limited
+                          << " times";
+  }
+
+  // Without a limit, a reservation keeps the interactive file resident.
+  if (vtpc_set_share(2, 0, 0) != 0 || vtpc_set_group(interactive, 1) != 0 ||
+      vtpc_set_share(1, interactive_pages * page, 0) != 0) {
+    throw vt::exception() << "failed to reserve for the interactive file";
+  }
+  scan(scanner, scanner_pages);
+  const uint64_t reserved = scan(interactive, interactive_pages);
+  if (reserved != 0 ||
+      vt::stats().group_resident[1] != interactive_pages * page) {
+    throw vt::exception() << "reserved file missed " << reserved << " times";
+  }
+
+  // Reservations may not add up to more than the cache.
+  if (vtpc_set_share(3, SIZE_MAX / 2, 0) == 0) {
+    throw vt::exception() << "oversized reservation accepted";
+  }
+
+  vtpc_close(interactive);
+  vtpc_close(scanner);
+  const vtpc_stats now = vt::stats();
+  std::cout << "scanner lost " << now.group_evictions[2]
+            << " pages, interactive group "
+            << now.group_evictions[1] << '\n';
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
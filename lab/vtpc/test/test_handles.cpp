@@ -0,0 +1,143 @@
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "exception.hpp"
+#include "vtpc_file.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+constexpr size_t page = 4096;
+constexpr const char* path = "/tmp/handles";
+constexpr const char* private_path = "/tmp/handles_write_only";
+
+auto expect_stale(int fd) -> void {
+  char byte = 0;
+  errno = 0;
+  if (vtpc_read(fd, &byte, 1) != -1 || errno != EBADF ||
+      vtpc_lseek(fd, 0, SEEK_SET) != -1 || vtpc_close(fd) != -1) {
+    throw vt::exception() << "handle " << fd << " is still usable";
+  }
+}
+
+// Writes through the cache to a file the process may write but not read.
+// Partial writes to blocks the cache cannot load go straight to the file,
+// and whole blocks are cached as usual. Returns false where permissions
+// are not enforced, as for root.
+auto write_only() -> bool {
+  std::string content(3 * page, 'x');
+  vt::create(private_path, content.size());
+  if (chmod(private_path, 0200) != 0) {
+    throw vt::exception() << "failed to chmod " << private_path;
+  }
+  const int probe = open(private_path, O_RDONLY);
+  if (probe >= 0) {
+    close(probe);
+    return false;
+  }
+
+  const int fd = vt::open_or_throw(private_path, O_WRONLY);
+  const uint64_t before = vt::stats().write_arounds;
+  const auto write_at = [&](size_t offset, const std::string& text) {
+    const auto at = static_cast<off_t>(offset);
+    if (vtpc_lseek(fd, at, SEEK_SET) != at ||
+        vtpc_write(fd, text.data(), text.size()) !=
+            static_cast<ssize_t>(text.size())) {
+      throw vt::exception() << "failed to write at " << offset;
+    }
+    content.resize(std::max(content.size(), offset + text.size()), '\0');
+    content.replace(offset, text.size(), text);
+  };
+  write_at(10, "partial");
+  write_at(page, std::string(page, 'y'));
+  write_at((2 * page) + 50, std::string(page, 'z'));
+  if (vtpc_fsync(fd) != 0 || vtpc_close(fd) != 0) {
+    throw vt::exception() << "failed to flush " << private_path;
+  }
+  if (vt::stats().write_arounds - before != 2) {
+    throw vt::exception() << "partial writes to uncached blocks were cached";
+  }
+
+  std::string disk(content.size() + 1, 0);
+  const int raw = chmod(private_path, 0600) == 0
+                      ? open(private_path, O_RDONLY)
+                      : -1;
+  const ssize_t got = raw < 0 ? -1 : pread(raw, disk.data(), disk.size(), 0);
+  close(raw);
+  if (got != static_cast<ssize_t>(content.size()) ||
+      disk.substr(0, content.size()) != content) {
+    throw vt::exception() << "the write-only file does not hold the writes";
+  }
+  return true;
+}
+
+}  // namespace
+
+auto main() -> int try {
+  const int first = vt::open_or_throw(path, O_RDWR | O_CREAT);
+  if (vtpc_close(first) != 0) {
+    throw vt::exception() << "vtpc_close failed";
+  }
+  expect_stale(first);
+
+  // The reopen may reuse the slot, but not the handle.
+  const int second = vt::open_or_throw(path, O_RDWR | O_CREAT);
+  if (second == first) {
+    throw vt::exception() << "handle " << first << " was reissued";
+  }
+  expect_stale(first);
+
+  const int raw = open(path, O_RDONLY);
+  if (raw < 0) {
+    throw vt::exception() << "failed to open " << path;
+  }
+  expect_stale(raw);
+  close(raw);
+
+  std::vector<int> handles{second};
+  for (;;) {
+    const int fd = vtpc_open(path, O_RDONLY, 0);
+    if (fd < 0) {
+      if (errno != EMFILE) {
+        throw vt::exception() << "open " << handles.size() << " failed";
+      }
+      break;
+    }
+    handles.push_back(fd);
+  }
+  for (const int fd : handles) {
+    if (vtpc_close(fd) != 0) {
+      throw vt::exception() << "vtpc_close(" << fd << ") failed";
+    }
+  }
+  for (const int fd : handles) {
+    expect_stale(fd);
+  }
+
+  const int last = vt::open_or_throw(path, O_RDWR | O_CREAT);
+  vtpc_close(last);
+  std::cout << "handles " << handles.size() << '\n';
+
+  if (!write_only()) {
+    std::cout << "permissions not enforced, write-only file skipped\n";
+  }
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
@@ -0,0 +1,93 @@
+#include <sys/types.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "exception.hpp"
+#include "file.hpp"
+#include "vtpc_file.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "vtpc.h"
+}
+
+auto main() -> int try {
+  constexpr size_t page = 4096;
+  constexpr size_t pages = 512;
+  constexpr const char* path = "/tmp/mmap";
+
+  std::string content(page * pages, ' ');
+  for (size_t i = 0; i < content.size(); ++i) {
+    content[i] = static_cast<char>('a' + ((i / page + i) % 26));
+  }
+  {
+    auto vtpc = vt::file::open_vtpc(path);
+    vtpc->seek(0);
+    vtpc->write(content);
+    vtpc->sync();
+  }
+
+  const int fd = vt::open_or_throw(path, O_RDWR);
+
+  auto* addr = static_cast<const char*>(vtpc_mmap(fd, 0, content.size()));
+  if (addr == nullptr && (errno == EPERM || errno == ENOSYS)) {
+    std::cout << "userfaultfd is not available: " << strerror(errno) << '\n';
+    vtpc_close(fd);
+    return 0;
+  }
+  if (addr == nullptr) {
+    throw vt::exception() << "vtpc_mmap failed: " << strerror(errno);
+  }
+
+  // The region is larger than the cache, so early pages are evicted and
+  // fault again on the second pass.
+  for (size_t pass = 0; pass < 2; ++pass) {
+    if (std::string_view(addr, content.size()) != content) {
+      throw vt::exception() << "mapped content differs on pass " << pass;
+    }
+  }
+
+  constexpr std::string_view patch = "patched through vtpc_write";
+  constexpr off_t offset = 3 * page + 100;
+  if (vtpc_lseek(fd, offset, SEEK_SET) != offset ||
+      vtpc_write(fd, patch.data(), patch.size()) !=
+          static_cast<ssize_t>(patch.size())) {
+    throw vt::exception() << "vtpc_write failed";
+  }
+  if (std::string_view(addr + offset, patch.size()) != patch) {
+    throw vt::exception() << "mapping does not show the write";
+  }
+
+  vtpc_stats stats{};
+  vtpc_get_stats(&stats);
+  if (stats.map_faults <= pages) {
+    throw vt::exception() << "expected evicted pages to fault again, got "
+                          << stats.map_faults << " faults";
+  }
+  std::cout << "faults " << stats.map_faults << '\n';
+
+  auto* region = const_cast<char*>(addr);  // NOLINT
+  if (vtpc_munmap(region, page) == 0 || errno != EINVAL) {
+    throw vt::exception() << "a partial vtpc_munmap did not fail";
+  }
+  content.replace(offset, patch.size(), patch);
+  if (std::string_view(addr, content.size()) != content) {
+    throw vt::exception() << "the mapping changed after a partial unmap";
+  }
+  if (vtpc_munmap(region, content.size()) != 0) {
+    throw vt::exception() << "vtpc_munmap failed: " << strerror(errno);
+  }
+  vtpc_close(fd);
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
@@ -0,0 +1,112 @@
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "exception.hpp"
+#include "file.hpp"
+#include "vtpc_file.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+constexpr size_t page = 4096;
+constexpr size_t pages = 48;
+constexpr const char* path = "/tmp/mrc";
+
+// Reads every page of the file in order, rounds times over.
+auto cycle(int fd, const std::string& content, size_t rounds) -> void {
+  std::string actual(page, 0);
+  for (size_t round = 0; round < rounds; ++round) {
+    for (size_t i = 0; i < pages; ++i) {
+      const auto offset = static_cast<off_t>(i * page);
+      if (vtpc_lseek(fd, offset, SEEK_SET) != offset ||
+          vtpc_read(fd, actual.data(), page) != static_cast<ssize_t>(page)) {
+        throw vt::exception() << "failed to read page " << i;
+      }
+      if (actual != content.substr(offset, page)) {
+        throw vt::exception() << "content differs at page " << i;
+      }
+    }
+  }
+}
+
+auto point(const vtpc_stats& stats, size_t capacity) -> double {
+  return stats.mrc[(capacity * page / stats.mrc_step) - 1];
+}
+
+}  // namespace
+
+auto main() -> int try {
+  std::string content(page * pages, ' ');
+  for (size_t i = 0; i < content.size(); ++i) {
+    content[i] = static_cast<char>('a' + ((i / page + i) % 26));
+  }
+  {
+    auto vtpc = vt::file::open_vtpc(path);
+    vtpc->seek(0);
+    vtpc->write(content);
+    vtpc->sync();
+  }
+
+  const int fd = vtpc_open(path, O_RDONLY, 0);
+  if (fd < 0 || vtpc_fadvise(fd, 0, 0, POSIX_FADV_RANDOM) != 0) {
+    throw vt::exception() << "failed to open " << path;
+  }
+
+  // A loop over the pages hits in any LRU cache that holds all of them and
+  // misses in any smaller one.
+  cycle(fd, content, 200);
+  vtpc_stats now = vt::stats();
+  if (now.mrc_step != 16 * page || point(now, 32) < 0.9 ||
+      point(now, 48) > 0.1) {
+    throw vt::exception() << "expected a cliff at " << pages
+                          << " pages, got miss ratios " << point(now, 32)
+                          << " at 32 and " << point(now, 48) << " at 48";
+  }
+
+  if (vtpc_autosize(1e-3) != 0) {
+    throw vt::exception() << "vtpc_autosize failed";
+  }
+  cycle(fd, content, 200);
+  now = vt::stats();
+  if (now.capacity != pages * page) {
+    throw vt::exception() << "auto-sized to " << now.capacity / page
+                          << " pages instead of " << pages;
+  }
+  vtpc_stats before = now;
+  cycle(fd, content, 1);
+  now = vt::stats();
+  if (now.misses != before.misses) {
+    throw vt::exception() << "auto-sized cache missed "
+                          << now.misses - before.misses << " pages";
+  }
+
+  if (vtpc_set_capacity(0) == 0 || vtpc_set_capacity(16 * page) != 0) {
+    throw vt::exception() << "vtpc_set_capacity accepted zero or refused 16";
+  }
+  before = vt::stats();
+  cycle(fd, content, 1);
+  now = vt::stats();
+  if (now.capacity != 16 * page || now.misses - before.misses != pages) {
+    throw vt::exception() << "capacity " << now.capacity / page << " missed "
+                          << now.misses - before.misses << " pages";
+  }
+
+  std::cout << "capacity " << now.capacity / page << ", evictions "
+            << now.evictions << '\n';
+  vtpc_close(fd);
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
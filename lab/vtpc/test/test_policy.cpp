@@ -0,0 +1,135 @@
+#include <sys/types.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "exception.hpp"
+#include "vtpc_file.hpp"
+
+extern "C" {
+#include <unistd.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+constexpr size_t page = 4096;
+constexpr size_t hot_pages = 64;
+constexpr size_t scan_pages = 1024;
+constexpr size_t small_pages = 16;
+constexpr size_t working_pages = 12;
+constexpr size_t rounds = 64;
+
+// Reads pages [first, last) of the file once and returns how many missed.
+auto scan(int fd, size_t last, size_t first = 0) -> uint64_t {
+  const uint64_t before = vt::stats().misses;
+  std::string buffer(page, 0);
+  for (size_t i = first; i < last; ++i) {
+    const auto offset = static_cast<off_t>(i * page);
+    if (vtpc_lseek(fd, offset, SEEK_SET) != offset ||
+        vtpc_read(fd, buffer.data(), page) != static_cast<ssize_t>(page)) {
+      throw vt::exception() << "failed to read page " << i;
+    }
+  }
+  return vt::stats().misses - before;
+}
+
+// Reads the hot file a few times, then scans a file four times the cache
+// once, and returns how many hot pages miss afterwards.
+auto hot_misses_after_scan(const char* policy) -> uint64_t {
+  if (vtpc_set_policy(policy) != 0) {
+    throw vt::exception() << "failed to select " << policy;
+  }
+  const int hot = vt::open_random("/tmp/policy_hot");
+  const int cold = vt::open_random("/tmp/policy_scan");
+  for (size_t round = 0; round < 4; ++round) {
+    scan(hot, hot_pages);
+  }
+  scan(cold, scan_pages);
+  const uint64_t misses = scan(hot, hot_pages);
+  vtpc_close(cold);
+  vtpc_close(hot);
+  return misses;
+}
+
+// Rereads a working set that fits a small cache, with one new page after
+// it each round, and returns how many reads missed. Evicting only the page
+// each miss needs leaves the working set cached, so each round after the
+// first misses once.
+auto misses_at_small_capacity() -> uint64_t {
+  if (vtpc_set_policy("lru") != 0 ||
+      vtpc_set_capacity(small_pages * page) != 0) {
+    throw vt::exception() << "failed to set up a small LRU cache";
+  }
+  const int fd = vt::open_random("/tmp/policy_scan");
+  const uint64_t before = vt::stats().misses;
+  for (size_t round = 0; round < rounds; ++round) {
+    scan(fd, working_pages);
+    scan(fd, working_pages + round + 1, working_pages + round);
+  }
+  vtpc_close(fd);
+  return vt::stats().misses - before;
+}
+
+}  // namespace
+
+auto main() -> int try {
+  vt::create("/tmp/policy_hot", hot_pages * page);
+  vt::create("/tmp/policy_scan", scan_pages * page);
+
+  const int fd = vt::open_random("/tmp/policy_hot");
+  if (vtpc_set_policy("s3-fifo") != -1 || errno != EBUSY) {
+    throw vt::exception() << "policy changed while a file was open";
+  }
+  vtpc_close(fd);
+  if (vtpc_set_policy("mru") != -1 || errno != EINVAL) {
+    throw vt::exception() << "unknown policy accepted";
+  }
+
+  // LRU lets the scan flush the hot pages; the others only count hits, and
+  // keep pages hit more than once over pages read once.
+  const uint64_t lru = hot_misses_after_scan("lru");
+  if (lru != hot_pages) {
+    throw vt::exception() << "LRU kept " << hot_pages - lru
+                          << " hot pages through the scan";
+  }
+  for (const char* policy : {"clock-pro", "s3-fifo"}) {
+    const uint64_t misses = hot_misses_after_scan(policy);
+    if (misses > hot_pages / 4) {
+      throw vt::exception() << policy << " lost " << misses
+                            << " hot pages to the scan";
+    }
+    std::cout << policy << " kept " << hot_pages - misses << " of "
+              << hot_pages << " hot pages through the scan\n";
+  }
+
+  // Rereading the scan backwards runs past the pages still cached into
+  // those it evicted last, which the ghost remembers.
+  vtpc_set_policy("s3-fifo");
+  const int cold = vt::open_random("/tmp/policy_scan");
+  const uint64_t ghosts = vt::stats().ghost_hits;
+  scan(cold, scan_pages);
+  for (size_t i = scan_pages; i > scan_pages / 2; --i) {
+    scan(cold, i, i - 1);
+  }
+  vtpc_close(cold);
+  if (vt::stats().ghost_hits == ghosts) {
+    throw vt::exception() << "no miss found an evicted block in the ghost";
+  }
+
+  const uint64_t misses = misses_at_small_capacity();
+  if (misses != working_pages + rounds) {
+    throw vt::exception() << "a " << small_pages << "-page cache missed "
+                          << misses << " times, expected "
+                          << working_pages + rounds;
+  }
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
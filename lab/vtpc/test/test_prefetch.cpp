@@ -0,0 +1,201 @@
+#include <sys/types.h>
+
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "exception.hpp"
+#include "file.hpp"
+#include "vtpc_file.hpp"
+#include "workload.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+constexpr size_t page = 4096;
+constexpr const char* path = "/tmp/prefetch";
+
+auto fill(size_t pages) -> std::string {
+  std::string content(page * pages, ' ');
+  for (size_t i = 0; i < content.size(); ++i) {
+    content[i] = static_cast<char>('a' + (i / page % 26));
+  }
+
+  auto vtpc = vt::file::open_vtpc(path);
+  vtpc->seek(0);
+  vtpc->write(content);
+  vtpc->sync();
+  return content;
+}
+
+auto open_cold() -> int {
+  return vt::open_or_throw(path, O_RDONLY);
+}
+
+auto read_at(int fd, const std::string& content, off_t offset, size_t count)
+    -> void {
+  std::string actual(count, 0);
+  if (vtpc_lseek(fd, offset, SEEK_SET) != offset ||
+      vtpc_read(fd, actual.data(), count) != static_cast<ssize_t>(count)) {
+    throw vt::exception() << "failed to read " << count << " bytes at "
+                          << offset;
+  }
+  if (actual != content.substr(offset, count)) {
+    throw vt::exception() << "content differs at " << offset;
+  }
+}
+
+auto test_explicit() -> void {
+  constexpr size_t pages = 16;
+  const std::string content = fill(pages);
+  const int fd = open_cold();
+  const vtpc_stats before = vt::stats();
+
+  if (vtpc_prefetch(fd, 0, content.size()) != 0 ||
+      vtpc_prefetch(fd, 0, content.size()) != 0) {
+    throw vt::exception() << "vtpc_prefetch failed";
+  }
+  read_at(fd, content, 0, content.size());
+
+  const vtpc_stats after = vt::stats();
+  if (after.prefetch_issued - before.prefetch_issued != pages) {
+    throw vt::exception() << "expected " << pages << " prefetches, got "
+                          << after.prefetch_issued - before.prefetch_issued;
+  }
+  if (after.misses != before.misses) {
+    throw vt::exception() << "read missed " << after.misses - before.misses
+                          << " prefetched pages";
+  }
+
+  std::cout << "explicit: hits " << after.hits - before.hits << ", waits "
+            << after.prefetch_waits - before.prefetch_waits << '\n';
+  vtpc_close(fd);
+}
+
+auto test_stride() -> void {
+  constexpr size_t pages = 96;
+  constexpr size_t record = 64;
+  constexpr off_t stride = 3 * page + 512;
+  const std::string content = fill(pages);
+  const int fd = open_cold();
+  const vtpc_stats before = vt::stats();
+
+  size_t reads = 0;
+  for (off_t offset = 0; offset + record <= content.size(); offset += stride) {
+    read_at(fd, content, offset, record);
+    reads += 1;
+  }
+
+  const vtpc_stats after = vt::stats();
+  const uint64_t misses = after.misses - before.misses;
+  const uint64_t used = after.predict_used - before.predict_used;
+  if (used == 0 || misses >= reads / 2) {
+    throw vt::exception() << "stride reads missed " << misses << " of "
+                          << reads << " records";
+  }
+
+  std::cout << "stride: issued " << after.predict_issued - before.predict_issued
+            << ", used " << used << ", misses " << misses << '\n';
+  vtpc_close(fd);
+}
+
+auto test_chain() -> void {
+  constexpr size_t pages = 512;
+  constexpr size_t chain = 400;
+  const std::string content = fill(pages);
+  const int fd = open_cold();
+
+  const vt::workload::stream order =
+      vt::workload::shuffled({.blocks = pages, .block_size = page}, chain);
+
+  for (const vt::workload::access& access : order) {
+    read_at(fd, content, access.offset, 8);
+  }
+  const vtpc_stats before = vt::stats();
+  for (const vt::workload::access& access : order) {
+    read_at(fd, content, access.offset, 8);
+  }
+
+  const vtpc_stats after = vt::stats();
+  const uint64_t used = after.predict_used - before.predict_used;
+  if (used < chain / 2) {
+    throw vt::exception() << "chain prefetches used " << used << " of "
+                          << chain << " reads";
+  }
+
+  std::cout << "chain: issued " << after.predict_issued - before.predict_issued
+            << ", used " << used << ", misses " << after.misses - before.misses
+            << '\n';
+  vtpc_close(fd);
+}
+
+auto test_advice() -> void {
+  constexpr size_t pages = 16;
+  const std::string content = fill(pages);
+  const int fd = open_cold();
+
+  vtpc_stats before = vt::stats();
+  if (vtpc_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED) != 0) {
+    throw vt::exception() << "vtpc_fadvise(WILLNEED) failed";
+  }
+  read_at(fd, content, 0, content.size());
+  vtpc_stats after = vt::stats();
+  if (after.misses != before.misses) {
+    throw vt::exception() << "WILLNEED range missed "
+                          << after.misses - before.misses << " pages";
+  }
+
+  before = after;
+  if (vtpc_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) != 0 ||
+      vtpc_fadvise(fd, 0, 0, POSIX_FADV_RANDOM) != 0) {
+    throw vt::exception() << "vtpc_fadvise(DONTNEED, RANDOM) failed";
+  }
+  for (size_t i = 0; i < pages; ++i) {
+    read_at(fd, content, static_cast<off_t>(i * page), page);
+  }
+  after = vt::stats();
+  if (after.misses - before.misses != pages ||
+      after.predict_issued != before.predict_issued) {
+    throw vt::exception() << "RANDOM after DONTNEED missed "
+                          << after.misses - before.misses << " pages, issued "
+                          << after.predict_issued - before.predict_issued;
+  }
+
+  before = after;
+  if (vtpc_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) != 0 ||
+      vtpc_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL) != 0) {
+    throw vt::exception() << "vtpc_fadvise(DONTNEED, SEQUENTIAL) failed";
+  }
+  for (size_t i = 0; i < pages; ++i) {
+    read_at(fd, content, static_cast<off_t>(i * page), page);
+  }
+  after = vt::stats();
+  if (after.misses - before.misses != 1) {
+    throw vt::exception() << "SEQUENTIAL read missed "
+                          << after.misses - before.misses << " pages";
+  }
+
+  std::cout << "advice: sequential waits "
+            << after.prefetch_waits - before.prefetch_waits << '\n';
+  vtpc_close(fd);
+}
+
+}  // namespace
+
+auto main() -> int try {
+  test_explicit();
+  test_stride();
+  test_chain();
+  test_advice();
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
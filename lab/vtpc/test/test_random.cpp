@@ -12,13 +12,29 @@
 #include "cmp_file.hpp"
 #include "file.hpp"
 #include "log_file.hpp"
+#include "workload.hpp"
 
 auto main() -> int try {
   constexpr size_t seed = 1;
   constexpr size_t steps = (1U << 16U);
-  constexpr size_t size = (1U << 12U);
+  constexpr size_t block = (1U << 12U);
+  constexpr size_t blocks = (1U << 9U);
+  constexpr size_t size = block * blocks;
   constexpr size_t interval = 100;
 
+  // Seeks follow a skewed, a hot-spot and a sequential workload at once, so
+  // that the file, twice the cache, both hits and gets evicted.
+  const vt::workload::shape shape{.blocks = blocks, .block_size = block};
+  const vt::workload::stream seeks = vt::workload::mix(
+      {
+          {0.5, vt::workload::zipfian(shape, steps, 0.99)},       // NOLINT
+          {0.3, vt::workload::hotspot(shape, steps, 0.05, 0.9)},  // NOLINT
+          {0.2, vt::workload::sequential(shape, blocks)},         // NOLINT
+      },
+      steps,
+      seed
+  );
+
   std::unique_ptr<vt::file> file = [] {
     auto libc = vt::file::open_libc("/tmp/a");
     auto vtpc = vt::file::open_vtpc("/tmp/b");
@@ -30,8 +46,8 @@ auto main() -> int try {
   std::default_random_engine random(seed);  // NOLINT
 
   std::uniform_int_distribution<size_t> action_dist(0, 100);  // NOLINT
-  std::uniform_int_distribution<off_t> offset_dist(0, size);
-  std::uniform_int_distribution<size_t> batch_dist(0, size / 4);
+  std::uniform_int_distribution<off_t> offset_dist(0, block - 1);
+  std::uniform_int_distribution<size_t> batch_dist(0, block);
   std::uniform_int_distribution<uint8_t> char_dist(0);
 
   const auto random_string = [&](size_t size) {
@@ -60,7 +76,7 @@ auto main() -> int try {
         size_t batch = batch_dist(random);
         file->write(random_string(batch));
       } else if (point < 95) {  // NOLINT
-        file->seek(offset_dist(random));
+        file->seek(seeks[i].offset + offset_dist(random));
       } else {
         file->sync();
       }
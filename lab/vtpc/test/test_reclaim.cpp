@@ -0,0 +1,159 @@
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "exception.hpp"
+#include "vtpc_file.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+constexpr size_t page = 4096;
+constexpr size_t hot_pages = 64;
+constexpr size_t scan_pages = 1024;
+constexpr size_t readers = 4;
+constexpr size_t reads = 20000;
+constexpr size_t writes = 5000;
+
+// A page starts with its index and is filled with the generation it was
+// written in, so a copy mixing two writes or two pages shows.
+auto fill(std::string& buffer, uint64_t index, char generation) -> void {
+  buffer.assign(page, generation);
+  std::memcpy(buffer.data(), &index, sizeof(index));
+}
+
+auto consistent(const std::string& buffer, uint64_t index) -> bool {
+  uint64_t stored = 0;
+  std::memcpy(&stored, buffer.data(), sizeof(stored));
+  const char generation = buffer[sizeof(stored)];
+  return stored == index &&
+         buffer.find_first_not_of(generation, sizeof(stored)) ==
+             std::string::npos;
+}
+
+auto write_page(int fd, uint64_t index, char generation) -> void {
+  std::string buffer;
+  fill(buffer, index, generation);
+  const auto offset = static_cast<off_t>(index * page);
+  if (vtpc_lseek(fd, offset, SEEK_SET) != offset ||
+      vtpc_write(fd, buffer.data(), page) != static_cast<ssize_t>(page)) {
+    throw vt::exception() << "failed to write page " << index;
+  }
+}
+
+// Writes the pages through the cache, each filled as by fill, and flushes
+// them.
+auto populate(const char* path, size_t pages) -> void {
+  const int fd = vt::open_random(path, O_RDWR | O_CREAT | O_TRUNC);
+  for (size_t i = 0; i < pages; ++i) {
+    write_page(fd, i, 'a');
+  }
+  if (vtpc_fsync(fd) != 0 || vtpc_close(fd) != 0) {
+    throw vt::exception() << "failed to flush " << path;
+  }
+}
+
+}  // namespace
+
+auto main() -> int try {
+  populate("/tmp/reclaim_hot", hot_pages);
+  populate("/tmp/reclaim_scan", scan_pages);
+
+  // Readers copy hot pages without the cache lock while a writer rewrites
+  // them and a scan keeps evicting them, and must never see a mix.
+  std::atomic<size_t> torn = 0;
+  std::atomic<bool> failed = false;
+  std::vector<std::thread> threads;
+  for (size_t r = 0; r < readers; ++r) {
+    threads.emplace_back([&, r] {
+      const int fd = vtpc_open("/tmp/reclaim_hot", O_RDONLY, 0);
+      std::string buffer(page, 0);
+      for (size_t i = 0; i < reads && fd >= 0; ++i) {
+        const uint64_t index = (i * 31 + r * 7) % hot_pages;
+        const auto offset = static_cast<off_t>(index * page);
+        if (vtpc_lseek(fd, offset, SEEK_SET) != offset ||
+            vtpc_read(fd, buffer.data(), page) != static_cast<ssize_t>(page)) {
+          failed = true;
+          break;
+        }
+        if (!consistent(buffer, index)) {
+          torn += 1;
+        }
+      }
+      failed = failed || fd < 0;
+      vtpc_close(fd);
+    });
+  }
+  threads.emplace_back([&] {
+    const int fd = vtpc_open("/tmp/reclaim_hot", O_WRONLY, 0);
+    for (size_t i = 0; i < writes && fd >= 0; ++i) {
+      write_page(fd, i % hot_pages, static_cast<char>('b' + (i % 16)));
+    }
+    failed = failed || fd < 0;
+    vtpc_close(fd);
+  });
+  threads.emplace_back([&] {
+    const int fd = vtpc_open("/tmp/reclaim_scan", O_RDONLY, 0);
+    std::string buffer(page, 0);
+    for (size_t pass = 0; pass < 8 && fd >= 0; ++pass) {
+      for (size_t i = 0; i < scan_pages; ++i) {
+        if (vtpc_read(fd, buffer.data(), page) != static_cast<ssize_t>(page)) {
+          failed = true;
+          break;
+        }
+      }
+      vtpc_lseek(fd, 0, SEEK_SET);
+    }
+    failed = failed || fd < 0;
+    vtpc_close(fd);
+  });
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  if (failed) {
+    throw vt::exception() << "a thread failed to read or write";
+  }
+  if (torn != 0) {
+    throw vt::exception() << torn << " reads saw a torn page";
+  }
+  const vtpc_stats after = vt::stats();
+  if (after.optimistic_reads == 0 || after.evictions == 0) {
+    throw vt::exception() << "no reads ran without the lock during eviction";
+  }
+
+  // With no reader left, the next miss recycles every retired frame. The
+  // scan has long evicted its first page.
+  const int fd = vt::open_random("/tmp/reclaim_scan");
+  std::string buffer(page, 0);
+  if (vtpc_read(fd, buffer.data(), page) != static_cast<ssize_t>(page) ||
+      !consistent(buffer, 0)) {
+    throw vt::exception() << "failed to read /tmp/scan";
+  }
+  const uint64_t retired = vt::stats().retired_frames;
+  vtpc_close(fd);
+  if (retired != 0) {
+    throw vt::exception() << "retired frames were not recycled";
+  }
+
+  std::cout << after.optimistic_reads << " reads without the lock, "
+            << after.optimistic_retries << " redone\n";
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
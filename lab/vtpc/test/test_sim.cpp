@@ -0,0 +1,149 @@
+#include <sys/types.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "exception.hpp"
+#include "vtpc_file.hpp"
+
+extern "C" {
+#include <unistd.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+constexpr size_t page = 4096;
+constexpr size_t hot_pages = 64;
+constexpr size_t scan_pages = 4096;
+constexpr size_t rounds = 32;
+constexpr size_t small = 96;
+constexpr size_t large = 8192;
+constexpr const char* hot_path = "/tmp/sim_hot";
+constexpr const char* scan_path = "/tmp/sim_scan";
+constexpr const char* trace_path = "/tmp/sim.trace";
+
+auto read_page(int fd, size_t index) -> void {
+  std::string buffer(page, 0);
+  const auto offset = static_cast<off_t>(index * page);
+  if (vtpc_lseek(fd, offset, SEEK_SET) != offset ||
+      vtpc_read(fd, buffer.data(), page) != static_cast<ssize_t>(page)) {
+    throw vt::exception() << "failed to read page " << index;
+  }
+}
+
+// Traces a hot set read twice a round between runs of a scan that never
+// comes back, so that each round evicts the hot set from an LRU cache a
+// little larger than it.
+auto record() -> void {
+  vt::create(hot_path, hot_pages * page);
+  vt::create(scan_path, scan_pages * page);
+  const int hot = vt::open_random(hot_path);
+  const int scan = vt::open_random(scan_path);
+  if (vtpc_trace_start(trace_path) != 0) {
+    throw vt::exception() << "failed to trace to " << trace_path;
+  }
+  const size_t run = scan_pages / rounds;
+  for (size_t round = 0; round < rounds; ++round) {
+    for (size_t pass = 0; pass < 2; ++pass) {
+      for (size_t i = 0; i < hot_pages; ++i) {
+        read_page(hot, i);
+      }
+    }
+    for (size_t i = 0; i < run; ++i) {
+      read_page(scan, (round * run) + i);
+    }
+  }
+  if (vtpc_trace_stop() != 0) {
+    throw vt::exception() << "failed to stop tracing";
+  }
+  vtpc_close(scan);
+  vtpc_close(hot);
+}
+
+// Runs vtpc_sim on the trace and returns the hit ratios of each policy at
+// the small and the large capacity, by column name.
+auto simulate() -> std::map<std::string, std::vector<double>> {
+  const std::string command = std::string(VTPC_SIM) + " " + trace_path +
+                              " " + std::to_string(small) + " " +
+                              std::to_string(large);
+  FILE* pipe = popen(command.c_str(), "r");
+  if (pipe == nullptr) {
+    throw vt::exception() << "failed to run " << command;
+  }
+  std::string output;
+  char buffer[256];
+  while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
+    output += buffer;
+  }
+  if (pclose(pipe) != 0) {
+    throw vt::exception() << command << " failed";
+  }
+  std::cout << output;
+
+  std::istringstream lines(output);
+  std::string line;
+  std::getline(lines, line);
+  std::getline(lines, line);
+  std::istringstream header(line);
+  std::vector<std::string> names;
+  for (std::string name; header >> name;) {
+    names.push_back(name);
+  }
+  std::map<std::string, std::vector<double>> ratios;
+  while (std::getline(lines, line)) {
+    std::istringstream row(line);
+    for (const std::string& name : names) {
+      double value = 0;
+      row >> value;
+      ratios[name].push_back(value);
+    }
+  }
+  if (names.size() != 7 || ratios["capacity"].size() != 2) {
+    throw vt::exception() << "unexpected output of vtpc_sim";
+  }
+  return ratios;
+}
+
+}  // namespace
+
+auto main() -> int try {
+  record();
+  const auto ratios = simulate();
+
+  // With room for every page, each policy misses only the first access to
+  // each of them.
+  const size_t events = rounds * ((2 * hot_pages) + (scan_pages / rounds));
+  const double compulsory =
+      1 - (static_cast<double>(hot_pages + scan_pages) / events);
+  for (const auto& [name, column] : ratios) {
+    if (name != "capacity" && name != "MiB" &&
+        std::abs(column[1] - compulsory) > 1e-3) {
+      throw vt::exception() << name << " hits " << column[1] << " at "
+                            << large << " pages, not " << compulsory;
+    }
+  }
+
+  // The scan pushes the hot set out of LRU every round; CLOCK-Pro and
+  // S3-FIFO let scanned blocks go first and keep most of it.
+  const double lru = ratios.at("LRU")[0];
+  for (const char* name : {"CLOCK-Pro", "S3-FIFO"}) {
+    if (ratios.at(name)[0] < lru + 0.1) {
+      throw vt::exception() << name << " hits " << ratios.at(name)[0]
+                            << " at " << small << " pages, LRU " << lru;
+    }
+  }
+  unlink(trace_path);
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
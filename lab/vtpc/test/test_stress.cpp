@@ -0,0 +1,226 @@
+#include <sys/types.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "cmp_file.hpp"
+#include "exception.hpp"
+#include "file.hpp"
+#include "memory_file.hpp"
+#include "workload.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+}
+
+namespace {
+
+constexpr const char* path = "/tmp/stress";
+constexpr size_t threads = 8;
+constexpr size_t ops = 50000;
+constexpr size_t verify_every = 1000;
+constexpr size_t max_op = 8192;
+
+// Each thread owns a region, and all of them share a few more. Regions do
+// not end on page boundaries, so neighbours write the same pages, and the
+// file is larger than the cache, so pages are evicted while in use.
+constexpr size_t own_size = (40 * 4096) + 1000;
+constexpr size_t shared_regions = 4;
+constexpr size_t shared_size = 12000;
+constexpr size_t file_size =
+    (threads * own_size) + (shared_regions * shared_size);
+
+struct region {
+  size_t offset;
+  size_t size;
+};
+
+auto own_region(size_t thread) -> region {
+  return {thread * own_size, own_size};
+}
+
+auto shared_region(size_t index) -> region {
+  return {(threads * own_size) + (index * shared_size), shared_size};
+}
+
+// Accesses to a shared region hold its lock across the model and vtpc, so
+// both see the writes in the same order.
+std::array<std::mutex, shared_regions> shared_locks;
+
+// Starts of accesses anywhere in the region, at byte granularity, half of
+// them writes.
+auto region_accesses(region region, size_t count, uint64_t seed)
+    -> vt::workload::stream {
+  const vt::workload::shape shape{
+      .blocks = region.size,
+      .block_size = 1,
+      .write_ratio = 0.5,
+      .seed = seed,
+  };
+  vt::workload::stream accesses = vt::workload::uniform(shape, count);
+  for (vt::workload::access& access : accesses) {
+    access.offset += static_cast<off_t>(region.offset);
+  }
+  return accesses;
+}
+
+// The thread's accesses: 60% in its own region, the rest spread evenly over
+// the shared ones.
+auto thread_accesses(size_t thread) -> vt::workload::stream {
+  const uint64_t seed = (thread + 1) * (shared_regions + 1);
+  std::vector<std::pair<double, vt::workload::stream>> parts;
+  parts.emplace_back(0.6, region_accesses(own_region(thread), ops, seed));
+  for (size_t i = 0; i < shared_regions; ++i) {
+    parts.emplace_back(
+        0.4 / shared_regions,
+        region_accesses(shared_region(i), ops, seed + i + 1)
+    );
+  }
+  return vt::workload::mix(parts, ops, seed);
+}
+
+// The shared region an access of thread_accesses falls in, or none if it
+// is in the thread's own.
+auto shared_index(off_t offset) -> std::optional<size_t> {
+  const auto at = static_cast<size_t>(offset);
+  if (at < threads * own_size) {
+    return std::nullopt;
+  }
+  return (at - (threads * own_size)) / shared_size;
+}
+
+auto verify(vt::cmp_file& file, region region) -> void {
+  file.seek(static_cast<off_t>(region.offset));
+  file.read(region.size);
+}
+
+// Runs random positional reads and writes within the thread's own region
+// and the shared ones, checks every read against the model, and rereads
+// whole regions now and then. Returns the bytes moved.
+auto stress(vt::cmp_file& file, size_t thread) -> uint64_t {
+  const vt::workload::stream accesses = thread_accesses(thread);
+  std::mt19937_64 random(thread + 1);
+  std::uniform_int_distribution<size_t> shift(0, max_op);
+  std::uniform_int_distribution<int> bytes(0, 255);
+  // Writes copy random bytes from a pool at a random shift, which is far
+  // cheaper than drawing each of them.
+  std::string pool(2 * max_op, 0);
+  std::generate(pool.begin(), pool.end(), [&] {
+    return static_cast<char>(bytes(random));
+  });
+  std::string data(max_op, 0);
+
+  uint64_t moved = 0;
+  for (size_t i = 0; i < ops; ++i) {
+    const vt::workload::access& access = accesses[i];
+    const std::optional<size_t> index = shared_index(access.offset);
+    const region region = index ? shared_region(*index) : own_region(thread);
+    const size_t end = region.offset + region.size;
+    const size_t count = std::uniform_int_distribution<size_t>(
+        1, std::min(max_op, end - static_cast<size_t>(access.offset))
+    )(random);
+    if (access.write) {
+      std::copy_n(pool.begin() + shift(random), count, data.begin());
+    }
+
+    std::unique_lock<std::mutex> lock;
+    if (index) {
+      lock = std::unique_lock(shared_locks[*index]);
+    }
+    file.seek(access.offset);
+    if (access.write) {
+      file.write(data.data(), count);
+    } else {
+      file.read(data.data(), count);
+    }
+    moved += count;
+
+    if (i % verify_every == verify_every - 1) {
+      verify(file, region);
+    }
+  }
+  verify(file, own_region(thread));
+  return moved;
+}
+
+}  // namespace
+
+auto main() -> int try {
+  auto model = std::make_shared<std::string>(file_size, 'x');
+  {
+    const int raw = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (raw < 0 || write(raw, model->data(), model->size()) !=
+                       static_cast<ssize_t>(model->size())) {
+      throw vt::exception() << "failed to create " << path;
+    }
+    close(raw);
+  }
+
+  std::atomic<uint64_t> moved = 0;
+  std::mutex failure_lock;
+  std::string failure;
+  std::vector<std::thread> workers;
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      try {
+        vt::cmp_file file(
+            std::make_unique<vt::memory_file>(model),
+            vt::file::open_vtpc(path)
+        );
+        moved += stress(file, t);
+        file.sync();
+      } catch (const std::exception& e) {
+        const std::lock_guard lock(failure_lock);
+        failure = "thread " + std::to_string(t) + ": " + e.what();
+      }
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  if (!failure.empty()) {
+    throw vt::exception() << failure;
+  }
+
+  // With every handle closed, the file itself must match the model.
+  std::string content(file_size, 0);
+  const int raw = open(path, O_RDONLY);
+  if (raw < 0 || read(raw, content.data(), content.size()) !=
+                     static_cast<ssize_t>(content.size())) {
+    throw vt::exception() << "failed to read back " << path;
+  }
+  close(raw);
+  if (content != *model) {
+    const auto diff =
+        std::mismatch(content.begin(), content.end(), model->begin());
+    throw vt::exception() << "the file differs from the model at byte "
+                          << diff.first - content.begin();
+  }
+
+  const auto total = static_cast<double>(threads * ops);
+  std::cout << threads << " threads: " << total / elapsed.count()
+            << " ops/s, " << static_cast<double>(moved) / elapsed.count() / 1e6
+            << " MB/s\n";
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
@@ -0,0 +1,132 @@
+#include <sys/types.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "exception.hpp"
+#include "file.hpp"
+#include "histogram.hpp"
+#include "memory_file.hpp"
+#include "timed_file.hpp"
+
+namespace {
+
+constexpr uint64_t values = 100000;
+constexpr size_t threads = 4;
+constexpr size_t ops = 1 << 20;
+constexpr size_t record = 16;
+constexpr size_t runs = 5;
+constexpr uint64_t every = 64;
+
+// Percentiles of 1, 2, ..., values are known, and each must come out of a
+// bucket no wider than 1/32 of it.
+auto check_precision() -> void {
+  vt::histogram histogram;
+  for (uint64_t v = 1; v <= values; ++v) {
+    histogram.record(v);
+  }
+  for (const double p : {0.001, 0.1, 0.5, 0.9, 0.99, 0.999, 1.0}) {
+    const auto exact = static_cast<uint64_t>(p * values);
+    const uint64_t found = histogram.percentile(p);
+    if (found < exact || found > exact + (exact / 32)) {
+      throw vt::exception() << "p" << p * 100 << " is " << found
+                            << ", expected " << exact;
+    }
+  }
+  const double mean = (values + 1) / 2.0;
+  if (histogram.count() != values || histogram.max() < values ||
+      histogram.max() > values + (values / 32) ||
+      std::abs(histogram.mean() - mean) > mean / 64) {
+    throw vt::exception() << "wrong count, max or mean";
+  }
+}
+
+auto check_concurrent() -> void {
+  vt::histogram histogram;
+  std::vector<std::thread> recorders;
+  for (size_t t = 0; t < threads; ++t) {
+    recorders.emplace_back([&, t] {
+      for (uint64_t v = 0; v < values; ++v) {
+        histogram.record((v * (t + 1)) % 5000);
+      }
+    });
+  }
+  for (std::thread& recorder : recorders) {
+    recorder.join();
+  }
+  if (histogram.count() != threads * values) {
+    throw vt::exception() << "recorded " << histogram.count() << " of "
+                          << threads * values;
+  }
+}
+
+// Small reads from memory take a few nanoseconds, so the difference of the
+// runs with and without the timer is its overhead. The fastest of a few
+// runs is taken, to leave out other work on the machine. The overhead is
+// only reported: it depends on the clock source, the build and the load,
+// none of which a test run controls.
+auto run(vt::file& file) -> double {
+  std::string buffer(record, 0);
+  double best = 0;
+  for (size_t r = 0; r < runs; ++r) {
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < ops; ++i) {
+      file.seek(static_cast<off_t>((i * 7 % 1024) * record));
+      file.read(buffer.data(), record);
+    }
+    const std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    const double per_op = elapsed.count() / (2 * ops);
+    best = r == 0 ? per_op : std::min(best, per_op);
+  }
+  return best;
+}
+
+}  // namespace
+
+auto main() -> int try {
+  check_precision();
+  check_concurrent();
+
+  auto data = std::make_shared<std::string>(1024 * record, 'x');
+  vt::memory_file bare(data);
+  vt::timed_file timed(std::make_unique<vt::memory_file>(data));
+  vt::timed_file sampled(std::make_unique<vt::memory_file>(data), every);
+  timed.write(std::string(record, 'y'));
+  timed.sync();
+  const double plain = run(bare);
+  const double all = run(timed) - plain;
+  const double some = run(sampled) - plain;
+  if (timed.reads().count() != runs * ops ||
+      timed.seeks().count() != runs * ops || timed.writes().count() != 1 ||
+      timed.syncs().count() != 1) {
+    throw vt::exception() << "operations were not all recorded";
+  }
+  if (sampled.reads().count() != runs * ops / every ||
+      sampled.seeks().count() != runs * ops / every) {
+    throw vt::exception() << "recorded " << sampled.reads().count()
+                          << " sampled reads, expected "
+                          << runs * ops / every;
+  }
+  if (timed.reads().percentile(0.5) > timed.reads().max()) {
+    throw vt::exception() << "the median read exceeds the slowest";
+  }
+
+  timed.print(std::cout);
+  sampled.print(std::cout);
+  std::cout << "overhead " << std::max(all, 0.0) << " ns per op timed, "
+            << std::max(some, 0.0) << " ns sampled 1 in " << every << '\n';
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
@@ -0,0 +1,180 @@
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "exception.hpp"
+#include "vtpc_file.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+constexpr size_t page = 4096;
+constexpr size_t pages = 64;
+constexpr const char* path = "/tmp/truncate";
+constexpr uint64_t latency_ns = 50 * 1000 * 1000;
+
+// Reads up to size bytes at offset through the descriptor.
+auto read_at(int fd, off_t offset, size_t size) -> std::string {
+  std::string text(size, 0);
+  if (vtpc_lseek(fd, offset, SEEK_SET) != offset) {
+    throw vt::exception() << "failed to seek to " << offset;
+  }
+  const ssize_t done = vtpc_read(fd, text.data(), size);
+  if (done < 0) {
+    throw vt::exception() << "failed to read at " << offset;
+  }
+  text.resize(done);
+  return text;
+}
+
+auto truncate_or_throw(int fd, off_t length) -> void {
+  if (vtpc_ftruncate(fd, length) != 0) {
+    throw vt::exception() << "failed to truncate to " << length;
+  }
+}
+
+// Flushes the file and compares what is on disk with the content.
+auto check_disk(int fd, const std::string& content) -> void {
+  if (vtpc_fsync(fd) != 0) {
+    throw vt::exception() << "vtpc_fsync failed";
+  }
+  struct stat st {};
+  const int raw = open(path, O_RDONLY);
+  std::string disk(content.size(), 0);
+  if (raw < 0 || fstat(raw, &st) != 0 ||
+      pread(raw, disk.data(), disk.size(), 0) !=
+          static_cast<ssize_t>(disk.size())) {
+    throw vt::exception() << "failed to read " << path;
+  }
+  close(raw);
+  if (static_cast<size_t>(st.st_size) != content.size() || disk != content) {
+    throw vt::exception() << "disk holds " << st.st_size
+                          << " bytes, not the content";
+  }
+}
+
+// Opens the file with O_TRUNC while an fsync of its dirty pages waits on a
+// slow device. The write in flight must land before the file is cut, not
+// grow it again after.
+auto truncate_in_flight() -> void {
+  const vtpc_device device{
+      .latency_ns = latency_ns,
+      .distribution = VTPC_LATENCY_FIXED,
+      .bandwidth = 0,
+      .depth = 1,
+      .iops = 0,
+      .seed = 1,
+  };
+  if (vtpc_set_device(&device) != 0) {
+    throw vt::exception() << "vtpc_set_device failed";
+  }
+  const int fd = vt::open_or_throw(path, O_RDWR | O_TRUNC);
+  const std::string content(pages * page, 'y');
+  if (vtpc_write(fd, content.data(), content.size()) !=
+      static_cast<ssize_t>(content.size())) {
+    throw vt::exception() << "failed to write " << path;
+  }
+  std::thread flusher([fd] { vtpc_fsync(fd); });
+  std::this_thread::sleep_for(std::chrono::nanoseconds(latency_ns / 5));
+  const int again = vt::open_or_throw(path, O_RDWR | O_TRUNC);
+  flusher.join();
+  if (vtpc_lseek(again, 0, SEEK_END) != 0) {
+    throw vt::exception() << "O_TRUNC left the cached file non-empty";
+  }
+  vtpc_close(again);
+  vtpc_close(fd);
+
+  struct stat st {};
+  if (stat(path, &st) != 0 || st.st_size != 0) {
+    throw vt::exception() << "a write in flight grew the truncated file to "
+                          << st.st_size << " bytes";
+  }
+}
+
+}  // namespace
+
+auto main() -> int try {
+  const int fd = vtpc_open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || vtpc_fadvise(fd, 0, 0, POSIX_FADV_RANDOM) != 0) {
+    throw vt::exception() << "failed to open " << path;
+  }
+  std::string content(pages * page, 'x');
+  if (vtpc_write(fd, content.data(), content.size()) !=
+      static_cast<ssize_t>(content.size())) {
+    throw vt::exception() << "failed to write " << path;
+  }
+
+  // Seeks relative to the position and to the cached end of file.
+  const auto size = static_cast<off_t>(content.size());
+  if (vtpc_lseek(fd, -10, SEEK_END) != size - 10 ||
+      vtpc_lseek(fd, 4, SEEK_CUR) != size - 6 ||
+      vtpc_lseek(fd, -1, SEEK_SET) != -1 || errno != EINVAL) {
+    throw vt::exception() << "relative seeks failed";
+  }
+
+  // Cutting the dirty file leaves the blocks past the end stale without
+  // dropping them, and none of them reaches the disk.
+  const vtpc_stats before = vt::stats();
+  const auto cut = static_cast<off_t>((10 * page) + 100);
+  truncate_or_throw(fd, cut);
+  content.resize(cut);
+  if (vt::stats().evictions != before.evictions) {
+    throw vt::exception() << "truncation visited the cached blocks";
+  }
+  if (vtpc_lseek(fd, 0, SEEK_END) != cut ||
+      !read_at(fd, 20 * page, page).empty() ||
+      read_at(fd, 10 * page, page) != content.substr(10 * page)) {
+    throw vt::exception() << "reads see past the new end";
+  }
+
+  // Growing the file again shows zeros, not the stale blocks.
+  truncate_or_throw(fd, static_cast<off_t>(pages * page));
+  content.resize(pages * page, '\0');
+  if (read_at(fd, 0, content.size()) != content) {
+    throw vt::exception() << "grown file shows stale blocks";
+  }
+  check_disk(fd, content);
+
+  // A write past a cut lands in a fresh block, and a later cut above it
+  // keeps it.
+  truncate_or_throw(fd, static_cast<off_t>(page));
+  content.resize(page);
+  const std::string text = "after the cut";
+  const auto offset = static_cast<off_t>(30 * page);
+  if (vtpc_lseek(fd, offset, SEEK_SET) != offset ||
+      vtpc_write(fd, text.data(), text.size()) !=
+          static_cast<ssize_t>(text.size())) {
+    throw vt::exception() << "failed to write past the cut";
+  }
+  content.resize(offset, '\0');
+  content += text;
+  truncate_or_throw(fd, static_cast<off_t>(40 * page));
+  content.resize(40 * page, '\0');
+  if (read_at(fd, 0, content.size()) != content) {
+    throw vt::exception() << "write past the cut was lost";
+  }
+  check_disk(fd, content);
+  vtpc_close(fd);
+
+  truncate_in_flight();
+
+  std::cout << "truncated without visiting cached blocks\n";
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
@@ -0,0 +1,114 @@
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "exception.hpp"
+#include "vtpc_file.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "manifest.h"
+#include "vtpc.h"
+}
+
+namespace {
+
+constexpr size_t page = 4096;
+constexpr size_t pages = 128;
+constexpr size_t hot = 32;
+constexpr const char* manifest = "/tmp/vtpc.manifest";
+constexpr const char* path = "/tmp/warm";
+
+// Opens the file and reads the hot pages, every fourth one from the end.
+auto read_hot(const std::string& content) -> int {
+  const int fd = vtpc_open(path, O_RDONLY, 0);
+  if (fd < 0 || vtpc_fadvise(fd, 0, 0, POSIX_FADV_RANDOM) != 0) {
+    throw vt::exception() << "failed to open " << path;
+  }
+  std::string actual(page, 0);
+  for (size_t i = 0; i < hot; ++i) {
+    const auto offset = static_cast<off_t>((pages - 1 - (4 * i)) * page);
+    if (vtpc_lseek(fd, offset, SEEK_SET) != offset ||
+        vtpc_read(fd, actual.data(), page) != static_cast<ssize_t>(page)) {
+      throw vt::exception() << "failed to read at " << offset;
+    }
+    if (actual != content.substr(offset, page)) {
+      throw vt::exception() << "content differs at " << offset;
+    }
+  }
+  return fd;
+}
+
+}  // namespace
+
+auto main() -> int try {
+  std::string content(pages * page, ' ');
+  for (size_t i = 0; i < content.size(); ++i) {
+    content[i] = static_cast<char>('a' + ((i / page + i) % 26));
+  }
+  const int raw = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (raw < 0 || write(raw, content.data(), content.size()) !=
+                     static_cast<ssize_t>(content.size())) {
+    throw vt::exception() << "failed to create " << path;
+  }
+  close(raw);
+
+  unlink(manifest);
+  if (vtpc_manifest_open(manifest) != 0) {
+    throw vt::exception() << "vtpc_manifest_open failed";
+  }
+
+  // The last close records the hot pages, and the manifest holds them.
+  vtpc_close(read_hot(content));
+  struct stat st {};
+  if (vtpc_manifest_save() != 0 || stat(manifest, &st) != 0 ||
+      static_cast<size_t>(st.st_size) !=
+          sizeof(vtpc_manifest_header) + sizeof(vtpc_manifest_file) +
+              (hot * sizeof(uint32_t))) {
+    throw vt::exception() << "manifest holds " << st.st_size << " bytes";
+  }
+  if (vtpc_manifest_open(manifest) != 0) {
+    throw vt::exception() << "failed to reload the manifest";
+  }
+
+  // Opening the file again loads them before they are asked for.
+  vtpc_stats before = vt::stats();
+  vtpc_close(read_hot(content));
+  vtpc_stats now = vt::stats();
+  if (now.warm_issued - before.warm_issued != hot ||
+      now.misses != before.misses) {
+    throw vt::exception() << "warm-up issued "
+                          << now.warm_issued - before.warm_issued
+                          << " loads, reads missed "
+                          << now.misses - before.misses << " times";
+  }
+
+  // A file changed since it was recorded is not warmed.
+  const int append = open(path, O_WRONLY | O_APPEND);
+  if (append < 0 || write(append, "!", 1) != 1) {
+    throw vt::exception() << "failed to change " << path;
+  }
+  close(append);
+  content += '!';
+  before = vt::stats();
+  vtpc_close(read_hot(content));
+  now = vt::stats();
+  if (now.warm_issued != before.warm_issued ||
+      now.misses - before.misses != hot) {
+    throw vt::exception() << "changed file was warmed";
+  }
+
+  unlink(manifest);
+  std::cout << "warmed " << hot << " pages\n";
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
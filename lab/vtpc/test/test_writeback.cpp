@@ -0,0 +1,99 @@
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "exception.hpp"
+#include "vtpc_file.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+constexpr size_t page = 4096;
+constexpr size_t pages = 256;
+constexpr const char* path = "/tmp/writeback";
+
+}  // namespace
+
+auto main() -> int try {
+  const int fd = vt::open_or_throw(path, O_RDWR | O_CREAT | O_TRUNC);
+
+  // Pages dirtied out of order reach the disk sorted and merged.
+  std::string content(pages * page, 0);
+  const vtpc_stats before = vt::stats();
+  for (size_t i = 0; i < pages; ++i) {
+    const size_t index = (i * 37) % pages;
+    const auto offset = static_cast<off_t>(index * page);
+    content.replace(offset, page, page, static_cast<char>('a' + index % 26));
+    if (vtpc_lseek(fd, offset, SEEK_SET) != offset ||
+        vtpc_write(fd, content.data() + offset, page) !=
+            static_cast<ssize_t>(page)) {
+      throw vt::exception() << "failed to write page " << index;
+    }
+  }
+  if (vtpc_fsync(fd) != 0) {
+    throw vt::exception() << "vtpc_fsync failed";
+  }
+  const vtpc_stats now = vt::stats();
+  const uint64_t queued = now.writeback_queued - before.writeback_queued;
+  const uint64_t writes = now.writeback_writes - before.writeback_writes;
+  const uint64_t merged = now.writeback_merged - before.writeback_merged;
+  if (queued != pages || writes + merged != pages || writes * 4 > pages) {
+    throw vt::exception() << "queued " << queued << " pages, wrote them in "
+                          << writes << " writes";
+  }
+  if (now.writeback_depth_max == 0 || now.writeback_depth_max > 64) {
+    throw vt::exception() << "queue reached " << now.writeback_depth_max;
+  }
+
+  // Dropping a dirty range writes it back the same way, in few writes.
+  constexpr size_t dropped = 64;
+  const vtpc_stats dirtied = vt::stats();
+  for (size_t i = dropped; i > 0; --i) {
+    const auto offset = static_cast<off_t>((i - 1) * page);
+    content.replace(offset, page, page, 'z');
+    if (vtpc_lseek(fd, offset, SEEK_SET) != offset ||
+        vtpc_write(fd, content.data() + offset, page) !=
+            static_cast<ssize_t>(page)) {
+      throw vt::exception() << "failed to rewrite page " << i - 1;
+    }
+  }
+  if (vtpc_fadvise(fd, 0, dropped * page, POSIX_FADV_DONTNEED) != 0) {
+    throw vt::exception() << "vtpc_fadvise(DONTNEED) failed";
+  }
+  const uint64_t drops =
+      vt::stats().writeback_writes - dirtied.writeback_writes;
+  if (drops * 4 > dropped) {
+    throw vt::exception() << "DONTNEED wrote " << dropped << " pages in "
+                          << drops << " writes";
+  }
+
+  const int raw = open(path, O_RDONLY);
+  std::string disk(content.size(), 0);
+  if (raw < 0 || pread(raw, disk.data(), disk.size(), 0) !=
+                     static_cast<ssize_t>(disk.size())) {
+    throw vt::exception() << "failed to read " << path;
+  }
+  close(raw);
+  if (disk != content) {
+    throw vt::exception() << "content differs on disk";
+  }
+  vtpc_close(fd);
+
+  std::cout << "wrote " << queued << " pages in " << writes << " writes, "
+            << now.writeback_expired - before.writeback_expired
+            << " past deadline\n";
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
@@ -0,0 +1,132 @@
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "exception.hpp"
+#include "vtpc_file.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+constexpr size_t page = 4096;
+constexpr size_t pages = 64;
+constexpr size_t data_page = 32;
+constexpr size_t zeros_page = 48;
+constexpr const char* path = "/tmp/zero";
+constexpr const char* dense_path = "/tmp/zero_dense";
+
+// Reads every page of the file through the descriptor and compares it with
+// the expected content.
+auto check(int fd, const std::string& content) -> void {
+  std::string actual(page, 0);
+  for (size_t i = 0; i < pages; ++i) {
+    const auto offset = static_cast<off_t>(i * page);
+    if (vtpc_lseek(fd, offset, SEEK_SET) != offset ||
+        vtpc_read(fd, actual.data(), page) != static_cast<ssize_t>(page)) {
+      throw vt::exception() << "failed to read page " << i;
+    }
+    if (actual != content.substr(offset, page)) {
+      throw vt::exception() << "content differs at page " << i;
+    }
+  }
+}
+
+// A file without holes is read without probing for them, until a
+// truncation leaves a hole past its new end. Returns the holes skipped
+// when reading the blocks the truncation cut off and grew back.
+auto check_regrown() -> uint64_t {
+  constexpr size_t kept = pages / 2;
+  vt::create(dense_path, pages * page);
+  const int fd = vt::open_random(dense_path, O_RDWR);
+  if (vtpc_ftruncate(fd, static_cast<off_t>(kept * page)) != 0 ||
+      vtpc_ftruncate(fd, static_cast<off_t>(pages * page)) != 0) {
+    throw vt::exception() << "failed to truncate " << dense_path;
+  }
+  std::string content(pages * page, '\0');
+  content.replace(0, kept * page, kept * page, 'x');
+  const vtpc_stats before = vt::stats();
+  check(fd, content);
+  vtpc_close(fd);
+  return vt::stats().zero_holes - before.zero_holes;
+}
+
+}  // namespace
+
+auto main() -> int try {
+  // A sparse file with one page of data and one page of written zeros.
+  std::string content(pages * page, '\0');
+  content.replace(data_page * page, page, page, 'x');
+  const int raw = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (raw < 0 || ftruncate(raw, static_cast<off_t>(content.size())) != 0) {
+    throw vt::exception() << "failed to create " << path;
+  }
+  for (const size_t i : {data_page, zeros_page}) {
+    const auto offset = static_cast<off_t>(i * page);
+    if (pwrite(raw, content.data() + offset, page, offset) !=
+        static_cast<ssize_t>(page)) {
+      throw vt::exception() << "failed to write page " << i;
+    }
+  }
+  const bool holes = lseek(raw, 0, SEEK_HOLE) == 0;
+
+  const int fd = vtpc_open(path, O_RDWR, 0);
+  if (fd < 0 || vtpc_fadvise(fd, 0, 0, POSIX_FADV_RANDOM) != 0) {
+    throw vt::exception() << "failed to open " << path;
+  }
+  const vtpc_stats before = vt::stats();
+  check(fd, content);
+  const vtpc_stats now = vt::stats();
+  const uint64_t zero = now.zero_pages - before.zero_pages;
+  const uint64_t skipped = now.zero_holes - before.zero_holes;
+  if (zero != pages - 1 || (holes && skipped != pages - 2)) {
+    throw vt::exception() << "shared " << zero << " zero pages, skipped "
+                          << skipped << " holes";
+  }
+
+  // A write gives the page a frame of its own and leaves the shared zero
+  // frame clean for the pages around it.
+  const std::string text = "written into a hole";
+  const off_t offset = (3 * page) + 100;
+  if (vtpc_lseek(fd, offset, SEEK_SET) != offset ||
+      vtpc_write(fd, text.data(), text.size()) !=
+          static_cast<ssize_t>(text.size()) ||
+      vtpc_fsync(fd) != 0) {
+    throw vt::exception() << "failed to write into a hole";
+  }
+  content.replace(offset, text.size(), text);
+  check(fd, content);
+
+  std::string disk(content.size(), 0);
+  if (pread(raw, disk.data(), disk.size(), 0) !=
+      static_cast<ssize_t>(disk.size())) {
+    throw vt::exception() << "failed to read " << path;
+  }
+  if (disk != content) {
+    throw vt::exception() << "content differs on disk";
+  }
+  close(raw);
+  vtpc_close(fd);
+
+  const uint64_t regrown = check_regrown();
+  if (holes && regrown != pages / 2) {
+    throw vt::exception() << "skipped " << regrown << " of " << pages / 2
+                          << " holes past a truncation";
+  }
+
+  std::cout << "zero pages " << zero << ", holes skipped " << skipped
+            << '\n';
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}